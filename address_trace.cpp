@@ -0,0 +1,167 @@
+#include "address_trace.h"
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "blockchain_state.h"
+#include "database.h"
+#include "lisk.h"
+#include "replay.h"
+#include "scopedbenchmark.h"
+#include "utils.h"
+
+namespace AddressTrace {
+
+namespace {
+
+struct Account {
+    address_t address;
+    std::int64_t balance = 0;
+    std::uint64_t lastBlockId = AddressSummary::defaultLastBlockId;
+    std::set<std::uint64_t> dapps; // IDs of dapps registered by the account
+};
+
+void printChange(const Account &account, height_t height, std::uint64_t blockId, const std::string &cause, std::int64_t change)
+{
+    std::cout << "height " << height << " block " << blockId << " " << cause << ": "
+              << (change >= 0 ? "+" : "") << change << " balance " << account.balance << std::endl;
+}
+
+// Mirrors BlockchainState::applyTransaction and the balance adjustments of Replay::processBlock
+void applyTransaction(Account &account, const TransactionRow &row, const Settings &settings, height_t height)
+{
+    const auto &t = row.transaction;
+    std::int64_t change = 0;
+
+    if (settings.exceptions.inertTransactions.count(row.id) == 0) {
+        if (t.senderAddress == account.address) {
+            change -= t.fee;
+            if (t.type == 0 || t.type == 6 || t.type == 7) change -= t.amount;
+            if (t.type == 5) account.dapps.insert(row.id);
+            account.lastBlockId = row.blockId;
+        }
+        if ((t.type == 0 || t.type == 7) && t.recipientAddress == account.address) {
+            change += t.amount;
+            account.lastBlockId = row.blockId;
+        }
+        if (t.type == 6 && account.dapps.count(t.dappId)) {
+            change += t.amount;
+            account.lastBlockId = row.blockId;
+        }
+    }
+
+    if (t.senderAddress == account.address && settings.exceptions.balanceAdjustments.count(row.id)) {
+        change += settings.exceptions.balanceAdjustments.at(row.id);
+    }
+
+    account.balance += change;
+    printChange(account, height, row.blockId, "transaction " + std::to_string(row.id) + " type " + std::to_string(t.type), change);
+}
+
+}
+
+address_t parseAddress(const std::string &text)
+{
+    auto digits = text;
+    if (!digits.empty() && digits.back() == 'L') digits.pop_back();
+
+    std::size_t parsed = 0;
+    address_t out = 0;
+    try {
+        out = std::stoull(digits, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (digits.empty() || parsed != digits.size() || digits[0] == '-' || digits[0] == '+') {
+        throw std::runtime_error("Invalid address: '" + text + "'");
+    }
+    return out;
+}
+
+void run(pqxx::read_transaction &db, const Settings &settings, address_t address)
+{
+    ScopedBenchmark benchmarkTrace("Tracing address"); static_cast<void>(benchmarkTrace);
+
+    auto blockToTransactions = Database::readTransactionsOfAddress(db, settings, address);
+
+    Account account;
+    account.address = address;
+
+    std::uint64_t roundFees = 0;
+    std::vector<address_t> roundDelegates(101);
+    std::vector<std::uint64_t> roundRewards(101);
+    std::map<bytes_t, address_t> generatorAddresses;
+
+    std::cout << "Tracing address " << address << "L ..." << std::endl;
+    pqxx::icursorstream cursor(db,
+        R"SQL(SELECT height, id, "generatorPublicKey", "totalFee", reward FROM blocks ORDER BY height)SQL",
+        "block_payouts", 100000);
+    pqxx::result batch;
+    while (cursor >> batch) {
+        for (auto row : batch) {
+            const auto height = row[0].as<height_t>();
+            const auto blockId = row[1].as<std::uint64_t>();
+            const auto generatorPublicKey = asVector(pqxx::binarystring(row[2]));
+            const auto totalFee = row[3].as<std::uint64_t>();
+            const auto reward = row[4].as<std::uint64_t>();
+
+            auto transactions = blockToTransactions.find(blockId);
+            if (transactions != blockToTransactions.end()) {
+                for (const auto &transactionRow : transactions->second) {
+                    applyTransaction(account, transactionRow, settings, height);
+                }
+            }
+
+            auto generator = generatorAddresses.find(generatorPublicKey);
+            if (generator == generatorAddresses.end()) {
+                generator = generatorAddresses.emplace(generatorPublicKey, addressFromPubkey(generatorPublicKey)).first;
+            }
+            if (generator->second == address) {
+                account.lastBlockId = blockId;
+                printChange(account, height, blockId, "generated", 0);
+            }
+
+            roundFees += totalFee;
+            roundDelegates[(height-1)%101] = generator->second;
+            roundRewards[(height-1)%101] = reward;
+
+            if (height%101 == 0) {
+                const auto payouts = roundPayouts(settings, height, roundFees, roundRewards);
+                std::int64_t change = 0;
+                bool isDelegate = false;
+                for (int i = 0; i < 101; ++i) {
+                    if (roundDelegates[i] == address) {
+                        change += payouts[i];
+                        isDelegate = true;
+                    }
+                }
+                if (isDelegate) {
+                    account.balance += change;
+                    account.lastBlockId = blockId;
+                    printChange(account, height, blockId, "round " + std::to_string(roundFromHeight(height)) + " rewards and fees", change);
+                }
+                roundFees = 0;
+            }
+        }
+    }
+
+    std::cout << "Replayed: balance " << account.balance << " lastBlockId " << account.lastBlockId << std::endl;
+
+    // mem_accounts has no block IDs in v100 compatible networks
+    auto memAccount = db.exec(std::string("SELECT balance") + (settings.v100Compatible ? "" : ", \"blockId\"") +
+                              " FROM mem_accounts WHERE address = " + db.quote(std::to_string(address) + "L"));
+    if (memAccount.empty()) {
+        std::cout << "mem_accounts: no account" << std::endl;
+    } else {
+        std::cout << "mem_accounts: balance " << memAccount[0][0].c_str();
+        if (!settings.v100Compatible) {
+            std::cout << " lastBlockId " << memAccount[0][1].c_str();
+        }
+        std::cout << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+#include <pqxx/pqxx>
+
+#include "settings.h"
+#include "types.h"
+
+namespace AddressTrace {
+
+// Parses "123L" or "123". Throws std::runtime_error for anything else.
+address_t parseAddress(const std::string &text);
+
+// Replays balance and lastBlockId of a single account and prints every change with its block,
+// followed by the values in mem_accounts. Only the transactions of the account are read, plus
+// generator, fee and reward of every block for the round payouts.
+void run(pqxx::read_transaction &db, const Settings &settings, address_t address);
+
+}
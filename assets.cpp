@@ -1,10 +1,13 @@
 #include "assets.h"
 
 #include <iostream>
+#include <vector>
+
+#include "profiler.h"
 
 namespace {
 
-void validateUniqueTransactionId(pqxx::read_transaction &db, const std::string tableName) {
+void validateUniqueTransactionId(pqxx::transaction_base &db, const std::string tableName) {
     pqxx::result result = db.exec(
         "SELECT \"transactionId\" "
         "FROM " + tableName + R"SQL(
@@ -21,7 +24,27 @@ void validateUniqueTransactionId(pqxx::read_transaction &db, const std::string t
     }
 }
 
-void checkUnconfirmed(pqxx::read_transaction &db, const std::string tableName, const std::string columnName)
+// The validateType*AssetData relevant for the network, in the order validateAssetData runs them
+std::vector<void (*)(pqxx::transaction_base &)> assetChecks(const Settings &settings)
+{
+    std::vector<void (*)(pqxx::transaction_base &)> out;
+    if (settings.v100Compatible)
+    {
+        out.push_back(Assets::validateType0AssetData);
+    }
+    out.insert(out.end(), {
+        Assets::validateType1AssetData,
+        Assets::validateType2AssetData,
+        Assets::validateType3AssetData,
+        Assets::validateType4AssetData,
+        Assets::validateType5AssetData,
+        Assets::validateType6AssetData,
+        Assets::validateType7AssetData,
+    });
+    return out;
+}
+
+void checkUnconfirmed(pqxx::transaction_base &db, const std::string tableName, const std::string columnName)
 {
     auto row = db.exec1("SELECT count(*) FROM " + tableName + " WHERE \"" + columnName + "\" != \"u_" + columnName + "\"");
     if (row[0].as<int>() != 0)
@@ -34,59 +57,118 @@ void checkUnconfirmed(pqxx::read_transaction &db, const std::string tableName, c
 
 namespace Assets {
 
-void peersEmpty(pqxx::read_transaction &db)
+void peersEmpty(pqxx::transaction_base &db)
 {
     auto count = db.exec1("SELECT count(*) from peers")[0].as<int>();
     if (count != 0) throw std::runtime_error("Table peers not empty");
 }
 
-void peersDappEmpty(pqxx::read_transaction &db)
+void peersDappEmpty(pqxx::transaction_base &db)
 {
     auto count = db.exec1("SELECT count(*) from peers_dapp")[0].as<int>();
     if (count != 0) throw std::runtime_error("Table peers_dapp not empty");
 }
 
-void validateType0AssetData(pqxx::read_transaction &db)
+void validateType0AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "transfer");
 }
 
-void validateType1AssetData(pqxx::read_transaction &db)
+void validateType1AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "signatures");
 }
 
-void validateType2AssetData(pqxx::read_transaction &db)
+void validateType2AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "delegates");
 }
 
-void validateType3AssetData(pqxx::read_transaction &db)
+void validateType3AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "votes");
 }
 
-void validateType4AssetData(pqxx::read_transaction &db)
+void validateType4AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "multisignatures");
 }
 
-void validateType5AssetData(pqxx::read_transaction &db)
+void validateType5AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "dapps");
 }
 
-void validateType6AssetData(pqxx::read_transaction &db)
+void validateType6AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "intransfer");
 }
 
-void validateType7AssetData(pqxx::read_transaction &db)
+void validateType7AssetData(pqxx::transaction_base &db)
 {
     validateUniqueTransactionId(db, "outtransfer");
 }
 
-void checkUnconfirmedInMemAccounts(pqxx::read_transaction &db)
+void validateAssetData(pqxx::transaction_base &db, const Settings &settings)
+{
+    for (const auto check : assetChecks(settings)) {
+        check(db);
+    }
+}
+
+BackgroundValidation::BackgroundValidation(const std::string &databaseName, const Settings &settings)
+    : thread_([this, databaseName, &settings]() {
+        try {
+            Profiler::Scope scope("table scans", Profiler::Traced); static_cast<void>(scope);
+            pqxx::connection connection("dbname=" + databaseName);
+            {
+                std::lock_guard<std::mutex> lock(connectionMutex_);
+                connection_ = &connection;
+            }
+            try {
+                pqxx::read_transaction db(connection);
+                for (const auto check : assetChecks(settings)) {
+                    if (stopping_) break;
+                    check(db);
+                }
+            } catch (...) {
+                failure_ = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(connectionMutex_);
+            connection_ = nullptr;
+        } catch (...) {
+            failure_ = std::current_exception();
+        }
+    })
+{
+}
+
+BackgroundValidation::~BackgroundValidation()
+{
+    if (!thread_.joinable()) return;
+    // Tables not started yet are skipped and the running scan is cancelled. A scan that starts
+    // right before the cancel request reaches the server still runs to its end.
+    stopping_ = true;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex_);
+        if (connection_) {
+            try {
+                connection_->cancel_query();
+            } catch (...) {
+                // The scan then runs to its end
+            }
+        }
+    }
+    thread_.join();
+}
+
+void BackgroundValidation::wait()
+{
+    if (thread_.joinable()) thread_.join();
+    if (failure_) std::rethrow_exception(failure_);
+}
+
+void checkUnconfirmedInMemAccounts(pqxx::transaction_base &db)
 {
     //checkUnconfirmed(db, "mem_accounts", "username");
     //checkUnconfirmed(db, "mem_accounts", "isDelegate");
@@ -1,20 +1,55 @@
 #pragma once
 
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
 #include <pqxx/pqxx>
 
+#include "settings.h"
+
 // TODO: rename
 namespace Assets {
 
-void peersEmpty(pqxx::read_transaction &db);
-void peersDappEmpty(pqxx::read_transaction &db);
-void validateType0AssetData(pqxx::read_transaction &db);
-void validateType1AssetData(pqxx::read_transaction &db);
-void validateType2AssetData(pqxx::read_transaction &db);
-void validateType3AssetData(pqxx::read_transaction &db);
-void validateType4AssetData(pqxx::read_transaction &db);
-void validateType5AssetData(pqxx::read_transaction &db);
-void validateType6AssetData(pqxx::read_transaction &db);
-void validateType7AssetData(pqxx::read_transaction &db);
-void checkUnconfirmedInMemAccounts(pqxx::read_transaction &db);
+void peersEmpty(pqxx::transaction_base &db);
+void peersDappEmpty(pqxx::transaction_base &db);
+void validateType0AssetData(pqxx::transaction_base &db);
+void validateType1AssetData(pqxx::transaction_base &db);
+void validateType2AssetData(pqxx::transaction_base &db);
+void validateType3AssetData(pqxx::transaction_base &db);
+void validateType4AssetData(pqxx::transaction_base &db);
+void validateType5AssetData(pqxx::transaction_base &db);
+void validateType6AssetData(pqxx::transaction_base &db);
+void validateType7AssetData(pqxx::transaction_base &db);
+void checkUnconfirmedInMemAccounts(pqxx::transaction_base &db);
+
+// All of the above validateType*AssetData relevant for the network
+void validateAssetData(pqxx::transaction_base &db, const Settings &settings);
+
+// validateAssetData on a thread of its own with a connection of its own to databaseName, one table
+// after the other. The table scans mostly wait for the database server, so they overlap with the
+// replay without taking a thread of the pool.
+class BackgroundValidation {
+public:
+    BackgroundValidation(const std::string &databaseName, const Settings &settings);
+    // Cancels the running scan and skips the remaining tables, ignoring the failure
+    ~BackgroundValidation();
+
+    BackgroundValidation(const BackgroundValidation &) = delete;
+    BackgroundValidation &operator=(const BackgroundValidation &) = delete;
+
+    // Waits for the scans, then rethrows their exception if they failed. Can be called again.
+    void wait();
+
+private:
+    // Used by thread_, so constructed before it
+    std::exception_ptr failure_;
+    std::atomic<bool> stopping_{false};
+    std::mutex connectionMutex_;
+    pqxx::connection *connection_ = nullptr; // while the scans run, guarded by connectionMutex_
+    std::thread thread_;
+};
 
 }
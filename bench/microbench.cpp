@@ -0,0 +1,339 @@
+// Microbenchmarks of the primitives on the replay hot path. The synthetic data follows the shape of
+// mainnet: most transactions are transfers, votes change 1 to 33 delegates, multisignature groups
+// have 2 to 16 keys and most blocks are empty. Every benchmark reports time and heap allocations
+// per operation.
+//
+//     snapshot-validator-bench [FILTER]
+//
+// runs the benchmarks whose name contains FILTER.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sodium.h>
+
+#include "block.h"
+#include "blockchain_state.h"
+#include "blockchain_state_validator.h"
+#include "lisk.h"
+#include "payload.h"
+#include "settings.h"
+#include "transaction.h"
+#include "utils.h"
+
+namespace {
+
+// The benchmarks run on one thread, so a plain counter is enough
+std::uint64_t allocations = 0;
+
+}
+
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    if (void *pointer = std::malloc(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace {
+
+const std::size_t DATA_SIZE = 4096; // items cycled through, more than fit in L1
+const std::size_t ACCOUNT_COUNT = 100000;
+
+volatile std::uint64_t sink;
+
+class Data {
+public:
+    explicit Data(std::uint64_t seed)
+        : random_(seed)
+    {
+        for (std::size_t i = 0; i < 101; ++i) delegates_.push_back(bytes(32));
+        for (std::size_t i = 0; i < ACCOUNT_COUNT; ++i) accounts_.push_back(bytes(32));
+    }
+
+    bytes_t bytes(std::size_t size)
+    {
+        bytes_t out(size);
+        for (auto &byte : out) byte = static_cast<unsigned char>(random_());
+        return out;
+    }
+
+    std::uint64_t below(std::uint64_t limit)
+    {
+        return random_() % limit;
+    }
+
+    // Mostly transfers between existing accounts
+    Transaction transaction()
+    {
+        const auto roll = below(100);
+        if (roll < 90) return transaction(0);
+        if (roll < 95) return transaction(3);
+        if (roll < 97) return transaction(1);
+        if (roll < 98) return transaction(2);
+        return transaction(4);
+    }
+
+    Transaction transaction(std::uint8_t type)
+    {
+        const auto &sender = accounts_[below(accounts_.size())];
+        const auto timestamp = static_cast<std::int32_t>(below(100000000));
+        const auto fee = type == 0 ? 10000000 : 100000000;
+        switch (type) {
+        case 0:
+            return Transaction(0, timestamp, sender, addressFromPubkey(accounts_[below(accounts_.size())]),
+                               below(100000000000), fee, {}, 0);
+        case 1:
+            return Transaction(1, timestamp, sender, 0, 0, 500000000, bytes(32), 0);
+        case 2: {
+            const auto name = "delegate_" + std::to_string(below(1000000));
+            return Transaction(2, timestamp, sender, 0, 0, 2500000000, bytes_t(name.begin(), name.end()), 0);
+        }
+        case 3: {
+            std::string votes;
+            const auto count = 1 + below(33);
+            for (std::uint64_t i = 0; i < count; ++i) {
+                votes += below(4) ? '+' : '-';
+                votes += bytes2Hex(delegates_[below(delegates_.size())]);
+            }
+            return Transaction(3, timestamp, sender, addressFromPubkey(sender), 0, fee,
+                               bytes_t(votes.begin(), votes.end()), 0);
+        }
+        default: {
+            std::string keysgroup;
+            const auto count = 2 + below(15);
+            keysgroup += static_cast<char>(2);
+            keysgroup += static_cast<char>(24);
+            for (std::uint64_t i = 0; i < count; ++i) {
+                keysgroup += '+';
+                keysgroup += bytes2Hex(accounts_[below(accounts_.size())]);
+            }
+            return Transaction(4, timestamp, sender, 0, 0, fee * (count + 1),
+                               bytes_t(keysgroup.begin(), keysgroup.end()), 0);
+        }
+        }
+    }
+
+    TransactionRow transactionRow(std::uint64_t blockId)
+    {
+        const auto secondSignature = below(10) == 0 ? bytes(64) : bytes_t();
+        return TransactionRow(transaction(), bytes(64), secondSignature, random_(), blockId);
+    }
+
+    // 70% of the blocks are empty, the others have up to 25 transactions
+    std::vector<TransactionRow> blockTransactions(std::uint64_t blockId)
+    {
+        std::vector<TransactionRow> out;
+        if (below(10) < 7) return out;
+        const auto count = 1 + below(25);
+        for (std::uint64_t i = 0; i < count; ++i) out.push_back(transactionRow(blockId));
+        return out;
+    }
+
+    BlockHeader blockHeader(const std::vector<TransactionRow> &transactions)
+    {
+        std::uint64_t totalAmount = 0;
+        std::uint64_t totalFee = 0;
+        for (const auto &row : transactions) {
+            totalAmount += row.transaction.amount;
+            totalFee += row.transaction.fee;
+        }
+        return BlockHeader(0, static_cast<std::uint32_t>(below(100000000)), random_(),
+                           static_cast<std::uint32_t>(transactions.size()), totalAmount, totalFee, 500000000,
+                           static_cast<std::uint32_t>(transactions.size() * 117), bytes(32),
+                           delegates_[below(delegates_.size())]);
+    }
+
+    const std::vector<bytes_t> &accounts() const { return accounts_; }
+
+private:
+    std::mt19937_64 random_;
+    std::vector<bytes_t> delegates_;
+    std::vector<bytes_t> accounts_;
+};
+
+std::string filter;
+
+// Runs operation(i) for i in [0, operations) after a short warm up
+template<typename Operation>
+void run(const std::string &name, std::size_t operations, Operation operation)
+{
+    if (name.find(filter) == std::string::npos) return;
+
+    for (std::size_t i = 0; i < operations / 10; ++i) operation(i);
+
+    const auto allocationsBefore = allocations;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < operations; ++i) operation(i);
+    const auto duration = std::chrono::steady_clock::now() - start;
+    const auto allocationCount = allocations - allocationsBefore;
+
+    std::cout << std::left << std::setw(40) << name << std::right
+              << std::setw(12) << std::fixed << std::setprecision(1)
+              << std::chrono::duration<double, std::nano>(duration).count() / operations << " ns/op"
+              << std::setw(10) << std::setprecision(2)
+              << static_cast<double>(allocationCount) / operations << " allocs/op" << std::endl;
+}
+
+template<typename Item, typename Make>
+std::vector<Item> generate(Make make)
+{
+    std::vector<Item> out;
+    out.reserve(DATA_SIZE);
+    for (std::size_t i = 0; i < DATA_SIZE; ++i) out.push_back(make(i));
+    return out;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (sodium_init() == -1) {
+        return 1;
+    }
+    if (argc > 1) filter = argv[1];
+
+    Data data(42);
+    const Settings settings(Network::Mainnet);
+
+    const auto rows = generate<TransactionRow>([&](std::size_t) { return data.transactionRow(1); });
+    const auto blocks = generate<std::vector<TransactionRow>>([&](std::size_t i) { return data.blockTransactions(i); });
+    const auto headers = generate<BlockHeader>([&](std::size_t i) { return data.blockHeader(blocks[i]); });
+    const auto blockSignatures = generate<bytes_t>([&](std::size_t) { return data.bytes(64); });
+    const auto payloads = generate<Payload>([&](std::size_t i) { return Payload(blocks[i]); });
+    const auto pubkeysHex = generate<std::string>([&](std::size_t i) { return bytes2Hex(data.accounts()[i]); });
+    const auto votesAssets = generate<bytes_t>([&](std::size_t) { return data.transaction(3).assetData; });
+    const auto keysgroupAssets = generate<bytes_t>([&](std::size_t) { return data.transaction(4).assetData; });
+    const auto keysgroupTransactions = generate<Transaction>([&](std::size_t) { return data.transaction(4); });
+
+    std::cout << "Benchmark                                      time    allocations" << std::endl;
+
+    run("Transaction::serialize", 1000000, [&](std::size_t i) {
+        sink = sink + rows[i % DATA_SIZE].transaction.serialize().size();
+    });
+    run("Transaction::hash", 1000000, [&](std::size_t i) {
+        const auto &row = rows[i % DATA_SIZE];
+        sink = sink + row.transaction.hash(row.signature, row.secondSignature)[0];
+    });
+    run("Transaction::id", 1000000, [&](std::size_t i) {
+        const auto &row = rows[i % DATA_SIZE];
+        sink = sink + row.transaction.id(row.signature, row.secondSignature);
+    });
+    run("BlockHeader::serialize", 1000000, [&](std::size_t i) {
+        sink = sink + headers[i % DATA_SIZE].serialize().size();
+    });
+    run("BlockHeader::id", 1000000, [&](std::size_t i) {
+        sink = sink + headers[i % DATA_SIZE].id(blockSignatures[i % DATA_SIZE]);
+    });
+    run("Payload::hash", 100000, [&](std::size_t i) {
+        sink = sink + payloads[i % DATA_SIZE].hash()[0];
+    });
+    run("addressFromPubkey", 1000000, [&](std::size_t i) {
+        sink = sink + addressFromPubkey(data.accounts()[i % DATA_SIZE]);
+    });
+    run("hex2Bytes (public key)", 1000000, [&](std::size_t i) {
+        sink = sink + hex2Bytes(pubkeysHex[i % DATA_SIZE])[0];
+    });
+    run("Transaction() type 3", 100000, [&](std::size_t i) {
+        Transaction t(3, 0, data.accounts()[i % DATA_SIZE], 0, 0, 100000000, votesAssets[i % DATA_SIZE], 0);
+        sink = sink + t.assetData.size();
+    });
+    run("Transaction() type 4", 100000, [&](std::size_t i) {
+        Transaction t(4, 0, data.accounts()[i % DATA_SIZE], 0, 0, 100000000, keysgroupAssets[i % DATA_SIZE], 0);
+        sink = sink + t.assetData.size();
+    });
+    run("Transaction::type4Addresses", 100000, [&](std::size_t i) {
+        sink = sink + keysgroupTransactions[i % DATA_SIZE].type4Addresses().size();
+    });
+
+    {
+        std::vector<address_t> addresses;
+        BlockchainState state;
+        for (const auto &account : data.accounts()) {
+            addresses.push_back(addressFromPubkey(account));
+            state.addressSummaries[addresses.back()].balance = 1000000000000000;
+        }
+        BlockchainStateValidator::validate(state, settings);
+
+        // Only applies; every 8 transactions the dirty keys and negative balance candidates are reset
+        // so they do not grow, validation is measured separately below
+        run("BlockchainState::applyTransaction", 1000000, [&](std::size_t i) {
+            state.applyTransaction(rows[i % DATA_SIZE]);
+            if (i % 8 == 7) {
+                state.addressSummaries.resetDirtyKeys();
+                state.negativeBalanceCandidates.clear();
+            }
+        });
+        BlockchainStateValidator::validate(state, settings);
+
+        run("BlockchainStateValidator::validate (8)", 100000, [&](std::size_t i) {
+            for (std::size_t j = 0; j < 8; ++j) {
+                (void) state.addressSummaries[addresses[(i * 8 + j) % ACCOUNT_COUNT]];
+            }
+            BlockchainStateValidator::validate(state, settings);
+        });
+    }
+
+    {
+        // The mainnet exception lists of id_index.h next to the containers they replaced. Random IDs
+        // miss, like nearly all lookups of the replay.
+        const auto &invalidRecipients = settings.exceptions.transactionsContainingInvalidRecipientAddress;
+        const std::set<std::uint64_t> orderedSet(invalidRecipients.begin(), invalidRecipients.end());
+        const std::unordered_set<std::uint64_t> hashSet(invalidRecipients.begin(), invalidRecipients.end());
+        const std::vector<std::uint64_t> hits(invalidRecipients.begin(), invalidRecipients.end());
+        std::mt19937_64 random(7);
+        const auto misses = generate<std::uint64_t>([&](std::size_t) { return random(); });
+        const auto size = " (" + std::to_string(hits.size()) + " IDs)";
+
+        run("IdSet::count miss" + size, 10000000, [&](std::size_t i) {
+            sink = sink + invalidRecipients.count(misses[i % DATA_SIZE]);
+        });
+        run("std::set::count miss" + size, 10000000, [&](std::size_t i) {
+            sink = sink + orderedSet.count(misses[i % DATA_SIZE]);
+        });
+        run("std::unordered_set::count miss" + size, 10000000, [&](std::size_t i) {
+            sink = sink + hashSet.count(misses[i % DATA_SIZE]);
+        });
+        run("IdSet::count hit" + size, 10000000, [&](std::size_t i) {
+            sink = sink + invalidRecipients.count(hits[i % hits.size()]);
+        });
+        run("std::set::count hit" + size, 10000000, [&](std::size_t i) {
+            sink = sink + orderedSet.count(hits[i % hits.size()]);
+        });
+        run("std::unordered_set::count hit" + size, 10000000, [&](std::size_t i) {
+            sink = sink + hashSet.count(hits[i % hits.size()]);
+        });
+
+        // Rounds, as looked up once per round close
+        const auto &feesFactor = settings.exceptions.feesFactor;
+        const std::unordered_map<std::uint64_t, int> feesFactorMap{{27040, 2}};
+        run("IdMap::count miss (round)", 10000000, [&](std::size_t i) {
+            sink = sink + feesFactor.count(i % 60000);
+        });
+        run("std::unordered_map::count miss (round)", 10000000, [&](std::size_t i) {
+            sink = sink + feesFactorMap.count(i % 60000);
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""End-to-end throughput regression check of snapshot-validator.
+
+Runs a full validation of a fixed chain with --metrics-file and compares blocks/s, transactions/s,
+peak resident memory and the time of every stage with a stored baseline. Exits with 1 if any of
+them got worse by more than the tolerance, with 2 if the validation itself failed.
+
+By default a synthetic chain is generated once with snapshot-validator-generator and kept in the
+work directory. It is restored into a temporary database of the local Postgres server for every
+run, the same way validate_snapshot.sh does. --database uses an existing database instead and
+--cache-dir replays from a chain cache file, building it in a first run that is not measured.
+
+    bench/throughput_regression.py --bin-dir build              # compare with the baseline
+    bench/throughput_regression.py --bin-dir build --update-baseline
+"""
+
+import argparse
+import datetime
+import json
+import os
+import subprocess
+import sys
+
+# The chain of the default baseline, about 50k blocks and 500k transactions
+GENERATOR_OPTIONS = ["--seed", "1", "--height", "50500", "--accounts", "100000", "--transactions-per-block", "10"]
+
+# Higher is better for these
+THROUGHPUT_METRICS = ["blocksPerSecond", "transactionsPerSecond"]
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bin-dir", default=".", help="directory of the snapshot-validator binaries (default: .)")
+    parser.add_argument("--work-dir", default="throughput-regression",
+                        help="generated chain, baseline and results (default: throughput-regression)")
+    parser.add_argument("--network", default="synthetic", help="network of the chain (default: synthetic)")
+    source = parser.add_mutually_exclusive_group()
+    source.add_argument("--snapshot", help="gzipped SQL dump to restore instead of a generated chain")
+    source.add_argument("--database", help="validate this existing database instead of restoring a chain")
+    parser.add_argument("--cache-dir", help="replay from a chain cache in this directory")
+    parser.add_argument("--runs", type=int, default=1, help="measured runs, the fastest is compared (default: 1)")
+    parser.add_argument("--baseline", help="baseline results (default: WORK_DIR/baseline.json)")
+    parser.add_argument("--results", help="results of this run (default: WORK_DIR/results.json)")
+    parser.add_argument("--tolerance", type=float, default=0.10,
+                        help="allowed relative loss of blocks/s and transactions/s and growth of peak memory "
+                             "(default: 0.10)")
+    parser.add_argument("--stage-tolerance", type=float, default=0.25,
+                        help="allowed relative growth of the time of a stage (default: 0.25)")
+    parser.add_argument("--min-stage-seconds", type=float, default=1.0,
+                        help="stages taking less in the baseline are not compared (default: 1.0)")
+    parser.add_argument("--update-baseline", action="store_true", help="store the results as new baseline")
+    return parser.parse_args()
+
+
+def run(command, **kwargs):
+    print("$ " + " ".join(command), flush=True)
+    subprocess.run(command, check=True, **kwargs)
+
+
+def generated_chain(args):
+    path = os.path.join(args.work_dir, "synthetic-" + "-".join(GENERATOR_OPTIONS[1::2]) + ".sql.gz")
+    if not os.path.exists(path):
+        print("Generating synthetic chain " + path + " ...", flush=True)
+        generator = os.path.join(args.bin_dir, "snapshot-validator-generator")
+        with open(path + ".tmp", "wb") as out:
+            generating = subprocess.Popen([generator] + GENERATOR_OPTIONS, stdout=subprocess.PIPE)
+            subprocess.run(["gzip", "-1"], stdin=generating.stdout, stdout=out, check=True)
+            generating.stdout.close()
+            if generating.wait() != 0:
+                raise subprocess.CalledProcessError(generating.returncode, generator)
+        os.rename(path + ".tmp", path)
+    return path
+
+
+def restore(snapshot):
+    database = "snapshot_validator_bench_{}_pid{}".format(
+        datetime.datetime.now(datetime.timezone.utc).strftime("%Y-%m-%dT%H-%M-%SZ"), os.getpid())
+    run(["createdb", database])
+    gunzip = subprocess.Popen(["gunzip", "-fcq", snapshot], stdout=subprocess.PIPE)
+    try:
+        run(["psql", "--quiet", "--dbname", database], stdin=gunzip.stdout, stdout=subprocess.DEVNULL)
+    except subprocess.CalledProcessError:
+        run(["dropdb", database])
+        raise
+    finally:
+        gunzip.stdout.close()
+        gunzip.wait()
+    return database
+
+
+def validate(args, database, metrics_file):
+    command = [os.path.join(args.bin_dir, "snapshot-validator")]
+    if args.cache_dir:
+        command += ["--cache-dir", args.cache_dir]
+    if metrics_file:
+        command += ["--metrics-file", metrics_file]
+    run(command + [args.network, database], stdout=subprocess.DEVNULL)
+
+
+def measure(args):
+    """Results of the fastest of args.runs validations"""
+    snapshot = None
+    if not args.database:
+        snapshot = args.snapshot or generated_chain(args)
+
+    best = None
+    metrics_file = os.path.join(args.work_dir, "metrics.json")
+    for index in range(args.runs + (1 if args.cache_dir else 0)):
+        database = args.database or restore(snapshot)
+        try:
+            # With a chain cache, the first run builds it
+            measured = not args.cache_dir or index > 0
+            validate(args, database, metrics_file if measured else None)
+        finally:
+            if not args.database:
+                run(["dropdb", database])
+        if measured:
+            with open(metrics_file) as f:
+                results = json.load(f)
+            if best is None or results["blocksPerSecond"] > best["blocksPerSecond"]:
+                best = results
+    return best
+
+
+def compare(baseline, results, args):
+    """Lines describing the regressions of results against baseline"""
+    regressions = []
+
+    def check(name, before, after, tolerance, higher_is_better):
+        change = (after - before) / before if before else 0
+        worse = change < -tolerance if higher_is_better else change > tolerance
+        print("{:<50} {:>14.3f} {:>14.3f} {:>+8.1%}{}".format(name, before, after, change,
+                                                               "  REGRESSION" if worse else ""))
+        if worse:
+            regressions.append("{} changed by {:+.1%} (tolerance {:.0%})".format(name, change, tolerance))
+
+    print("{:<50} {:>14} {:>14} {:>8}".format("", "baseline", "current", "change"))
+    for name in THROUGHPUT_METRICS:
+        check(name, baseline[name], results[name], args.tolerance, True)
+    check("peak resident MiB", baseline["peakResidentBytes"] / 2**20, results["peakResidentBytes"] / 2**20,
+          args.tolerance, False)
+    for stage, times in baseline["stages"].items():
+        if times["seconds"] < args.min_stage_seconds:
+            continue
+        if stage not in results["stages"]:
+            print("{:<50} missing in current results".format(stage))
+            continue
+        check(stage + " [s]", times["seconds"], results["stages"][stage]["seconds"], args.stage_tolerance, False)
+    return regressions
+
+
+def main():
+    args = parse_args()
+    os.makedirs(args.work_dir, exist_ok=True)
+    baseline_file = args.baseline or os.path.join(args.work_dir, "baseline.json")
+    results_file = args.results or os.path.join(args.work_dir, "results.json")
+
+    try:
+        results = measure(args)
+    except (OSError, subprocess.CalledProcessError) as e:
+        print("Validation failed: {}".format(e), file=sys.stderr)
+        return 2
+
+    with open(results_file, "w") as f:
+        json.dump(results, f, indent=2)
+    print("Results: {} blocks/s, {} transactions/s".format(results["blocksPerSecond"],
+                                                           results["transactionsPerSecond"]))
+
+    if args.update_baseline or not os.path.exists(baseline_file):
+        with open(baseline_file, "w") as f:
+            json.dump(results, f, indent=2)
+        print("Stored results as baseline " + baseline_file)
+        return 0
+
+    with open(baseline_file) as f:
+        baseline = json.load(f)
+    if baseline["blocks"] != results["blocks"] or baseline["transactions"] != results["transactions"]:
+        print("Baseline was measured on a different chain ({} blocks, {} transactions)".format(
+            baseline["blocks"], baseline["transactions"]), file=sys.stderr)
+        return 2
+
+    regressions = compare(baseline, results, args)
+    if regressions:
+        print("Throughput regressions against " + baseline_file + ":")
+        for regression in regressions:
+            print("  " + regression)
+        return 1
+    print("No regressions against " + baseline_file)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
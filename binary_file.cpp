@@ -0,0 +1,104 @@
+#include "binary_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open " + path + ": " + std::strerror(errno));
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Could not stat " + path + ": " + std::strerror(errno));
+    }
+    size_ = info.st_size;
+
+    if (size_ == 0) {
+        close(fd);
+        throw std::runtime_error("File " + path + " is empty");
+    }
+
+    void *mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map " + path + ": " + std::strerror(errno));
+    }
+    madvise(mapping, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const unsigned char *>(mapping);
+}
+
+MappedFile::~MappedFile()
+{
+    munmap(const_cast<unsigned char *>(data_), size_);
+}
+
+const unsigned char *MappedFile::data() const
+{
+    return data_;
+}
+
+std::size_t MappedFile::size() const
+{
+    return size_;
+}
+
+AtomicFileWriter::AtomicFileWriter(const std::string &path)
+    : path_(path)
+    , temporaryPath_(path + ".tmp" + std::to_string(getpid()))
+    , out_(temporaryPath_, std::ios::binary | std::ios::trunc)
+{
+    if (!out_) {
+        throw std::runtime_error("Could not open " + temporaryPath_ + " for writing");
+    }
+}
+
+AtomicFileWriter::~AtomicFileWriter()
+{
+    if (!committed_) {
+        out_.close();
+        std::remove(temporaryPath_.c_str());
+    }
+}
+
+void AtomicFileWriter::write(const void *data, std::size_t size)
+{
+    out_.write(static_cast<const char *>(data), size);
+    position_ += size;
+}
+
+void AtomicFileWriter::padTo(std::uint64_t offset)
+{
+    const char zeros[64] = {};
+    while (position_ < offset) {
+        write(zeros, std::min<std::uint64_t>(sizeof(zeros), offset - position_));
+    }
+}
+
+std::uint64_t AtomicFileWriter::position() const
+{
+    return position_;
+}
+
+void AtomicFileWriter::commit()
+{
+    out_.close();
+    if (!out_) {
+        throw std::runtime_error("Error writing " + temporaryPath_);
+    }
+
+    if (std::rename(temporaryPath_.c_str(), path_.c_str()) != 0) {
+        throw std::runtime_error("Could not move " + temporaryPath_ + " to " + path_ + ": " + std::strerror(errno));
+    }
+    committed_ = true;
+}
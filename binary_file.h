@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+// Read-only memory mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    const unsigned char *data() const;
+    std::size_t size() const;
+
+    template<typename T>
+    T read(std::uint64_t offset) const
+    {
+        T out;
+        std::memcpy(&out, data_ + offset, sizeof(T));
+        return out;
+    }
+
+private:
+    const unsigned char *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+// Writes to a temporary file that replaces the target on commit(),
+// so readers never see a partially written file
+class AtomicFileWriter {
+public:
+    explicit AtomicFileWriter(const std::string &path);
+    ~AtomicFileWriter();
+
+    AtomicFileWriter(const AtomicFileWriter &) = delete;
+    AtomicFileWriter &operator=(const AtomicFileWriter &) = delete;
+
+    void write(const void *data, std::size_t size);
+
+    template<typename T>
+    void write(const T &value)
+    {
+        write(&value, sizeof(T));
+    }
+
+    // Writes zeros up to the given offset
+    void padTo(std::uint64_t offset);
+    std::uint64_t position() const;
+
+    void commit();
+
+private:
+    std::string path_;
+    std::string temporaryPath_;
+    std::ofstream out_;
+    std::uint64_t position_ = 0;
+    bool committed_ = false;
+};
+
+inline std::uint64_t align8(std::uint64_t value)
+{
+    return (value + 7) & ~std::uint64_t{7};
+}
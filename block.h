@@ -2,6 +2,7 @@
 
 #include <cstdint>
 
+#include "serialization.h"
 #include "types.h"
 
 struct BlockHeader {
@@ -40,9 +41,25 @@ struct BlockHeader {
     const bytes_t payloadHash;
     const bytes_t generatorPublicKey;
 
+    // Wire format, in the order of the members
+    using Layout = Serialization::Layout<
+        Serialization::Little<std::uint32_t>, // version
+        Serialization::Little<std::uint32_t>, // timestamp
+        Serialization::Big<std::uint64_t>, // previous block
+        Serialization::Little<std::uint32_t>, // number of transactions
+        Serialization::Little<std::uint64_t>, // total amount
+        Serialization::Little<std::uint64_t>, // total fee
+        Serialization::Little<std::uint64_t>, // reward
+        Serialization::Little<std::uint32_t>, // payload length
+        Serialization::Bytes<32>, // payload hash
+        Serialization::Bytes<32> // generator public key
+    >;
+
+    // Writes Layout::size bytes
+    void serialize(unsigned char *out) const;
     bytes_t serialize() const;
-    bytes_t hash(bytes_t signature = {}) const;
-    std::uint64_t id(bytes_t signature) const;
+    bytes_t hash(const bytes_t &signature = {}) const;
+    std::uint64_t id(const bytes_t &signature) const;
 };
 
 struct BlockRow {
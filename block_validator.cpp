@@ -3,82 +3,93 @@
 #include <iostream>
 #include <sodium.h>
 
+#include "lisk.h"
+#include "profiler.h"
 #include "utils.h"
+#include "validation_error.h"
 
 namespace {
 
 void validateId(const BlockHeader &bh, std::uint64_t dbId, const bytes_t &signature)
 {
+    Profiler::Scope scope("block id"); static_cast<void>(scope);
     auto calculatedId = bh.id(signature);
     if (calculatedId != dbId)
     {
-        throw std::runtime_error("Block ID mismatch");
+        throw ValidationError("block.id", "Block ID mismatch", std::to_string(calculatedId), std::to_string(dbId));
     }
 }
 
 void validateSignature(const BlockHeader &bh, std::uint64_t dbId, const bytes_t &signature)
 {
+    Profiler::Scope scope("block signature"); static_cast<void>(scope);
     auto hash = bh.hash();
     if (signature.size() != crypto_sign_BYTES)
     {
-        throw std::runtime_error("Signature has unexpected length: " + std::to_string(signature.size()));
+        throw ValidationError("block.signature", "Signature has unexpected length: " + std::to_string(signature.size()),
+                              std::to_string(crypto_sign_BYTES), std::to_string(signature.size()));
     }
-    if (crypto_sign_verify_detached(signature.data(), hash.data(), hash.size(), bh.generatorPublicKey.data()) != 0) {
+    if (!verifySignature(signature, hash, bh.generatorPublicKey)) {
         std::cout << "Height: " << dbId << std::endl;
         std::cout << "Pubkey: " << bytes2Hex(bh.generatorPublicKey) << std::endl;
         std::cout << "Signature: " << bytes2Hex(signature) << std::endl;
-        throw std::runtime_error("Invalid block signature");
+        throw ValidationError("block.signature", "Invalid block signature");
     }
 }
 
 void validateReward(const BlockRow &row, const Settings &settings)
 {
     auto actualReward = row.header.reward;
+    auto expectedReward = BlockValidator::expectedReward(row.height, settings);
 
-    std::uint64_t expectedReward;
-    if (settings.exceptions.blockRewards.count(row.height))
+    if (actualReward != expectedReward)
     {
-        expectedReward = settings.exceptions.blockRewards.at(row.height);
+        throw ValidationError("block.reward",
+                              "Block reward does not match the expected reward "
+                              "for block of height " + std::to_string(row.height) + "." +
+                              " Actual: " + std::to_string(actualReward) +
+                              " Expected: " + std::to_string(expectedReward),
+                              std::to_string(expectedReward), std::to_string(actualReward)
+                              );
     }
-    else if (row.height < settings.rewardOffset)
+}
+
+}
+
+namespace BlockValidator {
+
+std::uint64_t expectedReward(height_t height, const Settings &settings)
+{
+    if (settings.exceptions.blockRewards.count(height))
     {
-        expectedReward = 0;
+        return settings.exceptions.blockRewards.at(height);
     }
-    else if (row.height < settings.rewardOffset + 1*settings.rewardDistance)
+    else if (height < settings.rewardOffset)
     {
-        expectedReward = 5 * 100000000;
+        return 0;
     }
-    else if (row.height < settings.rewardOffset + 2*settings.rewardDistance)
+    else if (height < settings.rewardOffset + 1*settings.rewardDistance)
     {
-        expectedReward = 4 * 100000000;
+        return 5 * 100000000;
     }
-    else if (row.height < settings.rewardOffset + 3*settings.rewardDistance)
+    else if (height < settings.rewardOffset + 2*settings.rewardDistance)
     {
-        expectedReward = 3 * 100000000;
+        return 4 * 100000000;
     }
-    else if (row.height < settings.rewardOffset + 4*settings.rewardDistance)
+    else if (height < settings.rewardOffset + 3*settings.rewardDistance)
     {
-        expectedReward = 2 * 100000000;
+        return 3 * 100000000;
     }
-    else
+    else if (height < settings.rewardOffset + 4*settings.rewardDistance)
     {
-        expectedReward = 1 * 100000000;
+        return 2 * 100000000;
     }
-
-    if (actualReward != expectedReward)
+    else
     {
-        throw std::runtime_error("Block reward does not match the expected reward "
-                                 "for block of height " + std::to_string(row.height) + "." +
-                                 " Actual: " + std::to_string(actualReward) +
-                                 " Expected: " + std::to_string(expectedReward)
-                                 );
+        return 1 * 100000000;
     }
 }
 
-}
-
-namespace BlockValidator {
-
 void validate(const BlockRow &row, const Settings &settings)
 {
     validateId(row.header, row.id, row.signature);
@@ -86,4 +97,47 @@ void validate(const BlockRow &row, const Settings &settings)
     validateReward(row, settings);
 }
 
+void validateTransactionCount(const BlockRow &row, const Payload &payload)
+{
+    if (payload.transactionCount() != row.header.numberOfTransactions) {
+        throw ValidationError(
+                    "block.numberOfTransactions",
+                    "transactions count mismatch in block at height " +
+                    std::to_string(row.height) + ". " +
+                    "Expected by block header: " + std::to_string(row.header.numberOfTransactions) +
+                    " found: " + std::to_string(payload.transactionCount()),
+                    std::to_string(row.header.numberOfTransactions), std::to_string(payload.transactionCount())
+                    );
+    }
+}
+
+void validatePayloadHash(const BlockRow &row, const Payload &payload, const std::vector<TransactionRow> &transactions,
+                         const Settings &settings)
+{
+    if (settings.exceptions.payloadHashMismatch.count(row.id)) return;
+
+    Profiler::Scope scope("payload hash"); static_cast<void>(scope);
+    auto calculatedPayloadHash = payload.hash();
+    if (row.header.payloadHash != calculatedPayloadHash) {
+        auto payloadSerialized = payload.serialize();
+        std::cout << "Payload length calculated: " << payloadSerialized.size()
+                  << " expected: " << row.header.payloadLength << std::endl;
+
+        for (auto &tws : transactions) {
+            auto transactionId = tws.transaction.id(tws.signature, tws.secondSignature);
+            std::cout << "Payload transaction: " << tws.transaction << " " << transactionId << std::endl;
+        }
+
+        if (row.height == 1) {
+            // warn only (https://github.com/LiskHQ/lisk/issues/2047)
+            std::cout << "payload hash mismatch for block " << row.id << std::endl;
+        } else {
+            throw ValidationError("block.payloadHash",
+                                  "Payload hash mismatch in block id " + std::to_string(row.id) +
+                                  " height " + std::to_string(row.height),
+                                  bytes2Hex(calculatedPayloadHash), bytes2Hex(row.header.payloadHash));
+        }
+    }
+}
+
 }
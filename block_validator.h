@@ -1,9 +1,23 @@
 #pragma once
 
+#include <vector>
+
 #include "block.h"
+#include "payload.h"
 #include "settings.h"
+#include "transaction.h"
 #include "types.h"
 
 namespace BlockValidator {
 void validate(const BlockRow &row, const Settings &settings);
+
+// Number of transactions announced by the header
+void validateTransactionCount(const BlockRow &row, const Payload &payload);
+// Payload hash of the header, skipping the blocks listed in the exceptions. A mismatch in the
+// genesis block is only reported, transactions are the rows payload was built from.
+void validatePayloadHash(const BlockRow &row, const Payload &payload, const std::vector<TransactionRow> &transactions,
+                         const Settings &settings);
+
+// Reward of the block at height according to the milestones of the network
+std::uint64_t expectedReward(height_t height, const Settings &settings);
 }
@@ -6,39 +6,53 @@
 
 std::uint64_t AddressSummary::defaultLastBlockId = 0; // reset to genesis block in the main method
 
+void BlockchainState::debit(address_t address, std::uint64_t amount)
+{
+    auto &balance = addressSummaries[address].balance;
+    balance -= amount;
+    if (balance < 0) negativeBalanceCandidates.insert(address);
+}
+
+void BlockchainState::adjustBalance(address_t address, std::int64_t amount)
+{
+    auto &balance = addressSummaries[address].balance;
+    balance += amount;
+    if (balance < 0) negativeBalanceCandidates.insert(address);
+}
+
 void BlockchainState::applyTransaction(const TransactionRow &transactionRow)
 {
     const auto &t = transactionRow.transaction;
 
     switch(t.type) {
     case 0:
-        addressSummaries[t.senderAddress].balance -= (t.amount + t.fee);
+        debit(t.senderAddress, t.amount + t.fee);
         addressSummaries[t.recipientAddress].balance += t.amount;
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
         addressSummaries[t.recipientAddress].lastBlockId = transactionRow.blockId;
         break;
     case 1:
-        addressSummaries[t.senderAddress].balance -= t.fee;
+        debit(t.senderAddress, t.fee);
         addressSummaries[t.senderAddress].secondPubkey = t.assetData;
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
         break;
     case 2:
-        addressSummaries[t.senderAddress].balance -= t.fee;
+        debit(t.senderAddress, t.fee);
         addressSummaries[t.senderAddress].delegateName = std::string(t.assetData.begin(), t.assetData.end());
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
         break;
     case 4: {
-        addressSummaries[t.senderAddress].balance -= t.fee;
+        debit(t.senderAddress, t.fee);
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
 
-        for (auto &pubkey : t.type4Pubkeys) {
+        for (auto address : t.type4Addresses()) {
             // Ensure addresses from type 4 transactions exist
-            (void) addressSummaries[addressFromPubkey(pubkey)];
+            (void) addressSummaries[address];
         }
         break;
     }
     case 5: {
-        addressSummaries[t.senderAddress].balance -= t.fee;
+        debit(t.senderAddress, t.fee);
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
 
         auto dappId = transactionRow.id;
@@ -49,20 +63,20 @@ void BlockchainState::applyTransaction(const TransactionRow &transactionRow)
         // into sidechain, i.e. to sidechain owner
         auto ownerAddress = dappOwners[t.dappId];
 
-        addressSummaries[t.senderAddress].balance -= (t.amount + t.fee);
+        debit(t.senderAddress, t.amount + t.fee);
         addressSummaries[ownerAddress].balance += t.amount;
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
         addressSummaries[ownerAddress].lastBlockId = transactionRow.blockId;
         break;
     }
     case 7:
-        addressSummaries[t.senderAddress].balance -= (t.amount + t.fee);
+        debit(t.senderAddress, t.amount + t.fee);
         addressSummaries[t.recipientAddress].balance += t.amount;
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
         addressSummaries[t.recipientAddress].lastBlockId = transactionRow.blockId;
         break;
     default:
-        addressSummaries[t.senderAddress].balance -= t.fee;
+        debit(t.senderAddress, t.fee);
         addressSummaries[t.senderAddress].lastBlockId = transactionRow.blockId;
     }
 }
@@ -71,3 +85,21 @@ void BlockchainState::applyBlock(const BlockHeader &bh, std::uint64_t blockId)
 {
     addressSummaries[addressFromPubkey(bh.generatorPublicKey)].lastBlockId = blockId;
 }
+
+void BlockchainState::beginJournalFrame()
+{
+    addressSummaries.beginJournalFrame();
+    dappOwners.beginJournalFrame();
+}
+
+void BlockchainState::rollbackJournalFrame()
+{
+    addressSummaries.rollbackJournalFrame();
+    dappOwners.rollbackJournalFrame();
+}
+
+void BlockchainState::dropOldestJournalFrame()
+{
+    addressSummaries.dropOldestJournalFrame();
+    dappOwners.dropOldestJournalFrame();
+}
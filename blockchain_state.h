@@ -1,5 +1,6 @@
 #pragma once
 
+#include <set>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -19,8 +20,21 @@ struct AddressSummary {
 
 struct BlockchainState {
     tracking_unordered_map<address_t, AddressSummary> addressSummaries;
-    std::unordered_map<std::uint64_t, address_t> dappOwners;
+    tracking_unordered_map<std::uint64_t, address_t> dappOwners;
+
+    // Addresses whose balance became negative by a debit since the last balance validation.
+    // Every account with a negative balance after a block is in here.
+    std::set<address_t> negativeBalanceCandidates;
 
     void applyTransaction(const TransactionRow &transactionRow);
+    void adjustBalance(address_t address, std::int64_t amount);
     void applyBlock(const BlockHeader &bh, std::uint64_t blockId);
+
+    // Journal of state changes, see tracking_unordered_map
+    void beginJournalFrame();
+    void rollbackJournalFrame();
+    void dropOldestJournalFrame();
+
+private:
+    void debit(address_t address, std::uint64_t amount);
 };
@@ -1,22 +1,47 @@
 #include "blockchain_state_validator.h"
 
+#include "validation_error.h"
+
 
 namespace BlockchainStateValidator {
 
-void validate(BlockchainState &state, const Settings &settings)
+namespace {
+
+void validateBalance(address_t address, const AddressSummary &summary, const Settings &settings,
+                     FailureCollector *failures)
+{
+    if (summary.balance < 0 && address != settings.negativeBalanceAddress) {
+        ValidationError error("state.balance",
+                              "Negative balance for address " + std::to_string(address) +
+                              ": " + std::to_string(summary.balance),
+                              ">= 0", std::to_string(summary.balance));
+        if (!failures) throw error;
+        if (failures->firstOccurrence(error.check(), address)) failures->record(error);
+    }
+}
+
+}
+
+void validate(BlockchainState &state, const Settings &settings, FailureCollector *failures)
 {
     for (const auto &address : state.addressSummaries.dirtyKeys())
     {
-        const auto summary = state.addressSummaries.at(address);
-
-        if (summary.balance < 0 && address != settings.negativeBalanceAddress) {
-            throw std::runtime_error(
-                        "Negative balance for address " + std::to_string(address) +
-                        ": " + std::to_string(summary.balance));
-        }
+        validateBalance(address, state.addressSummaries.at(address), settings, failures);
     }
 
     state.addressSummaries.resetDirtyKeys();
+    state.negativeBalanceCandidates.clear();
+}
+
+void validateNegativeBalanceCandidates(BlockchainState &state, const Settings &settings,
+                                       FailureCollector *failures)
+{
+    for (const auto &address : state.negativeBalanceCandidates)
+    {
+        validateBalance(address, state.addressSummaries.at(address), settings, failures);
+    }
+
+    state.negativeBalanceCandidates.clear();
 }
 
 }
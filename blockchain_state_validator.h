@@ -1,10 +1,18 @@
 #pragma once
 
 #include "blockchain_state.h"
+#include "failure_collector.h"
 #include "settings.h"
 
 namespace BlockchainStateValidator {
 
-void validate(BlockchainState &state, const Settings &settings);
+// Checks all accounts changed since the last call. With failures, a negative balance is
+// recorded once per account instead of being thrown.
+void validate(BlockchainState &state, const Settings &settings, FailureCollector *failures = nullptr);
+
+// Checks only state.negativeBalanceCandidates. Equivalent to validate() for balances,
+// but leaves the changed accounts for a later validate().
+void validateNegativeBalanceCandidates(BlockchainState &state, const Settings &settings,
+                                       FailureCollector *failures = nullptr);
 
 }
@@ -0,0 +1,392 @@
+#include "chain_cache.h"
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <sodium.h>
+
+#include "profiler.h"
+#include "utils.h"
+
+namespace {
+
+const char MAGIC[8] = {'L', 'S', 'K', 'C', 'A', 'C', 'H', 'E'};
+const std::uint32_t FORMAT_VERSION = 1;
+
+// Slot widths include the leading length byte
+const std::size_t HASH_SLOT = 1 + 32;
+const std::size_t KEY_SLOT = 1 + 32;
+const std::size_t SIGNATURE_SLOT = 1 + 64;
+
+enum class Table {
+    Blocks,
+    Transactions,
+    Heap,
+};
+
+struct ColumnSpec {
+    Table table;
+    std::size_t width;
+};
+
+enum Column {
+    BlockId,
+    BlockHeight,
+    BlockPreviousBlock,
+    BlockTotalAmount,
+    BlockTotalFee,
+    BlockReward,
+    BlockFirstTransaction,
+    BlockVersion,
+    BlockTimestamp,
+    BlockNumberOfTransactions,
+    BlockPayloadLength,
+    BlockTransactionCount,
+    BlockPayloadHash,
+    BlockGeneratorPublicKey,
+    BlockSignature,
+    TransactionId,
+    TransactionRecipient,
+    TransactionAmount,
+    TransactionFee,
+    TransactionDappId,
+    TransactionAssetOffset,
+    TransactionTimestamp,
+    TransactionAssetLength,
+    TransactionType,
+    TransactionSenderPublicKey,
+    TransactionSignature,
+    TransactionSecondSignature,
+    AssetHeap,
+    COLUMN_COUNT
+};
+
+const ColumnSpec COLUMNS[COLUMN_COUNT] = {
+    {Table::Blocks, 8}, // BlockId
+    {Table::Blocks, 8}, // BlockHeight
+    {Table::Blocks, 8}, // BlockPreviousBlock
+    {Table::Blocks, 8}, // BlockTotalAmount
+    {Table::Blocks, 8}, // BlockTotalFee
+    {Table::Blocks, 8}, // BlockReward
+    {Table::Blocks, 8}, // BlockFirstTransaction
+    {Table::Blocks, 4}, // BlockVersion
+    {Table::Blocks, 4}, // BlockTimestamp
+    {Table::Blocks, 4}, // BlockNumberOfTransactions
+    {Table::Blocks, 4}, // BlockPayloadLength
+    {Table::Blocks, 4}, // BlockTransactionCount
+    {Table::Blocks, HASH_SLOT}, // BlockPayloadHash
+    {Table::Blocks, KEY_SLOT}, // BlockGeneratorPublicKey
+    {Table::Blocks, SIGNATURE_SLOT}, // BlockSignature
+    {Table::Transactions, 8}, // TransactionId
+    {Table::Transactions, 8}, // TransactionRecipient
+    {Table::Transactions, 8}, // TransactionAmount
+    {Table::Transactions, 8}, // TransactionFee
+    {Table::Transactions, 8}, // TransactionDappId
+    {Table::Transactions, 8}, // TransactionAssetOffset
+    {Table::Transactions, 4}, // TransactionTimestamp
+    {Table::Transactions, 4}, // TransactionAssetLength
+    {Table::Transactions, 1}, // TransactionType
+    {Table::Transactions, KEY_SLOT}, // TransactionSenderPublicKey
+    {Table::Transactions, SIGNATURE_SLOT}, // TransactionSignature
+    {Table::Transactions, SIGNATURE_SLOT}, // TransactionSecondSignature
+    {Table::Heap, 1}, // AssetHeap
+};
+
+struct Header {
+    char magic[8];
+    std::uint32_t formatVersion;
+    std::uint32_t columnCount;
+    unsigned char fingerprint[crypto_hash_sha256_BYTES];
+    std::uint64_t blockCount;
+    std::uint64_t transactionCount;
+    std::uint64_t heapSize;
+};
+
+// Returns the offset of every column followed by the total file size
+std::vector<std::uint64_t> layout(std::uint64_t blockCount, std::uint64_t transactionCount, std::uint64_t heapSize)
+{
+    std::vector<std::uint64_t> out;
+    std::uint64_t position = align8(sizeof(Header));
+    for (const auto &spec : COLUMNS) {
+        std::uint64_t rows;
+        switch (spec.table) {
+        case Table::Blocks: rows = blockCount; break;
+        case Table::Transactions: rows = transactionCount; break;
+        case Table::Heap: rows = heapSize; break;
+        }
+        out.push_back(position);
+        position = align8(position + rows * spec.width);
+    }
+    out.push_back(position);
+    return out;
+}
+
+template<typename T>
+void append(std::vector<unsigned char> &column, T value)
+{
+    auto position = column.size();
+    column.resize(position + sizeof(T));
+    std::memcpy(&column[position], &value, sizeof(T));
+}
+
+bool fitsSlot(const bytes_t &value, std::size_t width)
+{
+    return value.size() <= width - 1;
+}
+
+// value must fit, see fitsSlot
+void appendSlot(std::vector<unsigned char> &column, const bytes_t &value, std::size_t width)
+{
+    column.push_back(static_cast<unsigned char>(value.size()));
+    column.insert(column.end(), value.begin(), value.end());
+    column.resize(column.size() + (width - 1 - value.size()), 0);
+}
+
+}
+
+namespace ChainCache {
+
+fingerprint_t fingerprint(pqxx::read_transaction &db, Network network, const Settings &settings)
+{
+    auto row = db.exec1(R"SQL(
+        SELECT
+            (SELECT coalesce(max(height), 0) FROM blocks),
+            (SELECT coalesce(max(id), '') FROM blocks WHERE height = (SELECT max(height) FROM blocks)),
+            (SELECT coalesce(max("rowId"), 0) FROM trs)
+    )SQL");
+
+    std::string material = "chaincache/" + std::to_string(FORMAT_VERSION)
+            + "/" + std::to_string(static_cast<int>(network))
+            + "/" + std::to_string(settings.v100Compatible)
+            + "/" + row[0].c_str()
+            + "/" + row[1].c_str()
+            + "/" + row[2].c_str();
+
+    // Row count and an order-independent checksum of the full rows of every table the cache is
+    // decoded from, so that another snapshot with the same tip does not reuse the cache
+    std::vector<std::string> tables = {"blocks", "trs", "signatures", "delegates", "votes", "multisignatures",
+                                       "dapps", "intransfer", "outtransfer"};
+    if (settings.v100Compatible) tables.push_back("transfer");
+    for (const auto &table : tables) {
+        const auto content = db.exec1(
+            "SELECT count(*), coalesce(sum(('x' || substr(md5(t::text), 1, 16))::bit(64)::bigint), 0) FROM " +
+            table + " t");
+        material += "/" + table + ":" + content[0].c_str() + ":" + content[1].c_str();
+    }
+    // Decoding replaces these recipients, so a changed list invalidates the cache
+    for (auto id : settings.exceptions.transactionsContainingInvalidRecipientAddress) {
+        material += "/" + std::to_string(id);
+    }
+
+    auto out = fingerprint_t(crypto_hash_sha256_BYTES);
+    crypto_hash_sha256(out.data(), reinterpret_cast<const unsigned char *>(material.data()), material.size());
+    return out;
+}
+
+std::string filePath(const std::string &cacheDir, const fingerprint_t &fingerprint)
+{
+    return cacheDir + "/chain-" + bytes2Hex(fingerprint) + ".cache";
+}
+
+Writer::Writer()
+    : columns_(COLUMN_COUNT)
+{
+}
+
+bool Writer::addBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions)
+{
+    const auto &bh = block.header;
+    if (!fitsSlot(bh.payloadHash, HASH_SLOT) || !fitsSlot(bh.generatorPublicKey, KEY_SLOT) ||
+            !fitsSlot(block.signature, SIGNATURE_SLOT)) {
+        return false;
+    }
+    for (const auto &row : transactions) {
+        if (!fitsSlot(row.transaction.senderPublicKey, KEY_SLOT) || !fitsSlot(row.signature, SIGNATURE_SLOT) ||
+                !fitsSlot(row.secondSignature, SIGNATURE_SLOT)) {
+            return false;
+        }
+    }
+
+    append<std::uint64_t>(columns_[BlockId], block.id);
+    append<std::uint64_t>(columns_[BlockHeight], block.height);
+    append<std::uint64_t>(columns_[BlockPreviousBlock], bh.previousBlock);
+    append<std::uint64_t>(columns_[BlockTotalAmount], bh.totalAmount);
+    append<std::uint64_t>(columns_[BlockTotalFee], bh.totalFee);
+    append<std::uint64_t>(columns_[BlockReward], bh.reward);
+    append<std::uint64_t>(columns_[BlockFirstTransaction], transactionCount_);
+    append<std::uint32_t>(columns_[BlockVersion], bh.version);
+    append<std::uint32_t>(columns_[BlockTimestamp], bh.timestamp);
+    append<std::uint32_t>(columns_[BlockNumberOfTransactions], bh.numberOfTransactions);
+    append<std::uint32_t>(columns_[BlockPayloadLength], bh.payloadLength);
+    append<std::uint32_t>(columns_[BlockTransactionCount], static_cast<std::uint32_t>(transactions.size()));
+    appendSlot(columns_[BlockPayloadHash], bh.payloadHash, HASH_SLOT);
+    appendSlot(columns_[BlockGeneratorPublicKey], bh.generatorPublicKey, KEY_SLOT);
+    appendSlot(columns_[BlockSignature], block.signature, SIGNATURE_SLOT);
+    ++blockCount_;
+
+    for (const auto &row : transactions) {
+        const auto &t = row.transaction;
+        append<std::uint64_t>(columns_[TransactionId], row.id);
+        append<std::uint64_t>(columns_[TransactionRecipient], t.recipientAddress);
+        append<std::uint64_t>(columns_[TransactionAmount], t.amount);
+        append<std::uint64_t>(columns_[TransactionFee], t.fee);
+        append<std::uint64_t>(columns_[TransactionDappId], t.dappId);
+        append<std::uint64_t>(columns_[TransactionAssetOffset], columns_[AssetHeap].size());
+        append<std::int32_t>(columns_[TransactionTimestamp], t.timestamp);
+        append<std::uint32_t>(columns_[TransactionAssetLength], static_cast<std::uint32_t>(t.assetData.size()));
+        append<std::uint8_t>(columns_[TransactionType], t.type);
+        appendSlot(columns_[TransactionSenderPublicKey], t.senderPublicKey, KEY_SLOT);
+        appendSlot(columns_[TransactionSignature], row.signature, SIGNATURE_SLOT);
+        appendSlot(columns_[TransactionSecondSignature], row.secondSignature, SIGNATURE_SLOT);
+        columns_[AssetHeap].insert(columns_[AssetHeap].end(), t.assetData.begin(), t.assetData.end());
+        ++transactionCount_;
+    }
+    return true;
+}
+
+void Writer::write(const std::string &path, const fingerprint_t &fingerprint) const
+{
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.formatVersion = FORMAT_VERSION;
+    header.columnCount = COLUMN_COUNT;
+    std::memcpy(header.fingerprint, fingerprint.data(), sizeof(header.fingerprint));
+    header.blockCount = blockCount_;
+    header.transactionCount = transactionCount_;
+    header.heapSize = columns_[AssetHeap].size();
+
+    const auto offsets = layout(blockCount_, transactionCount_, header.heapSize);
+
+    AtomicFileWriter out(path);
+    out.write(header);
+    for (int column = 0; column < COLUMN_COUNT; ++column) {
+        out.padTo(offsets[column]);
+        out.write(columns_[column].data(), columns_[column].size());
+    }
+    out.padTo(offsets[COLUMN_COUNT]);
+    out.commit();
+}
+
+Reader::Reader(const std::string &path, const fingerprint_t &fingerprint)
+    : file_(path)
+{
+    if (file_.size() < sizeof(Header)) {
+        throw std::runtime_error("Chain cache " + path + " is truncated");
+    }
+    const auto header = file_.read<Header>(0);
+
+    std::string error;
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        error = "is not a chain cache";
+    } else if (header.formatVersion != FORMAT_VERSION || header.columnCount != COLUMN_COUNT) {
+        error = "has an unsupported format";
+    } else if (fingerprint.size() != sizeof(header.fingerprint)
+               || std::memcmp(header.fingerprint, fingerprint.data(), sizeof(header.fingerprint)) != 0) {
+        error = "is stale";
+    } else {
+        offsets_ = layout(header.blockCount, header.transactionCount, header.heapSize);
+        if (offsets_[COLUMN_COUNT] != file_.size()) {
+            error = "is truncated";
+        }
+    }
+
+    if (!error.empty()) {
+        throw std::runtime_error("Chain cache " + path + " " + error);
+    }
+
+    blockCount_ = header.blockCount;
+    transactionCount_ = header.transactionCount;
+}
+
+std::uint64_t Reader::blockCount() const
+{
+    return blockCount_;
+}
+
+std::uint64_t Reader::transactionCount() const
+{
+    return transactionCount_;
+}
+
+template<typename T>
+T Reader::value(int column, std::uint64_t index) const
+{
+    return file_.read<T>(offsets_[column] + index * sizeof(T));
+}
+
+bytes_t Reader::slot(int column, std::uint64_t index) const
+{
+    const auto *begin = file_.data() + offsets_[column] + index * COLUMNS[column].width;
+    return bytes_t(begin + 1, begin + 1 + begin[0]);
+}
+
+void Reader::forEachBlock(const std::function<void(const BlockRow &, const std::vector<TransactionRow> &)> &callback,
+                          height_t fromHeight, height_t toHeight) const
+{
+    const auto *heap = file_.data() + offsets_[AssetHeap];
+    std::vector<TransactionRow> transactions;
+
+    // Blocks are ordered by height, so the first one to read is found by bisection
+    std::uint64_t begin = 0;
+    std::uint64_t end = blockCount_;
+    while (begin < end) {
+        const auto middle = begin + (end - begin) / 2;
+        if (value<std::uint64_t>(BlockHeight, middle) < fromHeight) {
+            begin = middle + 1;
+        } else {
+            end = middle;
+        }
+    }
+
+    for (std::uint64_t i = begin; i < blockCount_; ++i) {
+        const auto height = value<std::uint64_t>(BlockHeight, i);
+        if (height > toHeight) break;
+
+        const auto blockId = value<std::uint64_t>(BlockId, i);
+
+        auto decode = [&]() {
+            Profiler::Scope scope("decoding"); static_cast<void>(scope);
+
+            BlockHeader bh(
+                value<std::uint32_t>(BlockVersion, i),
+                value<std::uint32_t>(BlockTimestamp, i),
+                value<std::uint64_t>(BlockPreviousBlock, i),
+                value<std::uint32_t>(BlockNumberOfTransactions, i),
+                value<std::uint64_t>(BlockTotalAmount, i),
+                value<std::uint64_t>(BlockTotalFee, i),
+                value<std::uint64_t>(BlockReward, i),
+                value<std::uint32_t>(BlockPayloadLength, i),
+                slot(BlockPayloadHash, i),
+                slot(BlockGeneratorPublicKey, i)
+            );
+
+            transactions.clear();
+            const auto first = value<std::uint64_t>(BlockFirstTransaction, i);
+            const auto count = value<std::uint32_t>(BlockTransactionCount, i);
+            for (auto j = first; j < first + count; ++j) {
+                const auto *asset = heap + value<std::uint64_t>(TransactionAssetOffset, j);
+                const auto assetLength = value<std::uint32_t>(TransactionAssetLength, j);
+                auto t = Transaction(
+                    value<std::uint8_t>(TransactionType, j),
+                    value<std::int32_t>(TransactionTimestamp, j),
+                    slot(TransactionSenderPublicKey, j),
+                    value<std::uint64_t>(TransactionRecipient, j),
+                    value<std::uint64_t>(TransactionAmount, j),
+                    value<std::uint64_t>(TransactionFee, j),
+                    bytes_t(asset, asset + assetLength),
+                    value<std::uint64_t>(TransactionDappId, j)
+                );
+                transactions.emplace_back(t, slot(TransactionSignature, j), slot(TransactionSecondSignature, j),
+                                          value<std::uint64_t>(TransactionId, j), blockId);
+            }
+
+            return BlockRow(bh, height, blockId, slot(BlockSignature, i));
+        };
+        const auto block = decode();
+
+        callback(block, transactions);
+    }
+}
+
+}
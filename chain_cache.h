@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <pqxx/pqxx>
+
+#include "binary_file.h"
+#include "block.h"
+#include "settings.h"
+#include "transaction.h"
+#include "types.h"
+
+// Columnar on-disk copy of the decoded blocks and transactions of a database.
+//
+// Every value is stored in a column of fixed width, ordered by block height. Transactions
+// are grouped per block, so the transactions of block i are the range
+// [firstTransaction[i], firstTransaction[i] + transactionCount[i]). Keys and signatures
+// live in fixed slots with a leading length byte, asset data in a heap of bytes.
+// The file is memory mapped for reading, so nothing needs to be parsed.
+namespace ChainCache {
+
+using fingerprint_t = std::vector<unsigned char>;
+
+// Identifies the chain data a cache was built from: the tip, row counts and a checksum of the
+// rows of the block, transaction and asset tables, the network settings that affect decoding and
+// the cache format version. Takes a scan of these tables on the database server. The checksum
+// detects other snapshots, not data crafted to collide, so a cache is only as trustworthy as this.
+fingerprint_t fingerprint(pqxx::read_transaction &db, Network network, const Settings &settings);
+
+std::string filePath(const std::string &cacheDir, const fingerprint_t &fingerprint);
+
+class Writer {
+public:
+    Writer();
+
+    // Returns false without adding anything if a key, hash or signature is longer than its slot.
+    // The validators report such values, so a chain containing them is not cached.
+    bool addBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions);
+
+    // Writes to a temporary file first, so an interrupted write never leaves a readable cache
+    void write(const std::string &path, const fingerprint_t &fingerprint) const;
+
+private:
+    std::vector<std::vector<unsigned char>> columns_;
+    std::uint64_t blockCount_ = 0;
+    std::uint64_t transactionCount_ = 0;
+};
+
+class Reader {
+public:
+    // Throws std::runtime_error if the file is missing, truncated or has a different fingerprint
+    Reader(const std::string &path, const fingerprint_t &fingerprint);
+
+    std::uint64_t blockCount() const;
+    std::uint64_t transactionCount() const;
+
+    // Calls callback for every block with height in [fromHeight, toHeight]
+    void forEachBlock(const std::function<void(const BlockRow &, const std::vector<TransactionRow> &)> &callback,
+                      height_t fromHeight = 1, height_t toHeight = std::numeric_limits<height_t>::max()) const;
+
+private:
+    template<typename T> T value(int column, std::uint64_t index) const;
+    bytes_t slot(int column, std::uint64_t index) const;
+
+    MappedFile file_;
+    std::uint64_t blockCount_ = 0;
+    std::uint64_t transactionCount_ = 0;
+    std::vector<std::uint64_t> offsets_;
+};
+
+}
@@ -0,0 +1,210 @@
+#include "checkpoint.h"
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <utility>
+
+#include <sodium.h>
+
+#include "binary_file.h"
+#include "serialization.h"
+
+namespace {
+
+const std::string MAGIC = "LSKCHKPT";
+const std::uint32_t FORMAT_VERSION = 2;
+
+using Serialization::Array;
+using Serialization::Bytes;
+using Serialization::Little;
+using Serialization::PaddedBytes;
+
+// All integers are little endian
+using HeaderLayout = Serialization::Layout<
+    Bytes<8>, // magic
+    Little<std::uint32_t>, // format version
+    Little<std::uint32_t>, // network
+    Little<std::uint64_t>, // height
+    Little<std::uint64_t>, // block ID
+    Bytes<crypto_hash_sha256_BYTES>, // block hash
+    Bytes<crypto_hash_sha256_BYTES>, // chain fingerprint
+    Little<std::uint64_t>, // round fees
+    Array<Little<std::uint64_t>, 101>, // round delegates
+    Array<Little<std::uint64_t>, 101>, // round rewards
+    Little<std::uint64_t>, // account count
+    Little<std::uint64_t>, // dapp owner count
+    Little<std::uint64_t> // name heap size
+>;
+
+using AccountLayout = Serialization::Layout<
+    Little<std::uint64_t>, // address
+    Little<std::int64_t>, // balance
+    Little<std::uint64_t>, // last block ID
+    Little<std::uint32_t>, // name offset in name heap
+    Little<std::uint16_t>, // name length
+    Little<std::uint8_t>, // second pubkey length
+    Little<std::uint8_t>, // reserved
+    PaddedBytes<32> // second pubkey, of the length above
+>;
+static_assert(AccountLayout::size == 64, "Account records are 64 bytes");
+
+using DappOwnerLayout = Serialization::Layout<
+    Little<std::uint64_t>, // dapp ID
+    Little<std::uint64_t> // owner
+>;
+
+struct Counts {
+    std::uint64_t accounts;
+    std::uint64_t dappOwners;
+    std::uint64_t nameHeapSize;
+};
+
+std::uint64_t fileSize(const Counts &counts)
+{
+    return align8(HeaderLayout::size)
+            + counts.accounts * AccountLayout::size
+            + counts.dappOwners * DappOwnerLayout::size
+            + counts.nameHeapSize;
+}
+
+}
+
+namespace Checkpoints {
+
+std::string filePath(const std::string &checkpointDir, Network network, height_t height)
+{
+    return checkpointDir + "/checkpoint-" + networkName(network) + "-" + std::to_string(height) + ".bin";
+}
+
+std::string trustedFilePath(const std::string &checkpointDir, Network network)
+{
+    return checkpointDir + "/trusted-" + networkName(network) + ".bin";
+}
+
+void write(const std::string &path, const Checkpoint &checkpoint, const BlockchainState &state)
+{
+    std::vector<address_t> addresses;
+    addresses.reserve(state.addressSummaries.size());
+    for (const auto &entry : state.addressSummaries) {
+        addresses.push_back(entry.first);
+    }
+    std::sort(addresses.begin(), addresses.end());
+
+    std::vector<std::pair<std::uint64_t, address_t>> dappOwners(state.dappOwners.begin(), state.dappOwners.end());
+    std::sort(dappOwners.begin(), dappOwners.end());
+
+    if (checkpoint.blockHash.size() != crypto_hash_sha256_BYTES
+            || checkpoint.position.chainFingerprint.size() != crypto_hash_sha256_BYTES) {
+        throw std::runtime_error("Invalid block hash for checkpoint");
+    }
+
+    std::string nameHeap;
+    std::vector<unsigned char> accounts(addresses.size() * AccountLayout::size);
+    for (std::size_t i = 0; i < addresses.size(); ++i) {
+        const auto address = addresses[i];
+        const auto &summary = state.addressSummaries.at(address);
+        if (summary.secondPubkey.size() > 32) {
+            throw std::runtime_error("Second pubkey of address " + std::to_string(address) + " too long for checkpoint");
+        }
+        if (summary.delegateName.size() > 0xffff) {
+            throw std::runtime_error("Delegate name of address " + std::to_string(address) + " too long for checkpoint");
+        }
+
+        AccountLayout::write(&accounts[i * AccountLayout::size], address, summary.balance, summary.lastBlockId,
+                             static_cast<std::uint32_t>(nameHeap.size()),
+                             static_cast<std::uint16_t>(summary.delegateName.size()),
+                             static_cast<std::uint8_t>(summary.secondPubkey.size()), std::uint8_t{0},
+                             summary.secondPubkey);
+        nameHeap += summary.delegateName;
+    }
+
+    std::vector<unsigned char> dappOwnerRecords(dappOwners.size() * DappOwnerLayout::size);
+    for (std::size_t i = 0; i < dappOwners.size(); ++i) {
+        DappOwnerLayout::write(&dappOwnerRecords[i * DappOwnerLayout::size], dappOwners[i].first, dappOwners[i].second);
+    }
+
+    unsigned char header[HeaderLayout::size];
+    const auto &position = checkpoint.position;
+    HeaderLayout::write(header, MAGIC, FORMAT_VERSION, static_cast<std::uint32_t>(checkpoint.network),
+                        position.height, position.blockId, checkpoint.blockHash, position.chainFingerprint,
+                        position.roundFees, position.roundDelegates, position.roundRewards,
+                        std::uint64_t{addresses.size()}, std::uint64_t{dappOwners.size()},
+                        std::uint64_t{nameHeap.size()});
+
+    AtomicFileWriter out(path);
+    out.write(header, sizeof(header));
+    out.padTo(align8(HeaderLayout::size));
+    out.write(accounts.data(), accounts.size());
+    out.write(dappOwnerRecords.data(), dappOwnerRecords.size());
+    out.write(nameHeap.data(), nameHeap.size());
+    out.commit();
+}
+
+Checkpoint read(const std::string &path, BlockchainState &state)
+{
+    MappedFile file(path);
+    if (file.size() < HeaderLayout::size) {
+        throw std::runtime_error("Checkpoint " + path + " is truncated");
+    }
+
+    std::array<unsigned char, 8> magic;
+    std::uint32_t formatVersion;
+    std::uint32_t network;
+    Counts counts;
+    Checkpoint out;
+    auto &position = out.position;
+    HeaderLayout::read(file.data(), magic, formatVersion, network, position.height, position.blockId, out.blockHash,
+                       position.chainFingerprint, position.roundFees, position.roundDelegates, position.roundRewards,
+                       counts.accounts, counts.dappOwners, counts.nameHeapSize);
+    if (std::string(magic.begin(), magic.end()) != MAGIC) {
+        throw std::runtime_error(path + " is not a checkpoint");
+    }
+    if (formatVersion != FORMAT_VERSION) {
+        throw std::runtime_error("Checkpoint " + path + " has an unsupported format");
+    }
+    if (fileSize(counts) != file.size()) {
+        throw std::runtime_error("Checkpoint " + path + " is truncated");
+    }
+    out.network = static_cast<Network>(network);
+
+    const auto accountsOffset = align8(HeaderLayout::size);
+    const auto dappOwnersOffset = accountsOffset + counts.accounts * AccountLayout::size;
+    const auto nameHeapOffset = dappOwnersOffset + counts.dappOwners * DappOwnerLayout::size;
+    const auto *nameHeap = reinterpret_cast<const char *>(file.data() + nameHeapOffset);
+
+    state.addressSummaries.reserve(counts.accounts);
+    for (std::uint64_t i = 0; i < counts.accounts; ++i) {
+        address_t address;
+        std::int64_t balance;
+        std::uint64_t lastBlockId;
+        std::uint32_t nameOffset;
+        std::uint16_t nameLength;
+        std::uint8_t secondPubkeyLength;
+        std::uint8_t reserved;
+        std::array<unsigned char, 32> secondPubkey;
+        AccountLayout::read(file.data() + accountsOffset + i * AccountLayout::size, address, balance, lastBlockId,
+                            nameOffset, nameLength, secondPubkeyLength, reserved, secondPubkey);
+        if (std::uint64_t{nameOffset} + nameLength > counts.nameHeapSize || secondPubkeyLength > secondPubkey.size()) {
+            throw std::runtime_error("Checkpoint " + path + " contains an invalid account record");
+        }
+
+        auto &summary = state.addressSummaries[address];
+        summary.balance = balance;
+        summary.lastBlockId = lastBlockId;
+        summary.secondPubkey.assign(secondPubkey.begin(), secondPubkey.begin() + secondPubkeyLength);
+        summary.delegateName.assign(nameHeap + nameOffset, nameLength);
+    }
+    state.addressSummaries.resetDirtyKeys();
+
+    for (std::uint64_t i = 0; i < counts.dappOwners; ++i) {
+        std::uint64_t dappId;
+        address_t owner;
+        DappOwnerLayout::read(file.data() + dappOwnersOffset + i * DappOwnerLayout::size, dappId, owner);
+        state.dappOwners[dappId] = owner;
+    }
+
+    return out;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+
+#include "blockchain_state.h"
+#include "replay.h"
+#include "settings.h"
+#include "types.h"
+
+struct Checkpoint {
+    Network network;
+    ReplayPosition position;
+    bytes_t blockHash; // SHA-256 of the block at position.height including its signature
+};
+
+// Binary checkpoint files of the replay at a round boundary.
+//
+// After a fixed header, accounts are stored as 64 byte records sorted by address,
+// followed by the dapp owners sorted by dapp ID and a heap of delegate names. The layouts in
+// checkpoint.cpp define all fields, with integers in little endian on every host.
+namespace Checkpoints {
+
+std::string filePath(const std::string &checkpointDir, Network network, height_t height);
+// Checkpoint of the last complete round of the last run that passed all checks
+std::string trustedFilePath(const std::string &checkpointDir, Network network);
+
+void write(const std::string &path, const Checkpoint &checkpoint, const BlockchainState &state);
+
+// Restores state from the file. Throws std::runtime_error for invalid files.
+Checkpoint read(const std::string &path, BlockchainState &state);
+
+}
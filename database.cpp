@@ -0,0 +1,379 @@
+#include "database.h"
+
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+#include "assets.h"
+#include "lisk.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "scopedbenchmark.h"
+#include "utils.h"
+
+namespace Database {
+
+namespace {
+
+// Rows decoded by one task of readTransactions
+const std::size_t DECODE_CHUNK_ROWS = 20000;
+
+// Appends the transactions of rows [begin, end) of result to out, and their IDs to ids if given
+void decodeRows(const pqxx::result &result, std::size_t begin, std::size_t end,
+                const Settings &settings, BlockTransactions &out, std::vector<std::uint64_t> *ids)
+{
+    Profiler::Scope scope("decoding", Profiler::Traced); static_cast<void>(scope);
+    for (std::size_t rowIndex = begin; rowIndex < end; ++rowIndex) {
+        const auto row = result[rowIndex];
+        try {
+            // Read fields in row
+            int index = 0;
+            const auto dbId = row[index++].as<std::uint64_t>();
+            if (ids) ids->push_back(dbId);
+            const auto dbBockId = row[index++].as<std::uint64_t>();
+            const auto dbType = row[index++].as<int>();
+            const auto dbTimestamp = row[index++].as<std::int32_t>();
+            const auto dbSenderPublicKey = pqxx::binarystring(row[index++]);
+            std::uint64_t dbRecipientId;
+            if (settings.exceptions.transactionsContainingInvalidRecipientAddress.count(dbId)) {
+                index++;
+                dbRecipientId = TRASH;
+            } else {
+                dbRecipientId = row[index++].as<std::uint64_t>();
+            }
+            const auto dbAmount = row[index++].as<std::uint64_t>();
+            const auto dbFee = row[index++].as<std::uint64_t>();
+            const auto dbSignature = pqxx::binarystring(row[index++]);
+            const auto dbSecondSignature = pqxx::binarystring(row[index++]);
+            const auto dbType0Asset = pqxx::binarystring(row[index++]);
+            const auto dbType1Asset = pqxx::binarystring(row[index++]);
+            const auto dbType2Asset = row[index++].get<std::string>();
+            const auto dbType3Asset = row[index++].get<std::string>();
+            const auto dbType4AssetMin = row[index++].as<int>();
+            const auto dbType4AssetLifetime = row[index++].as<int>();
+            const auto dbType4AssetKeys = row[index++].get<std::string>();
+            const auto dbType5AssetText = row[index++].get<std::string>();
+            const auto dbType5AssetType = row[index++].as<std::uint32_t>();
+            const auto dbType5AssetCategory = row[index++].as<std::uint32_t>();
+            const auto dbType6AssetDappId = row[index++].as<std::uint64_t>();
+            const auto dbType7AssetDappId = row[index++].as<std::uint64_t>();
+            const auto dbType7AssetDappOutTransferId = row[index++].as<std::uint64_t>();
+
+            // Parse fields in row
+            const auto senderPublicKey = asVector(dbSenderPublicKey);
+            const auto signature = asVector(dbSignature);
+            const auto secondSignature = asVector(dbSecondSignature);
+
+            std::uint64_t dappId = 0;
+            std::vector<unsigned char> assetData = {};
+            switch (dbType) {
+            case 0:
+                assetData = asVector(dbType0Asset);
+                break;
+            case 1:
+                assetData = asVector(dbType1Asset);
+                break;
+            case 2:
+                assetData = asVector(*dbType2Asset);
+                break;
+            case 3:
+                assetData = asVector(*dbType3Asset);
+                break;
+            case 4: {
+                assetData.push_back(static_cast<std::uint8_t>(dbType4AssetMin));
+                assetData.push_back(static_cast<std::uint8_t>(dbType4AssetLifetime));
+                auto keys = asVector(*dbType4AssetKeys);
+                assetData.insert(assetData.end(), keys.cbegin(), keys.cend());
+                break;
+            }
+            case 5:
+                assetData = asVector(*dbType5AssetText);
+                assetData.push_back((dbType5AssetType >> 0*8) & 0xff);
+                assetData.push_back((dbType5AssetType >> 1*8) & 0xff);
+                assetData.push_back((dbType5AssetType >> 2*8) & 0xff);
+                assetData.push_back((dbType5AssetType >> 3*8) & 0xff);
+                assetData.push_back((dbType5AssetCategory >> 0*8) & 0xff);
+                assetData.push_back((dbType5AssetCategory >> 1*8) & 0xff);
+                assetData.push_back((dbType5AssetCategory >> 2*8) & 0xff);
+                assetData.push_back((dbType5AssetCategory >> 3*8) & 0xff);
+                break;
+            case 6:
+                appendDecimal(assetData, dbType6AssetDappId);
+                dappId = dbType6AssetDappId;
+                break;
+            case 7:
+                appendDecimal(assetData, dbType7AssetDappId);
+                appendDecimal(assetData, dbType7AssetDappOutTransferId);
+                dappId = dbType7AssetDappId;
+                break;
+            }
+
+            auto t = Transaction(
+                dbType,
+                dbTimestamp,
+                senderPublicKey,
+                dbRecipientId,
+                dbAmount,
+                dbFee,
+                std::move(assetData),
+                dappId
+            );
+            out[dbBockId].emplace_back(t, signature, secondSignature, dbId, dbBockId);
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Exception '" << e.what() << "' when reading row:\n";
+            for (int i = 0; i < row.size(); ++i)
+            {
+                if (i > 0) std::cout << "|";
+                std::cout << std::string(row[i].c_str());
+            }
+            std::cout << std::endl;
+            throw;
+        }
+    }
+
+}
+
+// filter: empty or a WHERE clause on the joined tables
+BlockTransactions readTransactionsWhere(pqxx::transaction_base &db, const Settings &settings,
+                                        const std::string &filter, TransactionStatistics *statistics, ThreadPool *pool)
+{
+    std::cout << "Reading transactions ..." << std::endl;
+    ScopedBenchmark benchmarkTransactions("Reading transactions"); static_cast<void>(benchmarkTransactions);
+    PerfCounters::Stage perfStage("transaction ingestion"); static_cast<void>(perfStage);
+
+    BlockTransactions blockToTransactions;
+
+    pqxx::result result;
+    {
+        Profiler::Scope scope("query", Profiler::Traced); static_cast<void>(scope);
+        result = db.exec(R"SQL(
+            SELECT
+                id, "blockId", trs.type, timestamp, "senderPublicKey", coalesce(left("recipientId", -1), '0') AS recipient_address,
+                amount, fee, signature, "signSignature",
+                )SQL" + std::string(settings.v100Compatible ? "transfer.data" : "''") + R"SQL( AS type0_asset,
+                signatures."publicKey" AS type1_asset,
+                delegates.username AS type2_asset,
+                replace(votes.votes, ',', '') AS type3_asset,
+                coalesce(multisignatures.min, 0) AS type4_asset_min, coalesce(multisignatures.lifetime, 0) AS type4_asset_lifetime,
+                replace(multisignatures.keysgroup, ',', '') AS type4_asset_keys,
+                (coalesce(dapps.name, '') || coalesce(dapps.description, '') || coalesce(dapps.tags, '') || coalesce(dapps.link, '') || coalesce(dapps.icon, '')) AS type5_asset_texts,
+                coalesce(dapps.type, 0) AS type5_asset_type, coalesce(dapps.category, 0) AS type5_asset_category,
+                coalesce(intransfer."dappId", '0') AS type6_asset,
+                coalesce(outtransfer."dappId", '0') AS type7_asset_dappid,
+                coalesce(outtransfer."outTransactionId", '0') AS type7_asset_outtransactionId
+            FROM trs
+            )SQL" + std::string(settings.v100Compatible ? "LEFT JOIN transfer ON trs.id = transfer.\"transactionId\"" : "") + R"SQL(
+            LEFT JOIN signatures ON trs.id = signatures."transactionId"
+            LEFT JOIN delegates ON trs.id = delegates."transactionId"
+            LEFT JOIN votes ON trs.id = votes."transactionId"
+            LEFT JOIN multisignatures ON trs.id = multisignatures."transactionId"
+            LEFT JOIN dapps ON trs.id = dapps."transactionId"
+            LEFT JOIN intransfer ON trs.id = intransfer."transactionId"
+            LEFT JOIN outtransfer ON trs.id = outtransfer."transactionId"
+            )SQL" + filter + R"SQL(
+            ORDER BY "rowId"
+        )SQL");
+    }
+
+    // 8 bytes per transaction, sorted once at the end to find duplicates
+    std::vector<std::uint64_t> ids;
+    if (statistics) ids.reserve(result.size());
+
+    if (!pool || pool->workerCount() == 0 || result.size() <= DECODE_CHUNK_ROWS) {
+        decodeRows(result, 0, result.size(), settings, blockToTransactions, statistics ? &ids : nullptr);
+    } else {
+        // Chunks are decoded independently and merged in row order, so that the transactions of
+        // a block spanning two chunks keep their order
+        struct Chunk {
+            BlockTransactions blockToTransactions;
+            std::vector<std::uint64_t> ids;
+        };
+        std::vector<Chunk> chunks((result.size() + DECODE_CHUNK_ROWS - 1) / DECODE_CHUNK_ROWS);
+        {
+            ThreadPool::Group decoding(*pool);
+            for (std::size_t i = 0; i < chunks.size(); ++i) {
+                decoding.run([&, i]() {
+                    const auto begin = i * DECODE_CHUNK_ROWS;
+                    const auto end = std::min<std::size_t>(begin + DECODE_CHUNK_ROWS, result.size());
+                    decodeRows(result, begin, end, settings, chunks[i].blockToTransactions, statistics ? &chunks[i].ids : nullptr);
+                });
+            }
+            decoding.wait();
+        }
+
+        Profiler::Scope mergeScope("merging"); static_cast<void>(mergeScope);
+        for (auto &chunk : chunks) {
+            for (auto &entry : chunk.blockToTransactions) {
+                auto &transactions = blockToTransactions[entry.first];
+                if (transactions.empty()) {
+                    transactions = std::move(entry.second);
+                } else {
+                    // Blocks whose rows are in several chunks
+                    for (auto &transaction : entry.second) {
+                        transactions.push_back(std::move(transaction));
+                    }
+                }
+            }
+            ids.insert(ids.end(), chunk.ids.begin(), chunk.ids.end());
+            chunk = Chunk();
+        }
+    }
+
+    if (statistics) {
+        statistics->rowCount = ids.size();
+        std::sort(ids.begin(), ids.end());
+        for (std::size_t i = 1; i < ids.size(); ++i) {
+            if (ids[i] == ids[i-1] && (statistics->duplicateIds.empty() || statistics->duplicateIds.back() != ids[i])) {
+                statistics->duplicateIds.push_back(ids[i]);
+            }
+        }
+    }
+
+    return blockToTransactions;
+}
+
+}
+
+BlockTransactions readTransactions(pqxx::transaction_base &db, const Settings &settings,
+                                   height_t fromHeight, height_t toHeight,
+                                   TransactionStatistics *statistics, ThreadPool *pool)
+{
+    std::string heightFilter;
+    if (fromHeight > 1 || toHeight != MAX_HEIGHT) {
+        heightFilter = "WHERE \"blockId\" IN (SELECT id FROM blocks WHERE height BETWEEN " +
+                std::to_string(fromHeight) + " AND " + std::to_string(toHeight) + ")";
+    }
+    auto blockToTransactions = readTransactionsWhere(db, settings, heightFilter, statistics, pool);
+
+    if (statistics && fromHeight > 1) {
+        // The IDs of the range are unique among themselves; also compare them with the IDs of the
+        // transactions below it, which are not read
+        Profiler::Scope scope("query", Profiler::Traced); static_cast<void>(scope);
+        const auto repeated = db.exec(R"SQL(
+            SELECT DISTINCT id FROM trs
+            )SQL" + heightFilter + R"SQL(
+            AND id IN (SELECT id FROM trs WHERE "blockId" IN (SELECT id FROM blocks WHERE height < )SQL" +
+                std::to_string(fromHeight) + R"SQL())
+            ORDER BY id
+        )SQL");
+        for (auto row : repeated) {
+            statistics->duplicateIds.push_back(row[0].as<std::uint64_t>());
+        }
+    }
+
+    return blockToTransactions;
+}
+
+BlockTransactions readCheckedTransactions(pqxx::transaction_base &db, const Settings &settings,
+                                          height_t fromHeight, height_t toHeight,
+                                          TransactionStatistics &statistics, ThreadPool *pool)
+{
+    auto blockToTransactions = readTransactions(db, settings, fromHeight, toHeight, &statistics, pool);
+
+    if (!statistics.duplicateIds.empty()) {
+        Assets::validateAssetData(db, settings);
+        throw std::runtime_error("Transaction ID " + std::to_string(statistics.duplicateIds.front()) + " is not unique");
+    }
+
+    return blockToTransactions;
+}
+
+BlockTransactions readTransactionsOfAddress(pqxx::transaction_base &db, const Settings &settings, address_t address)
+{
+    const auto liskAddress = db.quote(std::to_string(address) + "L");
+    return readTransactionsWhere(db, settings,
+        "WHERE trs.\"senderId\" = " + liskAddress + " OR trs.\"recipientId\" = " + liskAddress +
+        " OR intransfer.\"dappId\" IN (SELECT id FROM trs WHERE type = 5 AND \"senderId\" = " + liskAddress + ")",
+        nullptr, nullptr);
+}
+
+bytes_t chainFingerprint(pqxx::transaction_base &db, height_t toHeight)
+{
+    auto out = initialChainFingerprint();
+    height_t lastHeight = 0;
+
+    pqxx::icursorstream cursor(db,
+        "SELECT height, id FROM blocks WHERE height <= " + std::to_string(toHeight) + " ORDER BY height",
+        "block_ids", 100000);
+    pqxx::result batch;
+    while (cursor >> batch) {
+        for (auto row : batch) {
+            const auto dbHeight = row[0].as<height_t>();
+            if (dbHeight != lastHeight + 1) {
+                throw std::runtime_error("Height mismatch");
+            }
+            lastHeight = dbHeight;
+            extendChainFingerprint(out, row[1].as<std::uint64_t>());
+        }
+    }
+
+    if (lastHeight != toHeight) {
+        throw std::runtime_error("Blocks end at height " + std::to_string(lastHeight) +
+                                 ", expected " + std::to_string(toHeight));
+    }
+    return out;
+}
+
+void readBlocks(pqxx::transaction_base &db, const std::function<void(const BlockRow &)> &callback,
+                height_t fromHeight, height_t toHeight)
+{
+    std::string heightFilter;
+    if (fromHeight > 1 || toHeight != MAX_HEIGHT) {
+        heightFilter = "WHERE height BETWEEN " + std::to_string(fromHeight) + " AND " + std::to_string(toHeight);
+    }
+
+    pqxx::result R;
+    {
+        Profiler::Scope scope("query", Profiler::Traced); static_cast<void>(scope);
+        R = db.exec(R"SQL(
+            SELECT
+                id, version, timestamp, height, "previousBlock", "numberOfTransactions", "totalAmount", "totalFee", reward,
+                "payloadLength", "payloadHash", "generatorPublicKey", "blockSignature"
+            FROM blocks
+            )SQL" + heightFilter + R"SQL(
+            ORDER BY height
+        )SQL");
+    }
+
+    for (auto row : R) {
+        auto decode = [&]() {
+            Profiler::Scope scope("decoding"); static_cast<void>(scope);
+
+            int index = 0;
+            const auto dbId = row[index++].as<std::uint64_t>();
+            const auto dbVersion = row[index++].as<std::uint32_t>();
+            const auto dbTimestamp = row[index++].as<std::uint32_t>();
+            const auto dbHeight = row[index++].as<std::uint64_t>();
+            const auto dbPreviousBlock = row[index++].get<std::uint64_t>();
+            const auto dbNumberOfTransactions = row[index++].as<std::uint32_t>();
+            const auto dbTotalAmount = row[index++].as<std::uint64_t>();
+            const auto dbTotalFee = row[index++].as<std::uint64_t>();
+            const auto dbReward = row[index++].as<std::uint64_t>();
+            const auto dbPayloadLength = row[index++].as<std::uint32_t>();
+            const auto dbPayloadHash = pqxx::binarystring(row[index++]);
+            const auto dbGeneratorPublicKey = pqxx::binarystring(row[index++]);
+            const auto dbSignature = pqxx::binarystring(row[index++]);
+
+            BlockHeader bh(
+                dbVersion,
+                dbTimestamp,
+                dbPreviousBlock ? *dbPreviousBlock : 0,
+                dbNumberOfTransactions,
+                dbTotalAmount,
+                dbTotalFee,
+                dbReward,
+                dbPayloadLength,
+                asVector(dbPayloadHash),
+                asVector(dbGeneratorPublicKey)
+            );
+
+            return BlockRow(bh, dbHeight, dbId, asVector(dbSignature));
+        };
+
+        callback(decode());
+    }
+}
+
+}
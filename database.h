@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <pqxx/pqxx>
+
+#include "block.h"
+#include "settings.h"
+#include "thread_pool.h"
+#include "transaction.h"
+
+namespace Database {
+
+using BlockTransactions = std::unordered_map<std::uint64_t, std::vector<TransactionRow>>;
+
+struct TransactionStatistics {
+    std::uint64_t rowCount = 0;
+    // IDs returned more than once by the joined query, i.e. not unique in trs or an asset table
+    std::vector<std::uint64_t> duplicateIds;
+};
+
+const height_t MAX_HEIGHT = std::numeric_limits<height_t>::max();
+
+// Transactions of blocks in [fromHeight, toHeight], grouped by block ID and ordered as stored
+// in the database. Without limits, this includes transactions not referenced by any block.
+// With pool, large results are decoded in parallel. With statistics and fromHeight > 1, the IDs are
+// also checked against those of the transactions in blocks below fromHeight.
+BlockTransactions readTransactions(pqxx::transaction_base &db, const Settings &settings,
+                                   height_t fromHeight = 1, height_t toHeight = MAX_HEIGHT,
+                                   TransactionStatistics *statistics = nullptr, ThreadPool *pool = nullptr);
+
+// readTransactions with statistics that throws std::runtime_error if a transaction ID is not unique,
+// after Assets::validateAssetData had the chance to name the table repeating it
+BlockTransactions readCheckedTransactions(pqxx::transaction_base &db, const Settings &settings,
+                                          height_t fromHeight, height_t toHeight,
+                                          TransactionStatistics &statistics, ThreadPool *pool = nullptr);
+
+// Transactions sent or received by address, including transfers into dapps registered by it
+BlockTransactions readTransactionsOfAddress(pqxx::transaction_base &db, const Settings &settings, address_t address);
+
+// Chain fingerprint (see extendChainFingerprint) of the blocks up to toHeight, reading only IDs.
+// Throws std::runtime_error if heights are not contiguous.
+bytes_t chainFingerprint(pqxx::transaction_base &db, height_t toHeight);
+
+// Calls callback for every block in [fromHeight, toHeight] ordered by height
+void readBlocks(pqxx::transaction_base &db, const std::function<void(const BlockRow &)> &callback,
+                height_t fromHeight = 1, height_t toHeight = MAX_HEIGHT);
+
+}
@@ -0,0 +1,629 @@
+#include "distributed.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "lisk.h"
+#include "profiler.h"
+#include "stateless_checks.h"
+#include "utils.h"
+
+namespace {
+
+// Requests sent to a worker before it answered the first, hiding the round trip over ssh
+const std::size_t REQUESTS_IN_FLIGHT = 2;
+
+std::string escape(const std::string &text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (auto c : text) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        default: out += c;
+        }
+    }
+    return out;
+}
+
+std::string unescape(const std::string &text)
+{
+    std::string out;
+    out.reserve(text.size());
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\') {
+            out += text[i];
+            continue;
+        }
+        if (++i == text.size()) {
+            throw std::runtime_error("Incomplete escape sequence");
+        }
+        switch (text[i]) {
+        case '\\': out += '\\'; break;
+        case 't': out += '\t'; break;
+        case 'n': out += '\n'; break;
+        default: throw std::runtime_error(std::string("Unknown escape sequence \\") + text[i]);
+        }
+    }
+    return out;
+}
+
+std::string protocolLine(const std::vector<std::string> &fields)
+{
+    std::string out;
+    for (const auto &field : fields) {
+        if (!out.empty()) out += '\t';
+        out += escape(field);
+    }
+    return out + '\n';
+}
+
+std::vector<std::string> protocolFields(const std::string &line)
+{
+    std::vector<std::string> out;
+    std::size_t begin = 0;
+    while (true) {
+        const auto end = line.find('\t', begin);
+        out.push_back(unescape(line.substr(begin, end == std::string::npos ? std::string::npos : end - begin)));
+        if (end == std::string::npos) return out;
+        begin = end + 1;
+    }
+}
+
+std::uint64_t parseNumber(const std::string &field)
+{
+    std::size_t parsed = 0;
+    std::uint64_t out = 0;
+    try {
+        out = std::stoull(field, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (parsed == 0 || parsed != field.size() || field[0] == '-') {
+        throw std::runtime_error("Expected a number, got '" + field + "'");
+    }
+    return out;
+}
+
+// Returns false if fd was closed or failed
+bool writeAll(int fd, const std::string &data)
+{
+    std::size_t written = 0;
+    while (written < data.size()) {
+        const auto result = ::write(fd, data.data() + written, data.size() - written);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        written += static_cast<std::size_t>(result);
+    }
+    return true;
+}
+
+std::string shellQuote(const std::string &text)
+{
+    std::string out = "'";
+    for (auto c : text) {
+        if (c == '\'') {
+            out += "'\\''";
+        } else {
+            out += c;
+        }
+    }
+    return out + "'";
+}
+
+}
+
+namespace Distributed {
+
+DataDigest::DataDigest()
+{
+    crypto_hash_sha256_init(&state_);
+}
+
+void DataDigest::add(const BlockRow &block, const std::vector<TransactionRow> &transactions)
+{
+    unsigned char header[BlockHeader::Layout::size];
+    block.header.serialize(header);
+    crypto_hash_sha256_update(&state_, header, sizeof(header));
+    // The layout pads or truncates these to 32 bytes
+    addBytes(block.header.payloadHash);
+    addBytes(block.header.generatorPublicKey);
+    addNumber(block.height);
+    addNumber(block.id);
+    addBytes(block.signature);
+
+    addNumber(transactions.size());
+    for (const auto &transactionRow : transactions) {
+        const auto &transaction = transactionRow.transaction;
+        unsigned char prefix[Transaction::PrefixLayout::size];
+        transaction.serializePrefix(prefix);
+        crypto_hash_sha256_update(&state_, prefix, sizeof(prefix));
+        addBytes(transaction.senderPublicKey);
+        addBytes(transaction.assetData);
+        addNumber(transaction.fee);
+        addNumber(transaction.dappId);
+        addNumber(transactionRow.id);
+        addNumber(transactionRow.blockId);
+        addBytes(transactionRow.signature);
+        addBytes(transactionRow.secondSignature);
+    }
+}
+
+bytes_t DataDigest::finish()
+{
+    bytes_t out(crypto_hash_sha256_BYTES);
+    crypto_hash_sha256_final(&state_, out.data());
+    crypto_hash_sha256_init(&state_);
+    return out;
+}
+
+void DataDigest::addNumber(std::uint64_t value)
+{
+    unsigned char bytes[8];
+    Serialization::Layout<Serialization::Little<std::uint64_t>>::write(bytes, value);
+    crypto_hash_sha256_update(&state_, bytes, sizeof(bytes));
+}
+
+void DataDigest::addBytes(const bytes_t &value)
+{
+    addNumber(value.size());
+    crypto_hash_sha256_update(&state_, value.data(), value.size());
+}
+
+void serveWorker(const RangeReader &read, Network network, const Settings &settings,
+                 SignatureCache *signatureCache, SignatureSampling *sampling, ThreadPool &pool, int outFd)
+{
+    auto send = [outFd](const std::string &lines) {
+        if (!writeAll(outFd, lines)) {
+            throw std::runtime_error(std::string("Could not write to the coordinator: ") + std::strerror(errno));
+        }
+    };
+
+    send(protocolLine({"ready", std::to_string(PROTOCOL_VERSION), networkName(network)}));
+
+    std::string request;
+    while (std::getline(std::cin, request)) {
+        try {
+            const auto fields = protocolFields(request);
+            if (fields.size() != 3 || fields[0] != "check") {
+                throw std::runtime_error("Unexpected request: " + request);
+            }
+            const height_t fromHeight = parseNumber(fields[1]);
+            const height_t toHeight = parseNumber(fields[2]);
+            if (fromHeight == 0 || toHeight < fromHeight) {
+                throw std::runtime_error("Invalid height range: " + request);
+            }
+
+            Profiler::Scope scope("range checks", Profiler::Traced); static_cast<void>(scope);
+            std::uint64_t blocks = 0;
+            std::uint64_t transactions = 0;
+            auto chainFingerprint = initialChainFingerprint();
+            DataDigest dataDigest;
+            const auto verifiedBefore = sampling ? sampling->verified() : 0;
+            const auto skippedBefore = sampling ? sampling->skipped() : 0;
+            // Blocks are checked on the pool while the range is read; failures are kept per block
+            // to report them in height order
+            struct CheckedBlock {
+                CheckedBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions)
+                    : block(block)
+                    , transactions(transactions)
+                {
+                }
+                BlockRow block;
+                std::vector<TransactionRow> transactions;
+                std::vector<FailureRecord> failures;
+            };
+            std::deque<CheckedBlock> checkedBlocks;
+            {
+                ThreadPool::Group checks(pool);
+                read(fromHeight, toHeight, [&](const BlockRow &block, const std::vector<TransactionRow> &blockTransactions) {
+                    ++blocks;
+                    transactions += blockTransactions.size();
+                    extendChainFingerprint(chainFingerprint, block.id);
+                    dataDigest.add(block, blockTransactions);
+                    checkedBlocks.emplace_back(block, blockTransactions);
+                    auto &checked = checkedBlocks.back();
+                    checks.run([&checked, &settings, signatureCache, sampling]() {
+                        StatelessChecks::run(checked.block, checked.transactions, settings, signatureCache, sampling, checked.failures);
+                    });
+                });
+                checks.wait();
+            }
+            std::vector<FailureRecord> failures;
+            for (auto &checked : checkedBlocks) {
+                failures.insert(failures.end(), checked.failures.begin(), checked.failures.end());
+            }
+
+            std::string reply;
+            for (const auto &failure : failures) {
+                reply += protocolLine({"failure", std::to_string(failure.height), std::to_string(failure.blockId),
+                                       std::to_string(failure.transactionId), failure.check, failure.expected,
+                                       failure.actual, failure.message});
+            }
+            reply += protocolLine({"checked", std::to_string(fromHeight), std::to_string(toHeight),
+                                   std::to_string(blocks), std::to_string(transactions), bytes2Hex(chainFingerprint),
+                                   bytes2Hex(dataDigest.finish()),
+                                   std::to_string(sampling ? sampling->verified() - verifiedBefore : 0),
+                                   std::to_string(sampling ? sampling->skipped() - skippedBefore : 0)});
+            send(reply);
+
+            std::cout << "Checked heights " << fromHeight << "-" << toHeight << ": " << blocks << " blocks, "
+                      << transactions << " transactions, " << failures.size() << " failures" << std::endl;
+        } catch (const std::exception &e) {
+            try {
+                send(protocolLine({"error", e.what()}));
+            } catch (const std::exception &) {
+                // the coordinator is gone
+            }
+            throw;
+        }
+    }
+}
+
+unsigned localWorkerThreads(const Options &options)
+{
+    const unsigned threads = options.threads > 0 ? options.threads : std::thread::hardware_concurrency();
+    const unsigned workers = options.localWorkers > 0 ? options.localWorkers : 1;
+    return std::max(1u, (threads > 1 ? threads - 1 : 0) / workers);
+}
+
+std::string localWorkerCommand(const Options &options)
+{
+    char path[PATH_MAX];
+    const auto length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (length < 0) {
+        throw std::runtime_error(std::string("Could not find the path of this program: ") + std::strerror(errno));
+    }
+    path[length] = '\0';
+
+    std::string command = shellQuote(path) + " --worker --threads " + std::to_string(localWorkerThreads(options));
+    if (options.sampleSignatures < 1) {
+        std::ostringstream fraction;
+        fraction << std::setprecision(17) << options.sampleSignatures;
+        command += " --sample-signatures " + fraction.str() + " --sample-seed " + std::to_string(options.sampleSeed);
+    }
+    return command + " " + networkName(options.network) + " " + shellQuote(options.databaseName);
+}
+
+Coordinator::Coordinator(const std::vector<std::string> &workerCommands, Network network,
+                         height_t fromHeight, height_t toHeight, height_t rangeSize)
+    : network_(network)
+    , toHeight_(toHeight)
+    , nextHeight_(fromHeight)
+    , chainFingerprint_(initialChainFingerprint())
+{
+    if (workerCommands.empty() || rangeSize == 0) {
+        throw std::runtime_error("Distributed validation needs at least one worker and a range size");
+    }
+
+    current_.range = Range{0, 0};
+    for (height_t height = fromHeight; height <= toHeight; height += rangeSize) {
+        unassigned_.push_back(Range{height, std::min(toHeight, height + rangeSize - 1)});
+    }
+    if (unassigned_.empty()) return;
+
+    workers_.resize(workerCommands.size());
+    try {
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            workers_[i].command = workerCommands[i];
+            start(workers_[i]);
+        }
+    } catch (const std::exception &) {
+        stopAll(true);
+        throw;
+    }
+
+    std::cout << "Started " << workers_.size() << " workers checking " << unassigned_.size()
+              << " ranges of " << rangeSize << " blocks up to height " << toHeight << std::endl;
+    dispatcher_ = std::thread(&Coordinator::dispatch, this);
+}
+
+Coordinator::~Coordinator()
+{
+    stopAll(true);
+}
+
+void Coordinator::start(Worker &worker)
+{
+    int toWorker[2];
+    int fromWorker[2];
+    if (pipe2(toWorker, O_CLOEXEC) != 0) {
+        throw std::runtime_error(std::string("Could not create a pipe: ") + std::strerror(errno));
+    }
+    if (pipe2(fromWorker, O_CLOEXEC) != 0) {
+        const auto error = errno;
+        close(toWorker[0]);
+        close(toWorker[1]);
+        throw std::runtime_error(std::string("Could not create a pipe: ") + std::strerror(error));
+    }
+
+    const auto pid = fork();
+    if (pid < 0) {
+        const auto error = errno;
+        for (auto fd : {toWorker[0], toWorker[1], fromWorker[0], fromWorker[1]}) close(fd);
+        throw std::runtime_error(std::string("Could not start worker: ") + std::strerror(error));
+    }
+    if (pid == 0) {
+        // Own process group, so that stopping the worker also stops what the shell started
+        setpgid(0, 0);
+        dup2(toWorker[0], STDIN_FILENO);
+        dup2(fromWorker[1], STDOUT_FILENO);
+        execl("/bin/sh", "sh", "-c", worker.command.c_str(), static_cast<char *>(nullptr));
+        _exit(127);
+    }
+
+    close(toWorker[0]);
+    close(fromWorker[1]);
+    worker.pid = pid;
+    worker.inFd = toWorker[1];
+    worker.outFd = fromWorker[0];
+}
+
+void Coordinator::dispatch()
+{
+    // Writing to a worker that went away must fail with EPIPE instead of ending the process
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+
+    std::vector<pollfd> fds;
+    std::vector<Worker *> polled;
+    while (!stopping_) {
+        fds.clear();
+        polled.clear();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &worker : workers_) {
+                if (worker.running) {
+                    fds.push_back(pollfd{worker.outFd, POLLIN, 0});
+                    polled.push_back(&worker);
+                }
+            }
+        }
+        if (fds.empty()) return;
+
+        // Wakes up regularly to notice stopping_
+        if (poll(fds.data(), fds.size(), 200) < 0) {
+            if (errno == EINTR) continue;
+            std::lock_guard<std::mutex> lock(mutex_);
+            error_ = std::string("Waiting for workers failed: ") + std::strerror(errno);
+            resultArrived_.notify_all();
+            return;
+        }
+
+        for (std::size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) continue;
+
+            char buffer[65536];
+            const auto received = ::read(fds[i].fd, buffer, sizeof(buffer));
+            const auto readError = errno;
+            if (received < 0 && readError == EINTR) continue;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto &worker = *polled[i];
+            if (received <= 0) {
+                stopWorker(worker, received == 0 ? "exited" : std::strerror(readError));
+                continue;
+            }
+
+            worker.received.append(buffer, static_cast<std::size_t>(received));
+            std::size_t end;
+            while (worker.running && (end = worker.received.find('\n')) != std::string::npos) {
+                const auto line = worker.received.substr(0, end);
+                worker.received.erase(0, end + 1);
+                handleLine(worker, line);
+            }
+        }
+    }
+}
+
+void Coordinator::handleLine(Worker &worker, const std::string &line)
+{
+    try {
+        const auto fields = protocolFields(line);
+        const auto &type = fields[0];
+
+        if (type == "ready" && fields.size() == 3 && !worker.ready) {
+            if (fields[1] != std::to_string(PROTOCOL_VERSION) || fields[2] != networkName(network_)) {
+                stopWorker(worker, "speaks protocol " + fields[1] + " for " + fields[2] + ", expected protocol " +
+                           std::to_string(PROTOCOL_VERSION) + " for " + networkName(network_));
+                return;
+            }
+            worker.ready = true;
+            assign(worker);
+        } else if (type == "failure" && fields.size() == 8 && !worker.assigned.empty()) {
+            worker.failures.push_back({parseNumber(fields[1]), parseNumber(fields[2]), parseNumber(fields[3]),
+                                       fields[4], fields[7], fields[5], fields[6]});
+        } else if (type == "checked" && fields.size() == 9 && !worker.assigned.empty()) {
+            const auto range = worker.assigned.front();
+            if (parseNumber(fields[1]) != range.fromHeight || parseNumber(fields[2]) != range.toHeight) {
+                stopWorker(worker, "answered for heights " + fields[1] + "-" + fields[2] + " instead of " +
+                           std::to_string(range.fromHeight) + "-" + std::to_string(range.toHeight));
+                return;
+            }
+            Result result;
+            result.range = range;
+            result.blocks = parseNumber(fields[3]);
+            result.transactions = parseNumber(fields[4]);
+            result.chainFingerprint = hex2Bytes(fields[5]);
+            result.dataDigest = hex2Bytes(fields[6]);
+            result.signaturesVerified = parseNumber(fields[7]);
+            result.signaturesSkipped = parseNumber(fields[8]);
+            result.failures.swap(worker.failures);
+            worker.assigned.pop_front();
+            results_[range.fromHeight] = std::move(result);
+            resultArrived_.notify_all();
+            assign(worker);
+        } else if (type == "error" && fields.size() == 2) {
+            stopWorker(worker, fields[1]);
+        } else {
+            stopWorker(worker, "sent an unexpected line: " + line);
+        }
+    } catch (const std::exception &e) {
+        stopWorker(worker, std::string("sent an invalid line: ") + e.what());
+    }
+}
+
+void Coordinator::assign(Worker &worker)
+{
+    while (worker.running && worker.ready && worker.assigned.size() < REQUESTS_IN_FLIGHT && !unassigned_.empty()) {
+        const auto range = unassigned_.front();
+        if (!writeAll(worker.inFd, protocolLine({"check", std::to_string(range.fromHeight), std::to_string(range.toHeight)}))) {
+            stopWorker(worker, std::string("could not send a request: ") + std::strerror(errno));
+            return;
+        }
+        unassigned_.pop_front();
+        worker.assigned.push_back(range);
+    }
+}
+
+void Coordinator::stopWorker(Worker &worker, const std::string &reason)
+{
+    if (!worker.running) return;
+    worker.running = false;
+    std::cerr << "Worker " << worker.command << " stopped: " << reason << std::endl;
+
+    close(worker.inFd);
+    close(worker.outFd);
+    worker.inFd = -1;
+    worker.outFd = -1;
+    kill(-worker.pid, SIGTERM);
+
+    // The remaining workers take over, in height order
+    for (auto range = worker.assigned.rbegin(); range != worker.assigned.rend(); ++range) {
+        unassigned_.push_front(*range);
+    }
+    worker.assigned.clear();
+    worker.failures.clear();
+
+    const auto running = std::count_if(workers_.begin(), workers_.end(), [](const Worker &other) { return other.running; });
+    if (running == 0) {
+        error_ = "All workers stopped, the last one: " + reason;
+        resultArrived_.notify_all();
+        return;
+    }
+    for (auto &other : workers_) {
+        assign(other);
+    }
+}
+
+void Coordinator::stopAll(bool terminate)
+{
+    stopping_ = true;
+    if (dispatcher_.joinable()) {
+        dispatcher_.join();
+    }
+
+    for (auto &worker : workers_) {
+        if (worker.pid <= 0) continue;
+        // Workers exit when their stdin is closed
+        if (worker.inFd >= 0) close(worker.inFd);
+        if (worker.outFd >= 0) close(worker.outFd);
+        worker.inFd = -1;
+        worker.outFd = -1;
+        if (terminate && worker.running) {
+            kill(-worker.pid, SIGTERM);
+        }
+        int status;
+        while (waitpid(worker.pid, &status, 0) < 0 && errno == EINTR) {
+        }
+        worker.pid = -1;
+        worker.running = false;
+    }
+}
+
+std::vector<FailureRecord> Coordinator::checkedBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions)
+{
+    if (block.height != nextHeight_ || block.height > toHeight_) {
+        throw std::runtime_error("Block at height " + std::to_string(block.height) + " was not checked by workers");
+    }
+
+    // Ranges are contiguous, so the next one starts at this block
+    if (block.height > current_.range.toHeight) {
+        Profiler::Scope scope("waiting for workers", Profiler::Traced); static_cast<void>(scope);
+        std::unique_lock<std::mutex> lock(mutex_);
+        resultArrived_.wait(lock, [&]() { return results_.count(block.height) || !error_.empty(); });
+        auto result = results_.find(block.height);
+        if (result == results_.end()) {
+            throw std::runtime_error(error_);
+        }
+        current_ = std::move(result->second);
+        results_.erase(result);
+        nextFailure_ = 0;
+        transactions_ = 0;
+        chainFingerprint_ = initialChainFingerprint();
+    }
+
+    std::vector<FailureRecord> failures;
+    while (nextFailure_ < current_.failures.size() && current_.failures[nextFailure_].height == block.height) {
+        failures.push_back(current_.failures[nextFailure_++]);
+    }
+
+    extendChainFingerprint(chainFingerprint_, block.id);
+    transactions_ += transactions.size();
+    {
+        Profiler::Scope scope("data digest"); static_cast<void>(scope);
+        dataDigest_.add(block, transactions);
+    }
+    if (block.height == current_.range.toHeight) {
+        const auto rangeName = std::to_string(current_.range.fromHeight) + "-" + std::to_string(current_.range.toHeight);
+        const auto expectedBlocks = current_.range.toHeight - current_.range.fromHeight + 1;
+        if (current_.blocks != expectedBlocks || current_.chainFingerprint != chainFingerprint_) {
+            throw std::runtime_error("A worker read other blocks in heights " + rangeName + ": " +
+                                     std::to_string(current_.blocks) + " blocks with chain fingerprint " +
+                                     bytes2Hex(current_.chainFingerprint) + ", expected " +
+                                     std::to_string(expectedBlocks) + " blocks with " + bytes2Hex(chainFingerprint_));
+        }
+        const auto dataDigest = dataDigest_.finish();
+        if (current_.transactions != transactions_ || current_.dataDigest != dataDigest) {
+            throw std::runtime_error("A worker read other block or transaction data in heights " + rangeName + ": " +
+                                     std::to_string(current_.transactions) + " transactions with data digest " +
+                                     bytes2Hex(current_.dataDigest) + ", expected " +
+                                     std::to_string(transactions_) + " transactions with " + bytes2Hex(dataDigest));
+        }
+        signaturesVerified_ += current_.signaturesVerified;
+        signaturesSkipped_ += current_.signaturesSkipped;
+    }
+
+    ++nextHeight_;
+    return failures;
+}
+
+void Coordinator::finish()
+{
+    if (nextHeight_ <= toHeight_) {
+        throw std::runtime_error("Workers checked blocks up to height " + std::to_string(toHeight_) +
+                                 " but the replay ended at height " + std::to_string(nextHeight_ - 1));
+    }
+    stopAll(false);
+}
+
+std::uint64_t Coordinator::signaturesVerified() const
+{
+    return signaturesVerified_;
+}
+
+std::uint64_t Coordinator::signaturesSkipped() const
+{
+    return signaturesSkipped_;
+}
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sodium.h>
+#include <sys/types.h>
+
+#include "block.h"
+#include "failure_collector.h"
+#include "options.h"
+#include "settings.h"
+#include "signature_cache.h"
+#include "signature_sampling.h"
+#include "thread_pool.h"
+#include "transaction.h"
+#include "types.h"
+
+// Validation split across processes, possibly on other machines. Workers run the checks not
+// depending on the blockchain state (block IDs, signatures, rewards and payloads, transaction
+// IDs, first signatures, amounts and fees) for height ranges of their own copy of the chain.
+// The coordinator replays the chain without these checks and takes the failures from the workers.
+// Both hash the data of every range, so the coordinator only replays data the workers checked.
+//
+// Workers talk a line protocol on stdin and stdout, so any command running
+// `snapshot-validator --worker`, locally or through ssh, can be a worker. Fields are separated
+// by tabs; backslashes, tabs and newlines in text are escaped as \\, \t and \n.
+//
+//     worker:      ready <protocol version> <network>
+//     coordinator: check <from height> <to height>
+//     worker:      failure <height> <block ID> <transaction ID> <check> <expected> <actual> <message>
+//                  (once per failed check)
+//     worker:      checked <from height> <to height> <blocks> <transactions> <chain fingerprint>
+//                          <data digest> <signatures verified> <signatures skipped>
+//     worker:      error <message>
+//                  (the worker cannot continue)
+//
+// The chain fingerprint (see extendChainFingerprint) covers the IDs of the blocks of the range, so
+// the coordinator notices workers reading a different chain, the data digest (see DataDigest) all
+// fields of the blocks and transactions. Signatures skipped by --sample-signatures of the worker
+// are counted. A worker exits when stdin is closed.
+namespace Distributed {
+
+const int PROTOCOL_VERSION = 2;
+
+// SHA-256 of all fields of blocks and their transactions read by the checks or the replay,
+// including the lengths of variable-size fields
+class DataDigest {
+public:
+    DataDigest();
+    void add(const BlockRow &block, const std::vector<TransactionRow> &transactions);
+    bytes_t finish();
+
+private:
+    void addNumber(std::uint64_t value);
+    void addBytes(const bytes_t &value);
+
+    crypto_hash_sha256_state state_;
+};
+
+using BlockCallback = std::function<void(const BlockRow &, const std::vector<TransactionRow> &)>;
+// Calls callback for every block in [fromHeight, toHeight] in height order
+using RangeReader = std::function<void(height_t fromHeight, height_t toHeight, const BlockCallback &callback)>;
+
+// Answers the check requests read from std::cin on outFd until std::cin is closed, checking the
+// blocks on pool. std::cout must not write to outFd. Throws std::runtime_error after reporting an
+// error to the coordinator.
+void serveWorker(const RangeReader &read, Network network, const Settings &settings,
+                 SignatureCache *signatureCache, SignatureSampling *sampling, ThreadPool &pool, int outFd);
+
+// Threads of each of the options.localWorkers local workers. They share --threads with the
+// coordinator, which keeps at least the thread of its replay.
+unsigned localWorkerThreads(const Options &options);
+
+// Shell command running this binary as a worker on the database of options
+std::string localWorkerCommand(const Options &options);
+
+class Coordinator {
+public:
+    // Runs every command with /bin/sh and hands out the ranges of rangeSize blocks in
+    // [fromHeight, toHeight]. Ranges of workers that stop are handed to the remaining ones.
+    Coordinator(const std::vector<std::string> &workerCommands, Network network,
+                height_t fromHeight, height_t toHeight, height_t rangeSize);
+    // Terminates workers still running
+    ~Coordinator();
+
+    Coordinator(const Coordinator &) = delete;
+    Coordinator &operator=(const Coordinator &) = delete;
+
+    // Failures of the stateless checks of block, waiting for its range if necessary. Blocks must
+    // come in height order. Throws std::runtime_error if all workers stopped or, at the end of a
+    // range, if a worker read different blocks or transactions.
+    std::vector<FailureRecord> checkedBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions);
+
+    // Throws std::runtime_error unless all blocks up to toHeight were passed to checkedBlock.
+    // Otherwise closes the stdin of the workers and waits for them to exit.
+    void finish();
+
+    // Transaction signatures of the blocks passed to checkedBlock that workers verified or
+    // skipped because of their --sample-signatures
+    std::uint64_t signaturesVerified() const;
+    std::uint64_t signaturesSkipped() const;
+
+private:
+    struct Range {
+        height_t fromHeight;
+        height_t toHeight;
+    };
+
+    struct Result {
+        Range range;
+        std::uint64_t blocks = 0;
+        std::uint64_t transactions = 0;
+        bytes_t chainFingerprint;
+        bytes_t dataDigest;
+        std::uint64_t signaturesVerified = 0;
+        std::uint64_t signaturesSkipped = 0;
+        std::vector<FailureRecord> failures; // ordered by height
+    };
+
+    struct Worker {
+        std::string command;
+        pid_t pid = -1;
+        int inFd = -1; // stdin of the worker
+        int outFd = -1; // stdout of the worker
+        bool ready = false;
+        bool running = true;
+        std::string received; // incomplete line
+        std::deque<Range> assigned;
+        std::vector<FailureRecord> failures; // of the first assigned range
+    };
+
+    void start(Worker &worker);
+    void dispatch();
+    // Dispatcher thread only, with mutex_ locked
+    void handleLine(Worker &worker, const std::string &line);
+    void assign(Worker &worker);
+    void stopWorker(Worker &worker, const std::string &reason);
+    void stopAll(bool terminate);
+
+    Network network_;
+    height_t toHeight_;
+
+    std::vector<Worker> workers_;
+    std::thread dispatcher_;
+    std::atomic<bool> stopping_{false};
+
+    std::mutex mutex_;
+    std::condition_variable resultArrived_;
+    std::deque<Range> unassigned_;
+    std::map<height_t, Result> results_; // by fromHeight
+    std::string error_; // set once no worker is left
+
+    // Used by checkedBlock only
+    height_t nextHeight_;
+    Result current_;
+    std::size_t nextFailure_ = 0;
+    std::uint64_t transactions_ = 0; // of the current range
+    bytes_t chainFingerprint_;
+    DataDigest dataDigest_;
+    std::uint64_t signaturesVerified_ = 0;
+    std::uint64_t signaturesSkipped_ = 0;
+};
+
+}
@@ -0,0 +1,68 @@
+#include "failure_collector.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include "binary_file.h"
+#include "utils.h"
+
+FailureCollector::FailureCollector(std::size_t maxFailures)
+    : maxFailures_(maxFailures)
+{
+}
+
+void FailureCollector::setBlock(height_t height, std::uint64_t blockId)
+{
+    height_ = height;
+    blockId_ = blockId;
+}
+
+void FailureCollector::record(const ValidationError &error, std::uint64_t transactionId)
+{
+    records_.push_back({height_, blockId_, transactionId, error.check(), error.what(), error.expected(), error.actual()});
+    std::cerr << "Failure " << records_.size() << " at height " << height_ << ": " << error.what() << std::endl;
+
+    if (records_.size() >= maxFailures_) {
+        throw std::runtime_error("Stopping after " + std::to_string(records_.size()) + " failures");
+    }
+}
+
+bool FailureCollector::firstOccurrence(const std::string &check, std::uint64_t subject)
+{
+    return occurrences_.emplace(check, subject).second;
+}
+
+bool FailureCollector::empty() const
+{
+    return records_.empty();
+}
+
+std::size_t FailureCollector::size() const
+{
+    return records_.size();
+}
+
+void FailureCollector::writeReport(const std::string &path) const
+{
+    std::ostringstream json;
+    json << "{\n  \"failures\": [";
+    for (std::size_t i = 0; i < records_.size(); ++i) {
+        const auto &record = records_[i];
+        json << (i ? ",\n" : "\n")
+             << "    {\"height\": " << record.height
+             << ", \"blockId\": " << jsonString(std::to_string(record.blockId))
+             << ", \"transactionId\": " << (record.transactionId ? jsonString(std::to_string(record.transactionId)) : "null")
+             << ", \"check\": " << jsonString(record.check)
+             << ", \"message\": " << jsonString(record.message)
+             << ", \"expected\": " << jsonString(record.expected)
+             << ", \"actual\": " << jsonString(record.actual) << "}";
+    }
+    json << "\n  ]\n}\n";
+
+    const auto content = json.str();
+    AtomicFileWriter writer(path);
+    writer.write(content.data(), content.size());
+    writer.commit();
+    std::cout << "Wrote " << records_.size() << " failures to " << path << std::endl;
+}
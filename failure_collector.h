@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+#include "validation_error.h"
+
+struct FailureRecord {
+    height_t height;
+    std::uint64_t blockId;
+    std::uint64_t transactionId; // 0 for failures not caused by a single transaction
+    std::string check;
+    std::string message;
+    std::string expected;
+    std::string actual;
+};
+
+// Records failed checks instead of ending the run, up to maxFailures
+class FailureCollector {
+public:
+    FailureCollector(std::size_t maxFailures);
+
+    // Block the following failures belong to
+    void setBlock(height_t height, std::uint64_t blockId);
+
+    // Throws std::runtime_error once maxFailures failures are recorded
+    void record(const ValidationError &error, std::uint64_t transactionId = 0);
+
+    // Returns true the first time it is called for a check and subject, e.g. to report an account
+    // staying negative only once
+    bool firstOccurrence(const std::string &check, std::uint64_t subject);
+
+    bool empty() const;
+    std::size_t size() const;
+
+    // JSON report of all failures, written atomically
+    void writeReport(const std::string &path) const;
+
+private:
+    std::size_t maxFailures_;
+    height_t height_ = 0;
+    std::uint64_t blockId_ = 0;
+    std::vector<FailureRecord> records_;
+    std::set<std::pair<std::string, std::uint64_t>> occurrences_;
+};
@@ -0,0 +1,76 @@
+#include "follow.h"
+
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "database.h"
+
+namespace {
+
+// Rolls back blocks until the last replayed block is still part of the database's chain
+void rollbackReplacedBlocks(pqxx::transaction_base &db, Replay &replay)
+{
+    while (replay.position().height > 0) {
+        const auto height = replay.position().height;
+        const auto result = db.exec("SELECT id FROM blocks WHERE height = " + std::to_string(height));
+        if (!result.empty() && result[0][0].as<std::uint64_t>() == replay.position().blockId) {
+            return;
+        }
+
+        if (!replay.canRollback()) {
+            throw std::runtime_error("Block " + std::to_string(replay.position().blockId) + " at height " +
+                                     std::to_string(height) + " was replaced, but cannot be rolled back");
+        }
+        std::cout << "Rolling back block " << replay.position().blockId << " at height " << height << std::endl;
+        replay.rollbackBlock();
+    }
+}
+
+}
+
+namespace Follow {
+
+void run(pqxx::connection &connection, const Settings &settings, Replay &replay, int intervalSeconds,
+         FailureCollector *failures, const std::string &failureReport)
+{
+    std::cout << "Following database for new blocks every " << intervalSeconds << " s ..." << std::endl;
+
+    std::size_t reportedFailures = failures ? failures->size() : 0;
+    while (true) {
+        std::this_thread::sleep_for(std::chrono::seconds(intervalSeconds));
+
+        // One snapshot for the whole poll, so blocks and transactions added or replaced by the node
+        // meanwhile are not mixed with the ones read before
+        pqxx::transaction<pqxx::repeatable_read, pqxx::read_only> db(connection);
+
+        rollbackReplacedBlocks(db, replay);
+
+        const auto fromHeight = replay.position().height + 1;
+        // Fix the range first, so transactions of blocks added meanwhile are not missed
+        const auto toHeight = db.exec1("SELECT coalesce(max(height), 0) FROM blocks")[0].as<height_t>();
+        if (toHeight < fromHeight) continue;
+
+        Database::TransactionStatistics statistics;
+        auto blockToTransactions = Database::readCheckedTransactions(db, settings, fromHeight, toHeight, statistics);
+        Database::readBlocks(db, [&](const BlockRow &block) {
+            replay.processBlock(block, blockToTransactions[block.id]);
+        }, fromHeight, toHeight);
+
+        std::cout << "Validated blocks up to height " << replay.position().height
+                  << " (" << replay.position().blockId << ")" << std::endl;
+
+        // The run does not end while following, so the report is brought up to date after every poll
+        if (failures && failures->size() > reportedFailures) {
+            failures->writeReport(failureReport);
+            std::cout << failures->size() - reportedFailures << " new failures, written to " << failureReport << std::endl;
+            reportedFailures = failures->size();
+        }
+
+        db.commit();
+    }
+}
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <string>
+
+#include <pqxx/pqxx>
+
+#include "failure_collector.h"
+#include "replay.h"
+#include "settings.h"
+
+namespace Follow {
+
+// Number of rounds that can be rolled back when the node replaces blocks
+const int JOURNAL_ROUNDS = 5;
+
+// Polls the database for new blocks and validates them. Blocks replaced by the node
+// are rolled back as long as the replay journal reaches back far enough. With failures,
+// the report is rewritten to failureReport after every poll that recorded new ones.
+// Only returns by throwing an exception.
+void run(pqxx::connection &connection, const Settings &settings, Replay &replay, int intervalSeconds,
+         FailureCollector *failures = nullptr, const std::string &failureReport = "");
+
+}
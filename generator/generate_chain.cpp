@@ -0,0 +1,720 @@
+// Deterministic generator of synthetic Lisk chains for scale testing. Writes a plain SQL dump with
+// the tables snapshot-validator reads, with valid IDs, signatures and second signatures, rewards,
+// round payouts and a matching mem_accounts table:
+//
+//     snapshot-validator-generator --seed 7 --height 100000 | gzip > synthetic.sql.gz
+//     validate_snapshot.sh synthetic synthetic.sql.gz
+//
+// The same options always produce the same chain. Keys are derived from passphrases as in Lisk:
+// the genesis account uses "snapshot-validator synthetic genesis", which the synthetic network
+// settings exempt from the balance check, the 101 genesis delegates use
+// "snapshot-validator synthetic delegate N" and the other accounts
+// "snapshot-validator synthetic SEED account N".
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sodium.h>
+
+#include "block.h"
+#include "block_validator.h"
+#include "blockchain_state.h"
+#include "lisk.h"
+#include "payload.h"
+#include "replay.h"
+#include "settings.h"
+#include "transaction.h"
+#include "utils.h"
+
+namespace {
+
+const std::uint64_t BPL = 100000000; // Beddows per Lisk
+const int TRANSACTION_TYPES = 8;
+const height_t FLUSH_INTERVAL = 1000; // blocks per group of COPY statements
+
+struct Options {
+    std::uint64_t seed = 1;
+    height_t height = 10100;
+    std::size_t accounts = 10000;
+    std::uint64_t transactionsPerBlock = 5; // on average
+    // relative frequency of each transaction type
+    std::array<std::uint64_t, TRANSACTION_TYPES> mix = {{80, 2, 1, 8, 2, 1, 3, 3}};
+};
+
+struct Keypair {
+    bytes_t publicKey;
+    bytes_t secretKey;
+};
+
+Keypair keypairFromPassphrase(const std::string &passphrase)
+{
+    bytes_t seed(crypto_hash_sha256_BYTES);
+    crypto_hash_sha256(seed.data(), reinterpret_cast<const unsigned char *>(passphrase.data()), passphrase.size());
+    Keypair out {bytes_t(crypto_sign_PUBLICKEYBYTES), bytes_t(crypto_sign_SECRETKEYBYTES)};
+    crypto_sign_seed_keypair(out.publicKey.data(), out.secretKey.data(), seed.data());
+    return out;
+}
+
+bytes_t sign(const bytes_t &message, const bytes_t &secretKey)
+{
+    bytes_t out(crypto_sign_BYTES);
+    crypto_sign_detached(out.data(), nullptr, message.data(), message.size(), secretKey.data());
+    return out;
+}
+
+struct Account {
+    explicit Account(const std::string &passphrase)
+        : passphrase(passphrase)
+        , keys(keypairFromPassphrase(passphrase))
+        , address(addressFromPubkey(keys.publicKey))
+    {}
+
+    std::string passphrase;
+    Keypair keys;
+    address_t address;
+    Keypair secondKeys; // empty until registered
+};
+
+// The columns written for a transaction besides those of trs
+struct AssetRow {
+    const char *table = nullptr; // nullptr: no asset table
+    std::string values;
+};
+
+// Rows of one table, written as a COPY statement when flushed
+class CopyBuffer {
+public:
+    explicit CopyBuffer(const std::string &target)
+        : target_(target)
+    {}
+
+    std::ostringstream &row() { ++rows_; return data_; }
+
+    void flush(std::ostream &out)
+    {
+        if (rows_ == 0) return;
+        out << "COPY " << target_ << " FROM stdin;\n" << data_.str() << "\\.\n\n";
+        data_.str("");
+        rows_ = 0;
+    }
+
+private:
+    std::string target_;
+    std::ostringstream data_;
+    std::size_t rows_ = 0;
+};
+
+std::string bytea(const bytes_t &data)
+{
+    return data.empty() ? "\\N" : "\\\\x" + bytes2Hex(data);
+}
+
+std::string liskAddress(address_t address)
+{
+    return std::to_string(address) + "L";
+}
+
+class Generator {
+public:
+    explicit Generator(const Options &options)
+        : options_(options)
+        , settings_(Network::Synthetic)
+        , random_(options.seed)
+        , genesis_("snapshot-validator synthetic genesis")
+    {
+        for (int i = 0; i < 101; ++i) {
+            delegates_.emplace_back("snapshot-validator synthetic delegate " + std::to_string(i));
+        }
+        for (std::size_t i = 0; i < options.accounts; ++i) {
+            accounts_.emplace_back("snapshot-validator synthetic " + std::to_string(options.seed) +
+                                   " account " + std::to_string(i));
+        }
+        for (auto *account : all()) {
+            byAddress_[account->address] = account;
+        }
+        for (const auto &weight : options.mix) mixTotal_ += weight;
+        if (mixTotal_ == 0) throw std::runtime_error("Transaction mix is empty");
+    }
+
+    void run(std::ostream &out)
+    {
+        writeSchema(out);
+        for (height_t height = 1; height <= options_.height; ++height) {
+            addBlock(height);
+            if (height % FLUSH_INTERVAL == 0 || height == options_.height) {
+                for (auto *buffer : buffers()) buffer->flush(out);
+            }
+            if (height % 10000 == 0) {
+                std::cerr << "Generated block at height " << height << std::endl;
+            }
+        }
+        writeMemAccounts(out);
+        writeIndexes(out);
+    }
+
+private:
+    std::vector<Account *> all()
+    {
+        std::vector<Account *> out = {&genesis_};
+        for (auto &account : delegates_) out.push_back(&account);
+        for (auto &account : accounts_) out.push_back(&account);
+        return out;
+    }
+
+    std::vector<CopyBuffer *> buffers()
+    {
+        return {&blocksTable_, &trsTable_, &signaturesTable_, &delegatesTable_, &votesTable_, &multisignaturesTable_, &dappsTable_,
+                &intransferTable_, &outtransferTable_};
+    }
+
+    // Deterministic on all platforms, unlike the std distributions
+    std::uint64_t below(std::uint64_t limit)
+    {
+        return limit ? random_() % limit : 0;
+    }
+
+    Account &randomAccount()
+    {
+        return accounts_[below(accounts_.size())];
+    }
+
+    const AddressSummary &summary(const Account &account)
+    {
+        static const AddressSummary none;
+        const auto existing = state_.addressSummaries.find(account.address);
+        return existing == state_.addressSummaries.end() ? none : existing->second;
+    }
+
+    // Balance minus what the block being generated already spends
+    std::int64_t spendable(const Account &account)
+    {
+        return summary(account).balance - pendingDebits_[account.address];
+    }
+
+    bool canPay(const Account &account, std::uint64_t amount)
+    {
+        return spendable(account) >= static_cast<std::int64_t>(amount);
+    }
+
+    // Signed by the sender, and by its second key if registered before this block
+    TransactionRow signTransaction(const Account &sender, const Transaction &transaction)
+    {
+        const auto signature = sign(transaction.hash(), sender.keys.secretKey);
+        bytes_t secondSignature;
+        if (!summary(sender).secondPubkey.empty()) {
+            secondSignature = sign(transaction.hash(signature), sender.secondKeys.secretKey);
+        }
+        const auto id = transaction.id(signature, secondSignature);
+        pendingDebits_[sender.address] += transaction.amount + transaction.fee;
+        return TransactionRow(transaction, signature, secondSignature, id, 0);
+    }
+
+    TransactionRow transfer(const Account &sender, const Account &recipient, std::uint64_t amount,
+                            std::int32_t timestamp)
+    {
+        return signTransaction(sender, Transaction(0, timestamp, sender.keys.publicKey, recipient.address,
+                                                   amount, 10000000, {}, 0));
+    }
+
+    TransactionRow votes(const Account &sender, const std::vector<const Account *> &voted, std::int32_t timestamp,
+                         AssetRow &asset)
+    {
+        std::string signedVotes;
+        for (const auto *delegate : voted) {
+            if (!asset.values.empty()) asset.values += ",";
+            asset.values += "+" + bytes2Hex(delegate->keys.publicKey);
+            signedVotes += "+" + bytes2Hex(delegate->keys.publicKey);
+        }
+        asset.table = "votes";
+        asset.values += "\t";
+        return signTransaction(sender, Transaction(3, timestamp, sender.keys.publicKey, sender.address, 0,
+                                                   1 * BPL, asVector(signedVotes), 0));
+    }
+
+    // Funds all genesis delegates, registers them and votes for them
+    void genesisTransactions(std::int32_t timestamp, std::vector<TransactionRow> &rows, std::vector<AssetRow> &assets)
+    {
+        for (auto &delegate : delegates_) {
+            rows.push_back(transfer(genesis_, delegate, 100000 * BPL, timestamp));
+            assets.emplace_back();
+        }
+        for (std::size_t i = 0; i < delegates_.size(); ++i) {
+            const auto username = "genesis_" + std::to_string(i);
+            rows.push_back(signTransaction(delegates_[i], Transaction(2, timestamp, delegates_[i].keys.publicKey, 0, 0,
+                                                                      25 * BPL, asVector(username), 0)));
+            assets.emplace_back();
+            assets.back().table = "delegates";
+            assets.back().values = username + "\t";
+        }
+        for (std::size_t first = 0; first < delegates_.size(); first += 33) {
+            std::vector<const Account *> voted;
+            for (auto i = first; i < std::min(first + 33, delegates_.size()); ++i) voted.push_back(&delegates_[i]);
+            assets.emplace_back();
+            rows.push_back(votes(genesis_, voted, timestamp, assets.back()));
+        }
+    }
+
+    std::uint8_t randomType()
+    {
+        auto roll = below(mixTotal_);
+        for (int type = 0; type < TRANSACTION_TYPES; ++type) {
+            if (roll < options_.mix[type]) return static_cast<std::uint8_t>(type);
+            roll -= options_.mix[type];
+        }
+        return 0;
+    }
+
+    // A transaction of the given type, or a transfer from the genesis account funding a random
+    // account if no account meeting the requirements of the type was found
+    TransactionRow randomTransaction(std::uint8_t type, std::int32_t timestamp, AssetRow &asset)
+    {
+        for (int attempt = 0; attempt < 3; ++attempt) {
+            auto &sender = randomAccount();
+            if (pendingSenders_.count(sender.address)) continue; // keeps registrations simple
+
+            switch (type) {
+            case 0: {
+                const auto fee = 10000000;
+                if (!canPay(sender, fee + 1)) continue;
+                const auto amount = 1 + below(std::min<std::int64_t>(spendable(sender) - fee, 1000 * BPL));
+                return transfer(sender, randomAccount(), amount, timestamp);
+            }
+            case 1: {
+                if (!summary(sender).secondPubkey.empty() || !canPay(sender, 5 * BPL)) continue;
+                sender.secondKeys = keypairFromPassphrase(sender.passphrase + " second");
+                pendingSenders_.insert(sender.address);
+                asset.table = "signatures";
+                asset.values = bytea(sender.secondKeys.publicKey) + "\t";
+                return signTransaction(sender, Transaction(1, timestamp, sender.keys.publicKey, 0, 0, 5 * BPL,
+                                                           sender.secondKeys.publicKey, 0));
+            }
+            case 2: {
+                if (!summary(sender).delegateName.empty() || !canPay(sender, 25 * BPL)) continue;
+                const auto username = "delegate_" + std::to_string(sender.address % 100000000000);
+                pendingSenders_.insert(sender.address);
+                registeredDelegates_.push_back(&sender);
+                asset.table = "delegates";
+                asset.values = username + "\t";
+                return signTransaction(sender, Transaction(2, timestamp, sender.keys.publicKey, 0, 0, 25 * BPL,
+                                                           asVector(username), 0));
+            }
+            case 3: {
+                if (!canPay(sender, 1 * BPL)) continue;
+                std::set<const Account *> voted;
+                const auto count = 1 + below(33);
+                for (std::uint64_t i = 0; i < count; ++i) {
+                    const auto pick = below(delegates_.size() + registeredDelegates_.size());
+                    voted.insert(pick < delegates_.size() ? &delegates_[pick]
+                                                          : registeredDelegates_[pick - delegates_.size()]);
+                }
+                return votes(sender, std::vector<const Account *>(voted.begin(), voted.end()), timestamp, asset);
+            }
+            case 4: {
+                const auto keyCount = 2 + below(15);
+                const auto fee = 5 * BPL * (keyCount + 1);
+                if (multisignatureAccounts_.count(sender.address) || !canPay(sender, fee)) continue;
+                std::set<const Account *> members;
+                while (members.size() < keyCount) members.insert(&randomAccount());
+                const auto min = static_cast<std::uint8_t>(2 + below(keyCount - 1));
+                const auto lifetime = static_cast<std::uint8_t>(1 + below(72));
+                bytes_t assetData = {min, lifetime};
+                std::string keysgroup;
+                for (const auto *member : members) {
+                    const auto key = "+" + bytes2Hex(member->keys.publicKey);
+                    keysgroup += (keysgroup.empty() ? "" : ",") + key;
+                    assetData.insert(assetData.end(), key.begin(), key.end());
+                }
+                pendingSenders_.insert(sender.address);
+                multisignatureAccounts_.insert(sender.address);
+                asset.table = "multisignatures";
+                asset.values = std::to_string(min) + "\t" + std::to_string(lifetime) + "\t" + keysgroup + "\t";
+                return signTransaction(sender, Transaction(4, timestamp, sender.keys.publicKey, 0, 0, fee,
+                                                           assetData, 0));
+            }
+            case 5: {
+                if (!canPay(sender, 25 * BPL)) continue;
+                const auto number = std::to_string(dappCount_++);
+                const std::string name = "dapp" + number;
+                const std::string description = "Synthetic dapp " + number;
+                const std::string tags = "synthetic";
+                const std::string link = "https://example.com/dapp" + number + ".zip";
+                const std::string icon = "https://example.com/dapp" + number + ".png";
+                const std::uint32_t dappType = 0;
+                const std::uint32_t category = static_cast<std::uint32_t>(below(9));
+                auto assetData = asVector(name + description + tags + link + icon);
+                for (const auto value : {dappType, category}) {
+                    for (int i = 0; i < 4; ++i) assetData.push_back((value >> i*8) & 0xff);
+                }
+                pendingSenders_.insert(sender.address);
+                asset.table = "dapps";
+                asset.values = name + "\t" + description + "\t" + tags + "\t" + link + "\t" +
+                        std::to_string(dappType) + "\t" + std::to_string(category) + "\t" + icon + "\t";
+                auto row = signTransaction(sender, Transaction(5, timestamp, sender.keys.publicKey, 0, 0, 25 * BPL,
+                                                               assetData, 0));
+                pendingDapps_.push_back(row.id);
+                return row;
+            }
+            case 6: {
+                const auto fee = 10000000;
+                if (dapps_.empty() || !canPay(sender, fee + 1)) continue;
+                const auto dappId = dapps_[below(dapps_.size())];
+                const auto amount = 1 + below(std::min<std::int64_t>(spendable(sender) - fee, 100 * BPL));
+                asset.table = "intransfer";
+                asset.values = std::to_string(dappId) + "\t";
+                return signTransaction(sender, Transaction(6, timestamp, sender.keys.publicKey, 0, amount, fee,
+                                                           asVector(std::to_string(dappId)), dappId));
+            }
+            case 7: {
+                // Withdrawals are sent by the owner of the dapp
+                const auto fee = 10000000;
+                if (dapps_.empty()) continue;
+                const auto dappId = dapps_[below(dapps_.size())];
+                auto &owner = *byAddress_.at(state_.dappOwners.at(dappId));
+                if (pendingSenders_.count(owner.address) || !canPay(owner, fee + 1)) continue;
+                const auto amount = 1 + below(std::min<std::int64_t>(spendable(owner) - fee, 100 * BPL));
+                const auto outTransactionId = random_();
+                asset.table = "outtransfer";
+                asset.values = std::to_string(dappId) + "\t" + std::to_string(outTransactionId) + "\t";
+                return signTransaction(owner, Transaction(7, timestamp, owner.keys.publicKey,
+                                                          randomAccount().address, amount, fee,
+                                                          asVector(std::to_string(dappId) + std::to_string(outTransactionId)),
+                                                          dappId));
+            }
+            }
+        }
+
+        asset = AssetRow();
+        return transfer(genesis_, randomAccount(), (1000 + below(100000)) * BPL, timestamp);
+    }
+
+    void addBlock(height_t height)
+    {
+        const auto timestamp = static_cast<std::int32_t>((height - 1) * 10);
+        const auto &generator = height == 1 ? genesis_ : delegates_[(height - 1) % 101];
+
+        pendingDebits_.clear();
+        pendingSenders_.clear();
+        std::vector<TransactionRow> rows;
+        std::vector<AssetRow> assets;
+        if (height == 1) {
+            genesisTransactions(timestamp, rows, assets);
+        } else {
+            const auto count = below(2 * options_.transactionsPerBlock + 1);
+            for (std::uint64_t i = 0; i < count; ++i) {
+                assets.emplace_back();
+                const auto transactionTimestamp = std::max<std::int32_t>(0, timestamp - static_cast<std::int32_t>(below(10)));
+                rows.push_back(randomTransaction(randomType(), transactionTimestamp, assets.back()));
+            }
+        }
+
+        std::uint64_t totalAmount = 0;
+        std::uint64_t totalFee = 0;
+        for (const auto &row : rows) {
+            totalAmount += row.transaction.amount;
+            totalFee += row.transaction.fee;
+        }
+        const Payload payload(rows);
+        const auto payloadLength = payload.serialize().size();
+        const BlockHeader header(0, static_cast<std::uint32_t>(timestamp), previousBlockId_,
+                                 static_cast<std::uint32_t>(rows.size()), totalAmount, totalFee,
+                                 BlockValidator::expectedReward(height, settings_),
+                                 static_cast<std::uint32_t>(payloadLength), payload.hash(), generator.keys.publicKey);
+        const auto signature = sign(header.hash(), generator.keys.secretKey);
+        const auto blockId = header.id(signature);
+
+        writeBlock(height, blockId, header, signature);
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            const TransactionRow row(rows[i].transaction, rows[i].signature, rows[i].secondSignature, rows[i].id, blockId);
+            writeTransaction(row, assets[i]);
+            state_.applyTransaction(row);
+        }
+        state_.applyBlock(header, blockId);
+        dapps_.insert(dapps_.end(), pendingDapps_.begin(), pendingDapps_.end());
+        pendingDapps_.clear();
+
+        // Same as Replay::closeRound
+        roundFees_ += totalFee;
+        roundDelegates_[(height - 1) % 101] = generator.address;
+        roundRewards_[(height - 1) % 101] = header.reward;
+        if (height % 101 == 0) {
+            const auto payouts = roundPayouts(settings_, height, roundFees_, roundRewards_);
+            for (int i = 0; i < 101; ++i) {
+                state_.addressSummaries[roundDelegates_[i]].balance += payouts[i];
+                state_.addressSummaries[roundDelegates_[i]].lastBlockId = blockId;
+            }
+            roundFees_ = 0;
+        }
+        // Validated accounts are not tracked here
+        state_.addressSummaries.resetDirtyKeys();
+        state_.negativeBalanceCandidates.clear();
+
+        previousBlockId_ = blockId;
+    }
+
+    void writeSchema(std::ostream &out)
+    {
+        out << R"SQL(-- Synthetic chain written by snapshot-validator-generator
+SET client_encoding = 'UTF8';
+
+CREATE TABLE blocks (
+    id VARCHAR(20) NOT NULL, "rowId" BIGINT NOT NULL, version INT NOT NULL, timestamp INT NOT NULL,
+    height INT NOT NULL, "previousBlock" VARCHAR(20), "numberOfTransactions" INT NOT NULL,
+    "totalAmount" BIGINT NOT NULL, "totalFee" BIGINT NOT NULL, reward BIGINT NOT NULL,
+    "payloadLength" INT NOT NULL, "payloadHash" BYTEA NOT NULL, "generatorPublicKey" BYTEA NOT NULL,
+    "blockSignature" BYTEA NOT NULL
+);
+CREATE TABLE trs (
+    id VARCHAR(20) NOT NULL, "rowId" BIGINT NOT NULL, "blockId" VARCHAR(20) NOT NULL, type SMALLINT NOT NULL,
+    timestamp INT NOT NULL, "senderPublicKey" BYTEA NOT NULL, "senderId" VARCHAR(22) NOT NULL,
+    "recipientId" VARCHAR(22), amount BIGINT NOT NULL, fee BIGINT NOT NULL, signature BYTEA NOT NULL,
+    "signSignature" BYTEA
+);
+CREATE TABLE signatures ("transactionId" VARCHAR(20) NOT NULL, "publicKey" BYTEA NOT NULL);
+CREATE TABLE delegates (username VARCHAR(20) NOT NULL, "transactionId" VARCHAR(20) NOT NULL);
+CREATE TABLE votes (votes TEXT, "transactionId" VARCHAR(20) NOT NULL);
+CREATE TABLE multisignatures (min INT NOT NULL, lifetime INT NOT NULL, keysgroup TEXT NOT NULL, "transactionId" VARCHAR(20) NOT NULL);
+CREATE TABLE dapps (
+    "transactionId" VARCHAR(20) NOT NULL, name VARCHAR(32) NOT NULL, description VARCHAR(160), tags VARCHAR(160),
+    link TEXT, type INT NOT NULL, category INT NOT NULL, icon TEXT
+);
+CREATE TABLE intransfer ("dappId" VARCHAR(20) NOT NULL, "transactionId" VARCHAR(20) NOT NULL);
+CREATE TABLE outtransfer ("transactionId" VARCHAR(20) NOT NULL, "dappId" VARCHAR(20) NOT NULL, "outTransactionId" VARCHAR(20) NOT NULL);
+CREATE TABLE mem_accounts (
+    username VARCHAR(20), "isDelegate" SMALLINT DEFAULT 0, "secondSignature" SMALLINT DEFAULT 0,
+    address VARCHAR(22) NOT NULL, "publicKey" BYTEA, "secondPublicKey" BYTEA, balance BIGINT DEFAULT 0,
+    u_balance BIGINT DEFAULT 0, "blockId" VARCHAR(20)
+);
+CREATE TABLE peers (id SERIAL, ip INET, port SMALLINT);
+CREATE TABLE peers_dapp ("peerId" INT, "dappid" VARCHAR(20));
+
+)SQL";
+    }
+
+    void writeBlock(height_t height, std::uint64_t blockId, const BlockHeader &header, const bytes_t &signature)
+    {
+        blocksTable_.row() << blockId << "\t" << height << "\t" << header.version << "\t" << header.timestamp << "\t"
+                      << height << "\t" << (height == 1 ? "\\N" : std::to_string(header.previousBlock)) << "\t"
+                      << header.numberOfTransactions << "\t" << header.totalAmount << "\t" << header.totalFee << "\t"
+                      << header.reward << "\t" << header.payloadLength << "\t" << bytea(header.payloadHash) << "\t"
+                      << bytea(header.generatorPublicKey) << "\t" << bytea(signature) << "\n";
+    }
+
+    void writeTransaction(const TransactionRow &row, const AssetRow &asset)
+    {
+        const auto &t = row.transaction;
+        const bool hasRecipient = t.type == 0 || t.type == 3 || t.type == 7;
+        trsTable_.row() << row.id << "\t" << ++transactionRowId_ << "\t" << row.blockId << "\t" << int(t.type) << "\t"
+                   << t.timestamp << "\t" << bytea(t.senderPublicKey) << "\t" << liskAddress(t.senderAddress) << "\t"
+                   << (hasRecipient ? liskAddress(t.recipientAddress) : "\\N") << "\t" << t.amount << "\t"
+                   << t.fee << "\t" << bytea(row.signature) << "\t" << bytea(row.secondSignature) << "\n";
+
+        if (!asset.table) return;
+        const std::string table = asset.table;
+        if (table == "signatures") {
+            signaturesTable_.row() << row.id << "\t" << asset.values.substr(0, asset.values.size() - 1) << "\n";
+        } else if (table == "dapps" || table == "outtransfer") {
+            // transaction ID first
+            (table == "dapps" ? dappsTable_ : outtransferTable_).row()
+                    << row.id << "\t" << asset.values.substr(0, asset.values.size() - 1) << "\n";
+        } else {
+            auto &buffer = table == "delegates" ? delegatesTable_
+                         : table == "votes" ? votesTable_
+                         : table == "multisignatures" ? multisignaturesTable_
+                         : intransferTable_;
+            buffer.row() << asset.values << row.id << "\n";
+        }
+    }
+
+    void writeMemAccounts(std::ostream &out)
+    {
+        CopyBuffer memAccounts("mem_accounts (username, \"isDelegate\", \"secondSignature\", address, \"publicKey\", "
+                               "\"secondPublicKey\", balance, u_balance, \"blockId\")");
+        std::map<address_t, const AddressSummary *> sorted;
+        for (const auto &entry : state_.addressSummaries) sorted[entry.first] = &entry.second;
+
+        for (const auto &entry : sorted) {
+            const auto &summary = *entry.second;
+            const auto account = byAddress_.find(entry.first);
+            memAccounts.row() << (summary.delegateName.empty() ? "\\N" : summary.delegateName) << "\t"
+                              << (summary.delegateName.empty() ? 0 : 1) << "\t"
+                              << (summary.secondPubkey.empty() ? 0 : 1) << "\t"
+                              << liskAddress(entry.first) << "\t"
+                              << (account != byAddress_.end() ? bytea(account->second->keys.publicKey) : "\\N") << "\t"
+                              << bytea(summary.secondPubkey) << "\t"
+                              << summary.balance << "\t" << summary.balance << "\t"
+                              << (summary.lastBlockId ? std::to_string(summary.lastBlockId) : "\\N") << "\n";
+        }
+        memAccounts.flush(out);
+    }
+
+    void writeIndexes(std::ostream &out)
+    {
+        out << R"SQL(ALTER TABLE blocks ADD PRIMARY KEY (id);
+CREATE UNIQUE INDEX blocks_height ON blocks (height);
+ALTER TABLE trs ADD PRIMARY KEY (id);
+CREATE UNIQUE INDEX trs_rowId ON trs ("rowId");
+CREATE INDEX trs_blockId ON trs ("blockId");
+CREATE INDEX signatures_trs_id ON signatures ("transactionId");
+CREATE INDEX delegates_trs_id ON delegates ("transactionId");
+CREATE INDEX votes_trs_id ON votes ("transactionId");
+CREATE INDEX multisignatures_trs_id ON multisignatures ("transactionId");
+CREATE INDEX dapps_trs_id ON dapps ("transactionId");
+CREATE INDEX intransfer_trs_id ON intransfer ("transactionId");
+CREATE INDEX outtransfer_trs_id ON outtransfer ("transactionId");
+CREATE UNIQUE INDEX mem_accounts_address ON mem_accounts (address);
+ANALYZE;
+)SQL";
+    }
+
+    const Options options_;
+    const Settings settings_;
+    std::mt19937_64 random_;
+    std::uint64_t mixTotal_ = 0;
+
+    Account genesis_;
+    std::vector<Account> delegates_; // the 101 forging delegates
+    std::vector<Account> accounts_;
+    std::unordered_map<address_t, Account *> byAddress_;
+
+    BlockchainState state_;
+    std::uint64_t previousBlockId_ = 0;
+    std::uint64_t roundFees_ = 0;
+    std::vector<std::uint64_t> roundDelegates_ = std::vector<std::uint64_t>(101);
+    std::vector<std::uint64_t> roundRewards_ = std::vector<std::uint64_t>(101);
+
+    // Only ever used from the next block on
+    std::vector<Account *> registeredDelegates_;
+    std::set<address_t> multisignatureAccounts_;
+    std::vector<std::uint64_t> dapps_;
+    std::uint64_t dappCount_ = 0;
+
+    // of the block being generated
+    std::unordered_map<address_t, std::int64_t> pendingDebits_;
+    std::set<address_t> pendingSenders_; // accounts that sent a registration
+    std::vector<std::uint64_t> pendingDapps_;
+
+    std::uint64_t transactionRowId_ = 0;
+    CopyBuffer blocksTable_ {"blocks (id, \"rowId\", version, timestamp, height, \"previousBlock\", \"numberOfTransactions\", "
+                        "\"totalAmount\", \"totalFee\", reward, \"payloadLength\", \"payloadHash\", "
+                        "\"generatorPublicKey\", \"blockSignature\")"};
+    CopyBuffer trsTable_ {"trs (id, \"rowId\", \"blockId\", type, timestamp, \"senderPublicKey\", \"senderId\", "
+                     "\"recipientId\", amount, fee, signature, \"signSignature\")"};
+    CopyBuffer signaturesTable_ {"signatures (\"transactionId\", \"publicKey\")"};
+    CopyBuffer delegatesTable_ {"delegates (username, \"transactionId\")"};
+    CopyBuffer votesTable_ {"votes (votes, \"transactionId\")"};
+    CopyBuffer multisignaturesTable_ {"multisignatures (min, lifetime, keysgroup, \"transactionId\")"};
+    CopyBuffer dappsTable_ {"dapps (\"transactionId\", name, description, tags, link, type, category, icon)"};
+    CopyBuffer intransferTable_ {"intransfer (\"dappId\", \"transactionId\")"};
+    CopyBuffer outtransferTable_ {"outtransfer (\"transactionId\", \"dappId\", \"outTransactionId\")"};
+};
+
+void printHelp()
+{
+    std::cerr << "usage: snapshot-validator-generator [options] > chain.sql" << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "Writes a synthetic chain for the network 'synthetic' as SQL dump to stdout." << std::endl;
+    std::cerr << std::endl;
+    std::cerr << "options:" << std::endl;
+    std::cerr << "  --seed N           selects the accounts and transactions (default: 1)" << std::endl;
+    std::cerr << "  --height N         number of blocks (default: 10100)" << std::endl;
+    std::cerr << "  --accounts N       number of accounts besides genesis and delegates (default: 10000)" << std::endl;
+    std::cerr << "  --transactions-per-block N" << std::endl;
+    std::cerr << "                     average number of transactions per block (default: 5)" << std::endl;
+    std::cerr << "  --mix W0,W1,...,W7 relative frequency of transaction types 0 to 7" << std::endl;
+    std::cerr << "                     (default: 80,2,1,8,2,1,3,3)" << std::endl;
+}
+
+std::uint64_t parseNumber(const std::string &option, const std::string &value)
+{
+    std::size_t parsed = 0;
+    std::uint64_t out = 0;
+    try {
+        out = std::stoull(value, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (value.empty() || parsed != value.size() || value[0] == '-') {
+        throw std::runtime_error("Expected a number for option " + option + ", got '" + value + "'");
+    }
+    return out;
+}
+
+Options parseOptions(const std::vector<std::string> &args)
+{
+    Options out;
+    for (std::size_t index = 1; index < args.size(); ++index) {
+        const auto &arg = args[index];
+        if (index + 1 >= args.size()) {
+            throw std::runtime_error("Missing value for option " + arg);
+        }
+        const auto &value = args[++index];
+        if (arg == "--seed") {
+            out.seed = parseNumber(arg, value);
+        } else if (arg == "--height") {
+            out.height = parseNumber(arg, value);
+        } else if (arg == "--accounts") {
+            out.accounts = parseNumber(arg, value);
+        } else if (arg == "--transactions-per-block") {
+            out.transactionsPerBlock = parseNumber(arg, value);
+        } else if (arg == "--mix") {
+            std::istringstream weights(value);
+            std::string weight;
+            int type = 0;
+            while (std::getline(weights, weight, ',')) {
+                if (type == TRANSACTION_TYPES) throw std::runtime_error("--mix takes 8 weights");
+                out.mix[type++] = parseNumber(arg, weight);
+            }
+            if (type != TRANSACTION_TYPES) throw std::runtime_error("--mix takes 8 weights");
+        } else {
+            throw std::runtime_error("Unknown option: " + arg);
+        }
+    }
+    if (out.height == 0) throw std::runtime_error("--height must be at least 1");
+    if (out.accounts < 16) throw std::runtime_error("--accounts must be at least 16");
+    return out;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> args(argv, argv + argc);
+    if (args.size() == 2 && (args[1] == "--help" || args[1] == "-h")) {
+        printHelp();
+        return 0;
+    }
+
+    Options options;
+    try {
+        options = parseOptions(args);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        printHelp();
+        return 1;
+    }
+
+    if (sodium_init() == -1) {
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    try {
+        Generator generator(options);
+        generator.run(std::cout);
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::cout.flush();
+    return std::cout ? 0 : 1;
+}
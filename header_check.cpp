@@ -0,0 +1,97 @@
+#include "header_check.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "block_validator.h"
+#include "database.h"
+#include "profiler.h"
+#include "scopedbenchmark.h"
+#include "validation_error.h"
+
+namespace HeaderCheck {
+
+namespace {
+
+const std::size_t BATCH_SIZE = 50000;
+// Blocks per task
+const std::size_t CHUNK_SIZE = 1000;
+
+void validateBatch(const std::vector<BlockRow> &batch, const Settings &settings, ThreadPool &pool)
+{
+    Profiler::Scope scope("header batch", Profiler::Traced); static_cast<void>(scope);
+
+    // Every task validates a chunk and stops at its first failure
+    const auto chunks = (batch.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<std::size_t> failedIndex(chunks, batch.size());
+    std::vector<std::exception_ptr> failure(chunks);
+    {
+        ThreadPool::Group checks(pool);
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            checks.run([&, chunk]() {
+                Profiler::Scope scope("header chunk", Profiler::Traced); static_cast<void>(scope);
+                const auto end = std::min(batch.size(), (chunk + 1) * CHUNK_SIZE);
+                for (std::size_t index = chunk * CHUNK_SIZE; index < end; ++index) {
+                    try {
+                        BlockValidator::validate(batch[index], settings);
+                    } catch (...) {
+                        failedIndex[chunk] = index;
+                        failure[chunk] = std::current_exception();
+                        return;
+                    }
+                }
+            });
+        }
+        checks.wait();
+    }
+
+    // Chunks are in height order
+    for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+        if (failure[chunk]) {
+            std::cout << "Block at height " << batch[failedIndex[chunk]].height << " is invalid" << std::endl;
+            std::rethrow_exception(failure[chunk]);
+        }
+    }
+}
+
+}
+
+void run(pqxx::read_transaction &db, const Settings &settings, ThreadPool &pool)
+{
+    std::cout << "Checking block headers on " << pool.workerCount() + 1 << " threads ..." << std::endl;
+    ScopedBenchmark benchmarkHeaders("Checking block headers"); static_cast<void>(benchmarkHeaders);
+
+    std::vector<BlockRow> batch;
+    batch.reserve(BATCH_SIZE);
+    height_t height = 0;
+    std::uint64_t previousId = 0;
+
+    Database::readBlocks(db, [&](const BlockRow &block) {
+        // Failures of lower blocks in the pending batch take precedence
+        if (block.height != height + 1) {
+            validateBatch(batch, settings, pool);
+            throw std::runtime_error("Height mismatch");
+        }
+        if (block.height != 1 && block.header.previousBlock != previousId) {
+            validateBatch(batch, settings, pool);
+            throw ValidationError("block.previousBlock", "previous block mismatch",
+                                  std::to_string(previousId), std::to_string(block.header.previousBlock));
+        }
+        height = block.height;
+        previousId = block.id;
+
+        batch.push_back(block);
+        if (batch.size() == BATCH_SIZE) {
+            validateBatch(batch, settings, pool);
+            batch.clear();
+        }
+    });
+    validateBatch(batch, settings, pool);
+
+    std::cout << "Block headers up to height " << height << " are valid" << std::endl;
+}
+
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <pqxx/pqxx>
+
+#include "settings.h"
+#include "thread_pool.h"
+
+namespace HeaderCheck {
+
+// Validates the chain of block headers only: contiguous heights, previousBlock linkage, block IDs,
+// generator signatures and rewards. Reads nothing but the blocks table. Headers are verified on
+// pool, linkage is checked in height order. Throws std::runtime_error for the failure at the
+// lowest height.
+void run(pqxx::read_transaction &db, const Settings &settings, ThreadPool &pool);
+
+}
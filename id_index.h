@@ -0,0 +1,125 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Lookup structures for the short, fixed ID lists of the network exceptions. Nearly every lookup
+// misses, so a 1024 bit filter answers those with a single bit test before the sorted entries
+// are binary searched.
+
+class IdFilter {
+public:
+    void add(std::uint64_t id)
+    {
+        bits_[slot(id) / 64] |= bit(id);
+    }
+
+    bool mayContain(std::uint64_t id) const
+    {
+        return bits_[slot(id) / 64] & bit(id);
+    }
+
+private:
+    // Fibonacci hashing, so that small keys like heights spread as well as IDs
+    static unsigned slot(std::uint64_t id)
+    {
+        return static_cast<unsigned>((id * 0x9E3779B97F4A7C15ull) >> 54);
+    }
+
+    static std::uint64_t bit(std::uint64_t id)
+    {
+        return std::uint64_t{1} << (slot(id) % 64);
+    }
+
+    std::array<std::uint64_t, 16> bits_ {};
+};
+
+class IdSet {
+public:
+    IdSet() {}
+
+    IdSet(std::initializer_list<std::uint64_t> ids)
+        : ids_(ids)
+    {
+        std::sort(ids_.begin(), ids_.end());
+        ids_.erase(std::unique(ids_.begin(), ids_.end()), ids_.end());
+        for (auto id : ids_) filter_.add(id);
+    }
+
+    std::size_t count(std::uint64_t id) const
+    {
+        if (!filter_.mayContain(id)) return 0;
+        return std::binary_search(ids_.begin(), ids_.end(), id) ? 1 : 0;
+    }
+
+    bool empty() const { return ids_.empty(); }
+    std::size_t size() const { return ids_.size(); }
+
+    // in ascending order
+    std::vector<std::uint64_t>::const_iterator begin() const { return ids_.begin(); }
+    std::vector<std::uint64_t>::const_iterator end() const { return ids_.end(); }
+
+private:
+    std::vector<std::uint64_t> ids_;
+    IdFilter filter_;
+};
+
+template<typename type_of_value>
+class IdMap {
+    using entry_t = std::pair<std::uint64_t, type_of_value>;
+
+public:
+    // Inserts a default value if missing. Meant for building the map only.
+    type_of_value& operator[](std::uint64_t id)
+    {
+        auto position = find(id);
+        if (position == entries_.end() || position->first != id) {
+            position = entries_.insert(position, entry_t(id, type_of_value()));
+            filter_.add(id);
+        }
+        return position->second;
+    }
+
+    std::size_t count(std::uint64_t id) const
+    {
+        if (!filter_.mayContain(id)) return 0;
+        auto position = find(id);
+        return (position != entries_.end() && position->first == id) ? 1 : 0;
+    }
+
+    const type_of_value& at(std::uint64_t id) const
+    {
+        auto position = find(id);
+        if (position == entries_.end() || position->first != id) {
+            throw std::out_of_range("IdMap::at: " + std::to_string(id));
+        }
+        return position->second;
+    }
+
+    bool empty() const { return entries_.empty(); }
+    std::size_t size() const { return entries_.size(); }
+
+private:
+    typename std::vector<entry_t>::iterator find(std::uint64_t id)
+    {
+        return std::lower_bound(entries_.begin(), entries_.end(), id, [](const entry_t &entry, std::uint64_t value) {
+            return entry.first < value;
+        });
+    }
+
+    typename std::vector<entry_t>::const_iterator find(std::uint64_t id) const
+    {
+        return std::lower_bound(entries_.begin(), entries_.end(), id, [](const entry_t &entry, std::uint64_t value) {
+            return entry.first < value;
+        });
+    }
+
+    std::vector<entry_t> entries_;
+    IdFilter filter_;
+};
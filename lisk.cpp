@@ -3,6 +3,8 @@
 #include <algorithm>
 #include <sodium.h>
 
+#include "profiler.h"
+
 bytes_t firstEightBytesReversed(const bytes_t &data) {
     auto firstBytes = bytes_t{data.cbegin(), data.cbegin()+8};
     std::reverse(firstBytes.begin(), firstBytes.end());
@@ -23,15 +25,40 @@ std::uint64_t idFromEightBytes(bytes_t firstBytes)
     return out;
 }
 
-address_t addressFromPubkey(bytes_t publicKey) {
-    //auto publicKeyHex = bytes2Hex(publicKey);
+address_t addressFromPubkey(const bytes_t &publicKey) {
+    return addressFromPubkey(publicKey.data(), publicKey.size());
+}
+
+address_t addressFromPubkey(const unsigned char *publicKey, std::size_t size)
+{
+    unsigned char hash[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256(hash, publicKey, size);
+
+    address_t out = 0;
+    for (int i = 7; i >= 0; --i) {
+        out = (out << 8) | hash[i];
+    }
+    return out;
+}
 
-    auto hash = bytes_t(crypto_hash_sha256_BYTES);
-    crypto_hash_sha256(hash.data(),
-                       publicKey.data(),
-                       publicKey.size());
+bytes_t initialChainFingerprint()
+{
+    return bytes_t(crypto_hash_sha256_BYTES, 0);
+}
 
-    auto id = idFromEightBytes(firstEightBytesReversed(hash));
+void extendChainFingerprint(bytes_t &fingerprint, std::uint64_t blockId)
+{
+    unsigned char message[crypto_hash_sha256_BYTES + 8];
+    std::copy(fingerprint.begin(), fingerprint.end(), message);
+    for (int i = 0; i < 8; ++i) {
+        message[crypto_hash_sha256_BYTES + i] = (blockId >> i*8) & 0xFF;
+    }
+    fingerprint.resize(crypto_hash_sha256_BYTES);
+    crypto_hash_sha256(fingerprint.data(), message, sizeof(message));
+}
 
-    return id;
+bool verifySignature(const bytes_t &signature, const bytes_t &message, const bytes_t &publicKey)
+{
+    Profiler::Scope scope("signature verification"); static_cast<void>(scope);
+    return crypto_sign_verify_detached(signature.data(), message.data(), message.size(), publicKey.data()) == 0;
 }
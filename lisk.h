@@ -1,13 +1,25 @@
 #pragma once
 
-#include <cstdint>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 
 #include "types.h"
 
+const address_t TRASH = 12125591683379294247ul; // random address that is hopefully not used
+
 bytes_t firstEightBytesReversed(const bytes_t &data);
 std::uint64_t idFromEightBytes(bytes_t firstBytes);
-address_t addressFromPubkey(bytes_t publicKey);
+address_t addressFromPubkey(const bytes_t &publicKey);
+address_t addressFromPubkey(const unsigned char *publicKey, std::size_t size);
+
+// Ed25519 verification of a detached signature. Lengths must have been checked by the caller.
+bool verifySignature(const bytes_t &signature, const bytes_t &message, const bytes_t &publicKey);
+
+// Running hash over the IDs of all blocks from genesis: SHA-256(fingerprint || id).
+// Starts with 32 zero bytes before the genesis block.
+bytes_t initialChainFingerprint();
+void extendChainFingerprint(bytes_t &fingerprint, std::uint64_t blockId);
 inline std::uint64_t roundFromHeight(std::uint64_t height) {
     return std::ceil(height / 101.0);
 }
@@ -1,5 +1,11 @@
 #include "log.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
 namespace {
 
 class ThousandSeparator : public std::numpunct<char>
@@ -9,6 +15,122 @@ protected:
     virtual std::string do_grouping() const { return "\03"; }
 };
 
+// The producer waits when this much output is pending, so memory stays bounded
+const std::size_t MAX_QUEUED = 16 * 1024 * 1024;
+// Output waiting for a flush is handed to the writer thread from this size on
+const std::size_t HAND_OVER_SIZE = 64 * 1024;
+
+std::atomic<AsyncConsole::Buffer *> activeBuffer(nullptr);
+
 }
 
 std::numpunct<char>* NumberLog::thousandSeparator_ = new ThousandSeparator;
+
+class AsyncConsole::Buffer : public std::streambuf {
+public:
+    explicit Buffer(std::streambuf *target)
+        : target_(target)
+        , writer_([this]() { writeLoop(); })
+    {
+    }
+
+    ~Buffer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        changed_.notify_all();
+        writer_.join();
+    }
+
+    std::size_t queued()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queued_.size() + writing_;
+    }
+
+protected:
+    // Without a put area, every write ends up here, so that the threads of a pool can print, too
+    std::streamsize xsputn(const char *data, std::streamsize count) override
+    {
+        bool full;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            drained_.wait(lock, [this]() { return queued_.size() < MAX_QUEUED; });
+            queued_.append(data, static_cast<std::size_t>(count));
+            full = (queued_.size() >= HAND_OVER_SIZE);
+        }
+        if (full) changed_.notify_one();
+        return count;
+    }
+
+    int_type overflow(int_type c) override
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            const char character = traits_type::to_char_type(c);
+            xsputn(&character, 1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    // Called by std::flush and std::endl. Does not wait for the output to be written.
+    int sync() override
+    {
+        changed_.notify_one();
+        return 0;
+    }
+
+private:
+    void writeLoop()
+    {
+        std::string chunk;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            changed_.wait(lock, [this]() { return stopping_ || !queued_.empty(); });
+            if (queued_.empty()) return;
+
+            chunk.swap(queued_);
+            writing_ = chunk.size();
+            drained_.notify_all();
+            lock.unlock();
+            target_->sputn(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+            target_->pubsync();
+            chunk.clear();
+            lock.lock();
+            writing_ = 0;
+        }
+    }
+
+    std::streambuf *target_;
+
+    std::mutex mutex_;
+    std::condition_variable changed_; // output queued or stopping
+    std::condition_variable drained_; // queued output taken by the writer
+    std::string queued_;
+    std::size_t writing_ = 0;
+    bool stopping_ = false;
+
+    std::thread writer_; // last, so that it starts after the members it uses
+};
+
+AsyncConsole::AsyncConsole()
+    : buffer_(new Buffer(std::cout.rdbuf()))
+    , original_(std::cout.rdbuf(buffer_.get()))
+{
+    activeBuffer = buffer_.get();
+}
+
+AsyncConsole::~AsyncConsole()
+{
+    std::cout.flush();
+    activeBuffer = nullptr;
+    std::cout.rdbuf(original_);
+    buffer_.reset();
+}
+
+std::size_t AsyncConsole::queuedBytes()
+{
+    auto *buffer = activeBuffer.load();
+    return buffer ? buffer->queued() : 0;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 
 class NumberLog {
 public:
@@ -23,3 +24,25 @@ private:
     std::ios oldState_;
     static std::numpunct<char>* thousandSeparator_;
 };
+
+// While alive, std::cout only appends to a buffer and a background thread does the writing, so
+// that a slow terminal or pipe never stalls the replay. The order of the output is kept;
+// std::cerr stays synchronous. Only one instance may exist at a time.
+class AsyncConsole {
+public:
+    AsyncConsole();
+    // Writes everything still buffered
+    ~AsyncConsole();
+
+    AsyncConsole(const AsyncConsole &) = delete;
+    AsyncConsole &operator=(const AsyncConsole &) = delete;
+
+    // Bytes waiting to be written, 0 without an instance
+    static std::size_t queuedBytes();
+
+    class Buffer;
+
+private:
+    std::unique_ptr<Buffer> buffer_;
+    std::streambuf *original_;
+};
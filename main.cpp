@@ -1,36 +1,336 @@
 #include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
 #include <iostream>
-#include <unordered_map>
+#include <memory>
+#include <thread>
+
+#include <unistd.h>
 
 // with c++14 enabled, std::experimental::optional is always available
 #define PQXX_HAVE_EXP_OPTIONAL 1
 #include <pqxx/pqxx>
 #include <sodium.h>
 
+#include "address_trace.h"
 #include "assets.h"
 #include "blockchain_state.h"
 #include "blockchain_state_validator.h"
-#include "block.h"
-#include "block_validator.h"
+#include "chain_cache.h"
+#include "checkpoint.h"
+#include "database.h"
+#include "distributed.h"
+#include "failure_collector.h"
+#include "follow.h"
+#include "header_check.h"
 #include "lisk.h"
-#include "payload.h"
+#include "options.h"
+#include "parallel_checks.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "progress_feed.h"
+#include "replay.h"
+#include "run_metrics.h"
 #include "settings.h"
+#include "signature_cache.h"
+#include "signature_sampling.h"
+#include "state_fingerprint.h"
 #include "scopedbenchmark.h"
 #include "summaries.h"
-#include "transaction.h"
-#include "transaction_validator.h"
+#include "thread_pool.h"
 #include "types.h"
-#include "utils.h"
 #include "log.h"
 
-address_t TRASH = 12125591683379294247ul; // random address that is hopefully not used
-
 void printHelp()
 {
-    std::cout << "usage: snapshot-validator mainnet|testnet|betanet database_name" << std::endl;
+    std::cout << "usage: snapshot-validator [options] mainnet|testnet|betanet|synthetic database_name" << std::endl;
+    std::cout << std::endl;
+    std::cout << "options:" << std::endl;
+    std::cout << "  --cache-dir DIR    read blocks and transactions from a chain cache in DIR," << std::endl;
+    std::cout << "                     creating it from the database if missing or stale" << std::endl;
+    std::cout << "  --checkpoint-dir DIR" << std::endl;
+    std::cout << "                     write a checkpoint of the replay to DIR periodically" << std::endl;
+    std::cout << "  --checkpoint-interval ROUNDS" << std::endl;
+    std::cout << "                     rounds between two checkpoints (default: 1000)" << std::endl;
+    std::cout << "  --resume-from FILE load checkpoint FILE and continue after its height" << std::endl;
+    std::cout << "  --incremental-from FILE" << std::endl;
+    std::cout << "                     like --resume-from, but first check that all block IDs up to" << std::endl;
+    std::cout << "                     the checkpoint height match those of the checkpoint's run; of the" << std::endl;
+    std::cout << "                     older transactions only the IDs are read, to check uniqueness" << std::endl;
+    std::cout << "  --signature-cache FILE" << std::endl;
+    std::cout << "                     skip transaction signatures verified by earlier runs sharing FILE" << std::endl;
+    std::cout << "  --state-fingerprints FILE" << std::endl;
+    std::cout << "                     write a fingerprint of all accounts at the end of every round to FILE" << std::endl;
+    std::cout << "  --follow           after validating, keep validating new blocks of a running node" << std::endl;
+    std::cout << "  --follow-interval SECONDS" << std::endl;
+    std::cout << "                     time between two checks for new blocks (default: 10)" << std::endl;
+    std::cout << "  --sql-integrity-checks" << std::endl;
+    std::cout << "                     additionally run the full table scans counting rows and checking" << std::endl;
+    std::cout << "                     transaction ID uniqueness in SQL, alongside the replay" << std::endl;
+    std::cout << "  --check-invariants-per-round" << std::endl;
+    std::cout << "                     check all changed accounts at the end of each round instead of" << std::endl;
+    std::cout << "                     after each block; negative balances are still found per block" << std::endl;
+    std::cout << "  --max-failures N   record failed checks and continue, stopping after N failures" << std::endl;
+    std::cout << "  --failure-report FILE" << std::endl;
+    std::cout << "                     JSON report of the failures found with --max-failures" << std::endl;
+    std::cout << "                     (default: failures.json)" << std::endl;
+    std::cout << "  --sample-signatures P" << std::endl;
+    std::cout << "                     verify only a fraction P in (0, 1] of the transaction signatures;" << std::endl;
+    std::cout << "                     block signatures and second signatures are always verified" << std::endl;
+    std::cout << "  --sample-seed N    seed selecting the sampled signatures (default: 0)" << std::endl;
+    std::cout << "  --headers-only     only check heights, linkage, IDs, signatures and rewards of all" << std::endl;
+    std::cout << "                     blocks, using all cores; transactions and accounts are not read" << std::endl;
+    std::cout << "  --trace-address ADDRESS" << std::endl;
+    std::cout << "                     print every change of balance and last block ID of one account" << std::endl;
+    std::cout << "                     instead of validating, e.g. to investigate a mem_accounts mismatch" << std::endl;
+    std::cout << "  --trace-file FILE  write a timeline of reading, blocks, signatures, state changes and" << std::endl;
+    std::cout << "                     rounds on all threads in Chrome trace format, e.g. for Perfetto" << std::endl;
+    std::cout << "  --progress-socket PATH" << std::endl;
+    std::cout << "                     every second, send height, speed, ETA, memory and stage as a JSON" << std::endl;
+    std::cout << "                     line to all clients connected to a Unix domain socket at PATH" << std::endl;
+    std::cout << "  --progress-fd N    write the same JSON lines to the open file descriptor N" << std::endl;
+    std::cout << "  --perf-counters    count cycles, instructions, cache and branch misses of the main" << std::endl;
+    std::cout << "                     stages with perf_event_open and print them per block and transaction" << std::endl;
+    std::cout << "  --metrics-file FILE" << std::endl;
+    std::cout << "                     after a successful run, write blocks/s, transactions/s, peak memory" << std::endl;
+    std::cout << "                     and the time of every stage as JSON to FILE" << std::endl;
+    std::cout << "  --worker-command COMMAND" << std::endl;
+    std::cout << "                     leave the checks not depending on the account state to a worker" << std::endl;
+    std::cout << "                     started with the shell COMMAND, e.g. 'ssh host snapshot-validator" << std::endl;
+    std::cout << "                     --worker mainnet lisk_main'; repeat for more workers" << std::endl;
+    std::cout << "  --local-workers N  start N workers running this program on the same database" << std::endl;
+    std::cout << "  --worker-range BLOCKS" << std::endl;
+    std::cout << "                     blocks per request to a worker (default: 10000)" << std::endl;
+    std::cout << "  --worker           check height ranges for a coordinator, talking on stdin and stdout;" << std::endl;
+    std::cout << "                     takes --cache-dir, --signature-cache and --sample-signatures" << std::endl;
+    std::cout << "  --threads N        threads for decoding, signatures, hashing and the final checks," << std::endl;
+    std::cout << "                     including the one replaying blocks (default: one per hardware thread)" << std::endl;
+    std::cout << "  --pin-threads      bind each of these threads to a CPU of its own" << std::endl;
+}
+
+void saveSignatureCache(SignatureCache &signatureCache)
+{
+    std::cout << "Signature cache: " << signatureCache.hits() << " hits, "
+              << signatureCache.inserted() << " new entries" << std::endl;
+    signatureCache.save();
+}
+
+// Reads transactions, checking while streaming that every transaction ID is unique in trs and
+// in the asset tables, also against the transactions below fromHeight. Only on a duplicate the
+// SQL checks run to name the offending table.
+Database::BlockTransactions readCheckedTransactions(pqxx::read_transaction &db, const Settings &settings,
+                                                   ThreadPool &pool, height_t fromHeight = 1)
+{
+    Database::TransactionStatistics statistics;
+    auto blockToTransactions = Database::readCheckedTransactions(db, settings, fromHeight, Database::MAX_HEIGHT,
+                                                                 statistics, &pool);
+    std::cout << "Transaction count " << statistics.rowCount << std::endl;
+    return blockToTransactions;
+}
+
+// Returns false without writing the cache if a block or transaction does not fit into it
+bool buildChainCache(pqxx::read_transaction &db, const Settings &settings, ThreadPool &pool,
+                     const std::string &path, const ChainCache::fingerprint_t &fingerprint)
+{
+    auto blockToTransactions = readCheckedTransactions(db, settings, pool);
+
+    std::cout << "Writing chain cache " << path << " ..." << std::endl;
+    ScopedBenchmark benchmarkCache("Writing chain cache"); static_cast<void>(benchmarkCache);
+
+    ChainCache::Writer writer;
+    height_t unfitHeight = 0;
+    Database::readBlocks(db, [&](const BlockRow &block) {
+        if (unfitHeight) return;
+        bool added;
+        auto transactions = blockToTransactions.find(block.id);
+        if (transactions != blockToTransactions.end()) {
+            added = writer.addBlock(block, transactions->second);
+            blockToTransactions.erase(transactions);
+        } else {
+            added = writer.addBlock(block, {});
+        }
+        if (!added) unfitHeight = block.height;
+    });
+    if (unfitHeight) {
+        std::cout << "Block at height " << unfitHeight << " has a key, hash or signature too long for the chain cache,"
+                  << " reading from the database instead" << std::endl;
+        return false;
+    }
+    writer.write(path, fingerprint);
+    return true;
+}
+
+// Builds the cache first if it is missing or stale. Returns nullptr if the chain cannot be cached.
+std::unique_ptr<ChainCache::Reader> openChainCache(pqxx::read_transaction &db, const Options &options, const Settings &settings,
+                                                   ThreadPool &pool)
+{
+    const auto fingerprint = ChainCache::fingerprint(db, options.network, settings);
+    const auto path = ChainCache::filePath(options.cacheDir, fingerprint);
+
+    std::unique_ptr<ChainCache::Reader> cache;
+    try {
+        cache.reset(new ChainCache::Reader(path, fingerprint));
+    } catch (const std::runtime_error &e) {
+        std::cout << e.what() << std::endl;
+        if (!buildChainCache(db, settings, pool, path, fingerprint)) return nullptr;
+        cache.reset(new ChainCache::Reader(path, fingerprint));
+    }
+    std::cout << "Reading blocks from chain cache " << path << " ..." << std::endl;
+    return cache;
+}
+
+void replayFromDatabase(pqxx::read_transaction &db, const Settings &settings, Replay &replay,
+                        ParallelChecks *parallelChecks, ThreadPool &pool, height_t fromHeight)
+{
+    auto blockToTransactions = readCheckedTransactions(db, settings, pool, fromHeight);
+
+    std::cout << "Reading blocks ..." << std::endl;
+    ScopedBenchmark benchmarkBlocks("Reading blocks"); static_cast<void>(benchmarkBlocks);
+    PerfCounters::Stage perfStage("block loop"); static_cast<void>(perfStage);
+    Database::readBlocks(db, [&](const BlockRow &block) {
+        if (parallelChecks) {
+            parallelChecks->add(block, std::move(blockToTransactions[block.id]));
+        } else {
+            replay.processBlock(block, blockToTransactions[block.id]);
+        }
+    }, fromHeight);
+    if (parallelChecks) parallelChecks->flush();
+}
+
+// With parallelChecks, blocks are replayed through it
+void replayFromChainCache(pqxx::read_transaction &db, const Options &options, const Settings &settings,
+                          Replay &replay, ParallelChecks *parallelChecks, ThreadPool &pool, height_t fromHeight)
+{
+    const auto cache = openChainCache(db, options, settings, pool);
+    if (!cache) {
+        replayFromDatabase(db, settings, replay, parallelChecks, pool, fromHeight);
+        return;
+    }
+
+    ScopedBenchmark benchmarkBlocks("Reading blocks"); static_cast<void>(benchmarkBlocks);
+    PerfCounters::Stage perfStage("block loop"); static_cast<void>(perfStage);
+    std::uint64_t transactionCount = 0;
+    cache->forEachBlock([&](const BlockRow &block, const std::vector<TransactionRow> &transactions) {
+        transactionCount += transactions.size();
+        if (parallelChecks) {
+            parallelChecks->add(block, transactions);
+        } else {
+            replay.processBlock(block, transactions);
+        }
+    }, fromHeight);
+    if (parallelChecks) parallelChecks->flush();
+    std::cout << "Transaction count " << transactionCount << std::endl;
+}
+
+// Answers the requests of a coordinator on protocolFd, reading blocks like the replay does
+void runWorker(pqxx::read_transaction &db, const Options &options, const Settings &settings,
+               SignatureCache *signatureCache, ThreadPool &pool, int protocolFd)
+{
+    std::unique_ptr<ChainCache::Reader> cache;
+    if (!options.cacheDir.empty()) {
+        cache = openChainCache(db, options, settings, pool);
+    }
+
+    std::unique_ptr<SignatureSampling> signatureSampling;
+    if (options.sampleSignatures < 1) {
+        signatureSampling.reset(new SignatureSampling(options.sampleSignatures, options.sampleSeed));
+    }
+
+    auto read = [&](height_t fromHeight, height_t toHeight, const Distributed::BlockCallback &callback) {
+        if (cache) {
+            cache->forEachBlock(callback, fromHeight, toHeight);
+            return;
+        }
+        auto blockToTransactions = Database::readTransactions(db, settings, fromHeight, toHeight, nullptr, &pool);
+        Database::readBlocks(db, [&](const BlockRow &block) {
+            callback(block, blockToTransactions[block.id]);
+        }, fromHeight, toHeight);
+    };
+
+    std::cout << "Waiting for requests ..." << std::endl;
+    Distributed::serveWorker(read, options.network, settings, signatureCache, signatureSampling.get(), pool, protocolFd);
 }
 
-int run(std::vector<std::string> args)
+// Returns the height to continue from
+height_t resumeFromCheckpoint(pqxx::read_transaction &db, const Options &options, Replay &replay)
+{
+    std::cout << "Loading checkpoint " << options.resumeFrom << " ..." << std::endl;
+    ScopedBenchmark benchmarkCheckpoint("Loading checkpoint"); static_cast<void>(benchmarkCheckpoint);
+
+    const auto checkpoint = Checkpoints::read(options.resumeFrom, replay.blockchainState());
+    if (checkpoint.network != options.network) {
+        throw std::runtime_error("Checkpoint " + options.resumeFrom + " was created for " + networkName(checkpoint.network));
+    }
+
+    const auto height = checkpoint.position.height;
+
+    if (options.verifyPrefix) {
+        std::cout << "Comparing block IDs up to height " << height << " ..." << std::endl;
+        ScopedBenchmark benchmarkPrefix("Comparing block IDs"); static_cast<void>(benchmarkPrefix);
+        if (Database::chainFingerprint(db, height) != checkpoint.position.chainFingerprint) {
+            throw std::runtime_error("Blocks up to height " + std::to_string(height) +
+                                     " differ from the blocks of checkpoint " + options.resumeFrom);
+        }
+    }
+
+    bool found = false;
+    Database::readBlocks(db, [&](const BlockRow &block) {
+        found = true;
+        if (block.id != checkpoint.position.blockId || block.header.hash(block.signature) != checkpoint.blockHash) {
+            throw std::runtime_error("Block " + std::to_string(block.id) + " at height " + std::to_string(height) +
+                                     " does not match block " + std::to_string(checkpoint.position.blockId) +
+                                     " of the checkpoint");
+        }
+    }, height, height);
+    if (!found) {
+        throw std::runtime_error("No block at checkpoint height " + std::to_string(height));
+    }
+
+    replay.restore(checkpoint.position);
+    std::cout << "Resuming after block " << checkpoint.position.blockId << " at height " << height << std::endl;
+    return height + 1;
+}
+
+// Writes a checkpoint every checkpointInterval rounds and at the last round end before maxHeight,
+// whose path is stored in finalPath. Checkpoints of rounds rolled back later are removed.
+void enableCheckpoints(const Options &options, Replay &replay, height_t maxHeight, std::string &finalPath)
+{
+    replay.addRoundRolledBackCallback([&options](height_t height) {
+        const auto path = Checkpoints::filePath(options.checkpointDir, options.network, height);
+        if (std::remove(path.c_str()) == 0) {
+            std::cout << "Removed checkpoint " << path << " of a replaced block" << std::endl;
+        }
+    });
+
+    const height_t finalRoundHeight = maxHeight - maxHeight%101;
+    std::string previousPath;
+    replay.addRoundClosedCallback([&options, &replay, &finalPath, finalRoundHeight, previousPath](const BlockRow &block) mutable {
+        const bool isFinal = (block.height == finalRoundHeight);
+        if (roundFromHeight(block.height) % options.checkpointInterval != 0 && !isFinal) return;
+
+        Checkpoint checkpoint;
+        checkpoint.network = options.network;
+        checkpoint.position = replay.position();
+        checkpoint.blockHash = block.header.hash(block.signature);
+
+        const auto path = Checkpoints::filePath(options.checkpointDir, options.network, block.height);
+        Checkpoints::write(path, checkpoint, replay.blockchainState());
+
+        // Only the latest checkpoint is kept
+        if (!previousPath.empty()) {
+            std::remove(previousPath.c_str());
+        }
+        previousPath = path;
+
+        if (isFinal) {
+            finalPath = path;
+        }
+    });
+}
+
+// Sets metricsFile only after a successful full validation, when metrics were requested
+int run(std::vector<std::string> args, RunMetrics &metrics, std::string &metricsFile)
 {
     if (args.size() >= 2 && args[1] == "--help")
     {
@@ -38,40 +338,98 @@ int run(std::vector<std::string> args)
         return 0;
     }
 
-    if (args.size() != 3)
+    Options options;
+    try
+    {
+        options = parseOptions(args);
+    }
+    catch (const std::exception &e)
     {
+        std::cerr << e.what() << std::endl;
         printHelp();
         return 1;
     }
 
+    if (!options.traceFile.empty()) {
+        try {
+            Profiler::startTrace(options.traceFile);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // The protocol of a worker owns stdout, everything printed goes to stderr instead
+    int protocolFd = -1;
+    if (options.worker) {
+        protocolFd = dup(STDOUT_FILENO);
+        if (protocolFd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            std::cerr << "Could not redirect stdout" << std::endl;
+            return 1;
+        }
+    }
+
     ScopedBenchmark benchmarkFull("Overall runtime"); static_cast<void>(benchmarkFull);
 
     if (sodium_init() == -1) {
         return 1;
     }
 
-    const Network network = networkFromName(args[1]);
-    const std::string dbname = args[2];
+    // Before the thread pool is created, so that its threads are counted as well
+    if (options.perfCounters) {
+        PerfCounters::enable();
+    }
+
+    const Network network = options.network;
+    const std::string dbname = options.databaseName;
+
+    std::unique_ptr<SignatureCache> signatureCache;
+    std::unique_ptr<FailureCollector> failures;
+    std::unique_ptr<ProgressFeed> progress;
+    auto finish = [&](const char *status) {
+        if (progress) progress->finish(status);
+    };
 
     try
     {
+        if (!options.progressSocket.empty()) {
+            progress = ProgressFeed::onSocket(options.progressSocket);
+        } else if (options.progressFd >= 0) {
+            progress = ProgressFeed::toFileDescriptor(options.progressFd);
+        }
+
+        unsigned threads = options.threads > 0 ? options.threads : std::thread::hardware_concurrency();
+        if (options.localWorkers > 0) {
+            // Local workers share the cores; the coordinator keeps the rest, at least its replay thread
+            const auto workerThreads = options.localWorkers * Distributed::localWorkerThreads(options);
+            threads = threads > workerThreads ? threads - workerThreads : 1;
+        }
+        // One thread less, as the thread replaying blocks runs tasks while waiting for them
+        ThreadPool pool(threads > 1 ? threads - 1 : 0, options.pinThreads);
+
         pqxx::connection dbConnection("dbname=" + dbname);
         std::cout << "Connected to database " << dbConnection.dbname() << std::endl;
         pqxx::read_transaction db(dbConnection);
 
-        {
-            auto row = db.exec1("SELECT COUNT(*) AS number FROM trs");
-            std::cout << "Transaction count " << row[0].c_str() << std::endl;
-        }
+        if (options.sqlIntegrityChecks) {
+            {
+                auto row = db.exec1("SELECT COUNT(*) AS number FROM trs");
+                std::cout << "Transaction count (SQL) " << row[0].c_str() << std::endl;
+            }
 
-        {
-            auto row = db.exec1("SELECT COUNT(*) AS number FROM blocks");
-            std::cout << "Blocks count " << row[0].c_str() << std::endl;
+            {
+                auto row = db.exec1("SELECT COUNT(*) AS number FROM blocks");
+                std::cout << "Blocks count (SQL) " << row[0].c_str() << std::endl;
+            }
         }
 
-        {
+        // Answered from the height index; only needed to plan ahead of the replay
+        height_t maxHeight = 0;
+        if (!options.checkpointDir.empty() || options.follow || progress ||
+                !options.workerCommands.empty() || options.localWorkers > 0) {
             auto row = db.exec1("SELECT MAX(height) AS height FROM blocks");
-            std::cout << "Height: " << row[0].c_str() << std::endl;
+            maxHeight = row[0].as<height_t>(0);
+            if (progress) progress->setTargetHeight(maxHeight);
         }
 
         Settings settings(network);
@@ -81,371 +439,237 @@ int run(std::vector<std::string> args)
             AddressSummary::defaultLastBlockId = settings.genesisBlock;
         }
 
+        if (!options.traceAddress.empty()) {
+            AddressTrace::run(db, settings, AddressTrace::parseAddress(options.traceAddress));
+            db.commit();
+            finish("done");
+            return 0;
+        }
+
+        if (options.worker) {
+            if (!options.signatureCache.empty()) {
+                signatureCache.reset(new SignatureCache(options.signatureCache));
+            }
+            runWorker(db, options, settings, signatureCache.get(), pool, protocolFd);
+            if (signatureCache) {
+                saveSignatureCache(*signatureCache);
+                signatureCache.reset();
+            }
+            db.commit();
+            return 0;
+        }
+
+        if (options.headersOnly) {
+            HeaderCheck::run(db, settings, pool);
+            pool.printStatistics(std::cout);
+            db.commit();
+            finish("valid");
+            return 0;
+        }
+
         Assets::peersEmpty(db);
         if (!settings.v100Compatible)
         {
             Assets::peersDappEmpty(db);
         }
-        if (settings.v100Compatible)
+        // The table scans run in the background during the replay
+        std::unique_ptr<Assets::BackgroundValidation> assetChecks;
+        if (options.sqlIntegrityChecks)
         {
-            Assets::validateType0AssetData(db);
-        }
-        Assets::validateType1AssetData(db);
-        Assets::validateType2AssetData(db);
-        Assets::validateType3AssetData(db);
-        Assets::validateType4AssetData(db);
-        Assets::validateType5AssetData(db);
-        Assets::validateType6AssetData(db);
-        Assets::validateType7AssetData(db);
+            assetChecks.reset(new Assets::BackgroundValidation(dbname, settings));
+        }
         Assets::checkUnconfirmedInMemAccounts(db);
 
-        std::unordered_map<std::uint64_t, std::vector<TransactionRow>> blockToTransactions;
-        BlockchainState blockchainState;
+        Replay replay(settings);
+        replay.setInvariantChecksPerRound(options.invariantChecksPerRound);
+        replay.setProgressFeed(progress.get());
 
-        {
-            std::cout << "Reading transactions ..." << std::endl;
-            ScopedBenchmark benchmarkTransactions("Reading transactions"); static_cast<void>(benchmarkTransactions);
-
-            pqxx::result result = db.exec(R"SQL(
-                SELECT
-                    id, "blockId", trs.type, timestamp, "senderPublicKey", coalesce(left("recipientId", -1), '0') AS recipient_address,
-                    amount, fee, signature, "signSignature",
-                    )SQL" + std::string(settings.v100Compatible ? "transfer.data" : "''") + R"SQL( AS type0_asset,
-                    signatures."publicKey" AS type1_asset,
-                    delegates.username AS type2_asset,
-                    replace(votes.votes, ',', '') AS type3_asset,
-                    coalesce(multisignatures.min, 0) AS type4_asset_min, coalesce(multisignatures.lifetime, 0) AS type4_asset_lifetime,
-                    replace(multisignatures.keysgroup, ',', '') AS type4_asset_keys,
-                    (coalesce(dapps.name, '') || coalesce(dapps.description, '') || coalesce(dapps.tags, '') || coalesce(dapps.link, '') || coalesce(dapps.icon, '')) AS type5_asset_texts,
-                    coalesce(dapps.type, 0) AS type5_asset_type, coalesce(dapps.category, 0) AS type5_asset_category,
-                    coalesce(intransfer."dappId", '0') AS type6_asset,
-                    coalesce(outtransfer."dappId", '0') AS type7_asset_dappid,
-                    coalesce(outtransfer."outTransactionId", '0') AS type7_asset_outtransactionId
-                FROM trs
-                )SQL" + std::string(settings.v100Compatible ? "LEFT JOIN transfer ON trs.id = transfer.\"transactionId\"" : "") + R"SQL(
-                LEFT JOIN signatures ON trs.id = signatures."transactionId"
-                LEFT JOIN delegates ON trs.id = delegates."transactionId"
-                LEFT JOIN votes ON trs.id = votes."transactionId"
-                LEFT JOIN multisignatures ON trs.id = multisignatures."transactionId"
-                LEFT JOIN dapps ON trs.id = dapps."transactionId"
-                LEFT JOIN intransfer ON trs.id = intransfer."transactionId"
-                LEFT JOIN outtransfer ON trs.id = outtransfer."transactionId"
-                ORDER BY "rowId"
-            )SQL");
-            for (auto row : result) {
-                try {
-                    // Read fields in row
-                    int index = 0;
-                    const auto dbId = row[index++].as<std::uint64_t>();
-                    const auto dbBockId = row[index++].as<std::uint64_t>();
-                    const auto dbType = row[index++].as<int>();
-                    const auto dbTimestamp = row[index++].as<std::int32_t>();
-                    const auto dbSenderPublicKey = pqxx::binarystring(row[index++]);
-                    std::uint64_t dbRecipientId;
-                    if (settings.exceptions.transactionsContainingInvalidRecipientAddress.count(dbId)) {
-                        index++;
-                        dbRecipientId = TRASH;
-                    } else {
-                        dbRecipientId = row[index++].as<std::uint64_t>();
-                    }
-                    const auto dbAmount = row[index++].as<std::uint64_t>();
-                    const auto dbFee = row[index++].as<std::uint64_t>();
-                    const auto dbSignature = pqxx::binarystring(row[index++]);
-                    const auto dbSecondSignature = pqxx::binarystring(row[index++]);
-                    const auto dbType0Asset = pqxx::binarystring(row[index++]);
-                    const auto dbType1Asset = pqxx::binarystring(row[index++]);
-                    const auto dbType2Asset = row[index++].get<std::string>();
-                    const auto dbType3Asset = row[index++].get<std::string>();
-                    const auto dbType4AssetMin = row[index++].as<int>();
-                    const auto dbType4AssetLifetime = row[index++].as<int>();
-                    const auto dbType4AssetKeys = row[index++].get<std::string>();
-                    const auto dbType5AssetText = row[index++].get<std::string>();
-                    const auto dbType5AssetType = row[index++].as<std::uint32_t>();
-                    const auto dbType5AssetCategory = row[index++].as<std::uint32_t>();
-                    const auto dbType6AssetDappId = row[index++].as<std::uint64_t>();
-                    const auto dbType7AssetDappId = row[index++].as<std::uint64_t>();
-                    const auto dbType7AssetDappOutTransferId = row[index++].as<std::uint64_t>();
-
-                    // Parse fields in row
-                    const auto senderPublicKey = asVector(dbSenderPublicKey);
-                    const auto signature = asVector(dbSignature);
-                    const auto secondSignature = asVector(dbSecondSignature);
-
-                    std::uint64_t dappId = 0;
-                    std::vector<unsigned char> assetData = {};
-                    switch (dbType) {
-                    case 0:
-                        assetData = asVector(dbType0Asset);
-                        break;
-                    case 1:
-                        assetData = asVector(dbType1Asset);
-                        break;
-                    case 2:
-                        assetData = asVector(*dbType2Asset);
-                        break;
-                    case 3:
-                        assetData = asVector(*dbType3Asset);
-                        break;
-                    case 4: {
-                        assetData.push_back(static_cast<std::uint8_t>(dbType4AssetMin));
-                        assetData.push_back(static_cast<std::uint8_t>(dbType4AssetLifetime));
-                        auto keys = asVector(*dbType4AssetKeys);
-                        assetData.insert(assetData.end(), keys.cbegin(), keys.cend());
-                        break;
-                    }
-                    case 5:
-                        assetData = asVector(*dbType5AssetText);
-                        assetData.push_back((dbType5AssetType >> 0*8) & 0xff);
-                        assetData.push_back((dbType5AssetType >> 1*8) & 0xff);
-                        assetData.push_back((dbType5AssetType >> 2*8) & 0xff);
-                        assetData.push_back((dbType5AssetType >> 3*8) & 0xff);
-                        assetData.push_back((dbType5AssetCategory >> 0*8) & 0xff);
-                        assetData.push_back((dbType5AssetCategory >> 1*8) & 0xff);
-                        assetData.push_back((dbType5AssetCategory >> 2*8) & 0xff);
-                        assetData.push_back((dbType5AssetCategory >> 3*8) & 0xff);
-                        break;
-                    case 6:
-                        assetData = asVector(std::to_string(dbType6AssetDappId));
-                        dappId = dbType6AssetDappId;
-                        break;
-                    case 7:
-                        assetData = asVector(std::to_string(dbType7AssetDappId) + std::to_string(dbType7AssetDappOutTransferId));
-                        dappId = dbType7AssetDappId;
-                        break;
-                    }
-
-                    auto t = Transaction(
-                        dbType,
-                        dbTimestamp,
-                        senderPublicKey,
-                        dbRecipientId,
-                        dbAmount,
-                        dbFee,
-                        assetData,
-                        dappId
-                    );
-                    blockToTransactions[dbBockId].emplace_back(t, signature, secondSignature, dbId, dbBockId);
-                }
-                catch (const std::exception &e)
-                {
-                    std::cout << "Exception '" << e.what() << "' when reading row:\n";
-                    for (int i = 0; i < row.size(); ++i)
-                    {
-                        if (i > 0) std::cout << "|";
-                        std::cout << std::string(row[i].c_str());
-                    }
-                    std::cout << std::endl;
-                    throw;
-                }
-            }
+        std::unique_ptr<SignatureSampling> signatureSampling;
+        if (options.sampleSignatures < 1) {
+            signatureSampling.reset(new SignatureSampling(options.sampleSignatures, options.sampleSeed));
+            replay.setSignatureSampling(signatureSampling.get());
         }
 
+        if (options.maxFailures > 0) {
+            failures.reset(new FailureCollector(options.maxFailures));
+            replay.setFailureCollector(failures.get());
+        }
 
-        {
-            std::cout << "Reading blocks ..." << std::endl;
-            ScopedBenchmark benchmarkBlocks("Reading blocks"); static_cast<void>(benchmarkBlocks);
-            std::unordered_map<std::uint64_t, std::chrono::steady_clock::time_point> times;
-
-            pqxx::result R = db.exec(R"SQL(
-                SELECT
-                    id, version, timestamp, height, "previousBlock", "numberOfTransactions", "totalAmount", "totalFee", reward,
-                    "payloadLength", "payloadHash", "generatorPublicKey", "blockSignature"
-                FROM blocks
-                ORDER BY height
-            )SQL");
-
-            std::uint64_t lastHeight = 0;
-            std::uint64_t lastBlockId = 0;
-            std::uint64_t roundFees = 0;
-            std::vector<std::uint64_t> roundDelegates = std::vector<std::uint64_t>(101);
-            std::vector<std::uint64_t> roundRewards = std::vector<std::uint64_t>(101);
-            for (auto row : R) {
-                int index = 0;
-                const auto dbId = row[index++].as<std::uint64_t>();
-                const auto dbVersion = row[index++].as<std::uint32_t>();
-                const auto dbTimestamp = row[index++].as<std::uint32_t>();
-                const auto dbHeight = row[index++].as<std::uint64_t>();
-                const auto dbPreviousBlock = row[index++].get<std::uint64_t>();
-                const auto dbNumberOfTransactions = row[index++].as<std::uint32_t>();
-                const auto dbTotalAmount = row[index++].as<std::uint64_t>();
-                const auto dbTotalFee = row[index++].as<std::uint64_t>();
-                const auto dbReward = row[index++].as<std::uint64_t>();
-                const auto dbPayloadLength = row[index++].as<std::uint32_t>();
-                const auto dbPayloadHash = pqxx::binarystring(row[index++]);
-                const auto dbGeneratorPublicKey = pqxx::binarystring(row[index++]);
-                const auto dbSignature = pqxx::binarystring(row[index++]);
-
-                const auto generatorPublicKey = asVector(dbGeneratorPublicKey);
-                const auto payloadHash = asVector(dbPayloadHash);
-                const auto signature = asVector(dbSignature);
-
-                if (dbHeight != lastHeight + 1) {
-                    throw std::runtime_error("Height mismatch");
-                }
-                lastHeight = dbHeight;
+        if (!options.signatureCache.empty()) {
+            signatureCache.reset(new SignatureCache(options.signatureCache));
+            replay.setSignatureCache(signatureCache.get());
+        }
+
+        height_t fromHeight = 1;
+        if (!options.resumeFrom.empty()) {
+            fromHeight = resumeFromCheckpoint(db, options, replay);
+        }
 
-                if (dbHeight != 1) {
-                    if (*dbPreviousBlock != lastBlockId) {
-                        throw std::runtime_error("previous block mismatch");
-                    }
+        StateFingerprint stateFingerprint;
+        std::ofstream stateFingerprints;
+        std::deque<std::pair<height_t, std::streamoff>> stateFingerprintLines; // the last rounds' lines
+        if (!options.stateFingerprints.empty()) {
+            stateFingerprints.open(options.stateFingerprints, std::ios::trunc);
+            if (!stateFingerprints) {
+                throw std::runtime_error("Could not open " + options.stateFingerprints + " for writing");
+            }
+
+            stateFingerprint.reset(replay.blockchainState());
+            replay.setStateFingerprint(&stateFingerprint);
+            replay.addRoundClosedCallback([&](const BlockRow &block) {
+                stateFingerprintLines.emplace_back(block.height, stateFingerprints.tellp());
+                if (stateFingerprintLines.size() > Follow::JOURNAL_ROUNDS) {
+                    stateFingerprintLines.pop_front();
                 }
-                lastBlockId = dbId;
-
-
-                BlockHeader bh(
-                    dbVersion,
-                    dbTimestamp,
-                    dbPreviousBlock ? *dbPreviousBlock : 0,
-                    dbNumberOfTransactions,
-                    dbTotalAmount,
-                    dbTotalFee,
-                    dbReward,
-                    dbPayloadLength,
-                    payloadHash,
-                    generatorPublicKey
-                );
-
-                BlockValidator::validate(BlockRow(bh, dbHeight, dbId, signature), settings);
-
-                Payload payload(blockToTransactions[dbId]);
-                if (payload.transactionCount() != bh.numberOfTransactions) {
-                    throw std::runtime_error(
-                                "transactions count mismatch in block at height " +
-                                std::to_string(dbHeight) + ". " +
-                                "Expected by block header: " + std::to_string(bh.numberOfTransactions) +
-                                " found: " + std::to_string(payload.transactionCount())
-                                );
+                stateFingerprints << block.height << " " << stateFingerprint.hex() << std::endl;
+            });
+            // Lines of rounds replaced by the node in follow mode are cut off again
+            replay.addRoundRolledBackCallback([&](height_t height) {
+                if (stateFingerprintLines.empty() || stateFingerprintLines.back().first != height) return;
+                const auto offset = stateFingerprintLines.back().second;
+                stateFingerprintLines.pop_back();
+                stateFingerprints.seekp(offset);
+                if (!stateFingerprints || truncate(options.stateFingerprints.c_str(), offset) != 0) {
+                    throw std::runtime_error("Could not remove round " + std::to_string(roundFromHeight(height)) +
+                                             " from " + options.stateFingerprints);
                 }
+            });
+        }
 
-                if (settings.exceptions.payloadHashMismatch.count(dbId) == 0) {
-                    auto calculatedPayloadHash = payload.hash();
-                    if (payloadHash != calculatedPayloadHash) {
-                        auto payloadSerialized = payload.serialize();
-                        std::cout << "Payload length calculated: " << payloadSerialized.size()
-                                  << " expected: " << bh.payloadLength << std::endl;
-                        // std::cout << "payload: " << bytes2Hex(payloadSerialized) << std::endl;
-
-                        for (auto &tws : blockToTransactions[dbId]) {
-                            auto transactionId = tws.transaction.id(tws.signature, tws.secondSignature);
-                            std::cout << "Payload transaction: " << tws.transaction << " " << transactionId << std::endl;
-                        }
-
-                        if (dbHeight == 1) {
-                            // warn only (https://github.com/LiskHQ/lisk/issues/2047)
-                            std::cout << "payload hash mismatch for block " << dbId << std::endl;
-                        } else {
-                            throw std::runtime_error("Payload hash mismatch in block id " + std::to_string(dbId) +
-                                                     " height " + std::to_string(dbHeight));
-                        }
-                    }
-                }
+        if (options.follow) {
+            const height_t journalDepth = Follow::JOURNAL_ROUNDS * 101;
+            replay.enableJournal(journalDepth, maxHeight > journalDepth ? maxHeight - journalDepth + 1 : 1);
+        }
 
-                for (auto &transactionRow : blockToTransactions[dbId]) {
-                    auto &t = transactionRow.transaction;
-
-                    // Validate transaction
-
-                    if (dbHeight == 1 && t.type != 0) {
-                        std::cout << "Transaction not verified: " << t << std::endl;
-                    } else if (settings.exceptions.invalidTransactionSignature.count(transactionRow.id)) {
-                        // skip
-                    } else {
-                        std::vector<unsigned char> secondSignatureRequiredBy;
-                        try {
-                            secondSignatureRequiredBy = blockchainState.addressSummaries.at(t.senderAddress).secondPubkey;
-                        } catch (std::out_of_range) {
-                        }
-                        TransactionValidator::validate(transactionRow, secondSignatureRequiredBy, settings.exceptions);
-                    }
-                }
+        std::string finalCheckpointPath;
+        if (!options.checkpointDir.empty()) {
+            enableCheckpoints(options, replay, maxHeight, finalCheckpointPath);
+        }
 
-                // Update state from block transactions
-                // This is done outside of the first transactions loop because second signatures are
-                // only required for later blocks (see e.g. https://explorer.lisk.io/block/3087130330171409946)
-                for (auto &transactionRow : blockToTransactions[dbId]) {
-                    if (settings.exceptions.inertTransactions.count(transactionRow.id) == 0) {
-                        blockchainState.applyTransaction(transactionRow);
-                    }
-
-                    if (settings.exceptions.balanceAdjustments.count(transactionRow.id)) {
-                        blockchainState.addressSummaries[transactionRow.transaction.senderAddress].balance += settings.exceptions.balanceAdjustments[transactionRow.id];
-                    }
-                }
-                BlockchainStateValidator::validate(blockchainState, settings);
-
-                blockchainState.applyBlock(bh, dbId);
-
-                roundFees += bh.totalFee;
-                roundDelegates[(dbHeight-1)%101] = addressFromPubkey(bh.generatorPublicKey);
-                roundRewards[(dbHeight-1)%101] = bh.reward;
-
-                bool isLast = (dbHeight%101 == 0);
-                //std::cout << "Block: " << id << " in round " << roundFromHeight(dbHeight) << " last: " << isLast << " reward: " << bh.reward << std::endl;
-
-
-                if (isLast) {
-                    auto roundNumber = roundFromHeight(dbHeight);
-                    if (settings.exceptions.rewardsFactor.count(roundNumber)) {
-                        int rewardsFactor = settings.exceptions.rewardsFactor.at(roundNumber);
-                        for (int i = 0; i < 101; ++i)
-                        {
-                            roundRewards[i] *= rewardsFactor;
-                        }
-                    }
-                    if (settings.exceptions.feesFactor.count(roundNumber)) {
-                        roundFees *= settings.exceptions.feesFactor.at(roundNumber);
-                    }
-                    if (settings.exceptions.feesBonus.count(roundNumber)) {
-                        roundFees += settings.exceptions.feesBonus.at(roundNumber);
-                    }
-
-                    auto feePerDelegate = roundFees/101;
-                    auto feeRemaining = roundFees - (101*feePerDelegate);
-
-                    for (int i = 0; i < 101; ++i)
-                    {
-                        blockchainState.addressSummaries[roundDelegates[i]].balance += roundRewards[i];
-                        blockchainState.addressSummaries[roundDelegates[i]].balance += feePerDelegate;
-                    }
-
-                    if (feeRemaining > 0) {
-                        // rest goes to the last delegate
-                        blockchainState.addressSummaries[roundDelegates[100]].balance += feeRemaining;
-                    }
-
-                    for (int i = 0; i < 101; ++i) {
-                        blockchainState.addressSummaries[roundDelegates[i]].lastBlockId = dbId;
-                    }
-
-                    roundFees = 0;
-                }
+        // Workers start checking while the coordinator reads the chain
+        auto workerCommands = options.workerCommands;
+        for (int i = 0; i < options.localWorkers; ++i) {
+            workerCommands.push_back(Distributed::localWorkerCommand(options));
+        }
+        std::unique_ptr<Distributed::Coordinator> coordinator;
+        std::unique_ptr<ParallelChecks> parallelChecks;
+        if (!workerCommands.empty()) {
+            coordinator.reset(new Distributed::Coordinator(workerCommands, network, fromHeight, maxHeight, options.workerRange));
+            replay.setDelegatedChecks([&coordinator](const BlockRow &block, const std::vector<TransactionRow> &transactions) {
+                return coordinator->checkedBlock(block, transactions);
+            });
+        } else if (pool.workerCount() > 0) {
+            parallelChecks.reset(new ParallelChecks(pool, replay, settings, signatureCache.get(), signatureSampling.get()));
+        }
 
-                if (dbHeight%1000 == 0) {
-                    auto now = std::chrono::steady_clock::now();
-                    times[dbHeight] = now;
-                    NumberLog().out() << "Done processing block at height " << dbHeight;
-                    const int benchmarkSpan = 10000;
-                    if (times.count(dbHeight-benchmarkSpan)) {
-                        auto diff = std::chrono::duration<float>(now - times[dbHeight-benchmarkSpan]).count();
-                        auto bps = benchmarkSpan / diff;
-                        std::cout << " (current speed " << std::fixed << std::setprecision(1) << bps  << " blocks/s)";
-                    }
-                    std::cout << std::endl;
-                }
-            }
+        const auto replayStart = std::chrono::steady_clock::now();
+        if (options.cacheDir.empty()) {
+            replayFromDatabase(db, settings, replay, parallelChecks.get(), pool, fromHeight);
+        } else {
+            replayFromChainCache(db, options, settings, replay, parallelChecks.get(), pool, fromHeight);
         }
+        // Blocks found by --follow are checked locally
+        std::uint64_t workerSignaturesVerified = 0;
+        std::uint64_t workerSignaturesSkipped = 0;
+        if (coordinator) {
+            coordinator->finish();
+            workerSignaturesVerified = coordinator->signaturesVerified();
+            workerSignaturesSkipped = coordinator->signaturesSkipped();
+            replay.setDelegatedChecks(nullptr);
+            coordinator.reset();
+        }
+        parallelChecks.reset();
+        metrics.network = networkName(network);
+        metrics.replayTime = std::chrono::steady_clock::now() - replayStart;
+        metrics.blocks = replay.position().height - fromHeight + 1;
+        metrics.transactions = replay.processedTransactions();
+
+        if (assetChecks) {
+            Profiler::Scope scope("waiting for table scans", Profiler::Traced); static_cast<void>(scope);
+            assetChecks->wait();
+        }
+
+        if (signatureCache) {
+            saveSignatureCache(*signatureCache);
+            signatureCache.reset();
+        }
+
+        // Heights are checked to be contiguous from 1 during replay
+        std::cout << "Blocks count " << replay.position().height << std::endl;
+        std::cout << "Height: " << replay.position().height << std::endl;
+
+        auto &blockchainState = replay.blockchainState();
 
         // validate after all blocks
-        BlockchainStateValidator::validate(blockchainState, settings);
+        BlockchainStateValidator::validate(blockchainState, settings, failures.get());
 
         blockchainState.addressSummaries.erase(TRASH);
-        Summaries::checkMemAccounts(db, blockchainState, settings);
+        try {
+            Summaries::checkMemAccounts(db, blockchainState, settings, pool);
+        } catch (const ValidationError &error) {
+            if (!failures) throw;
+            failures->record(error);
+        }
+
+        PerfCounters::print(std::cout, replay.position().height - fromHeight + 1, replay.processedTransactions());
+        pool.printStatistics(std::cout);
+        metrics.threadPool = pool.statistics();
 
         db.commit();
+
+        if (failures && !failures->empty()) {
+            failures->writeReport(options.failureReport);
+            finish("invalid");
+            return 1;
+        }
+
+        // With workers, the sampling happened there, with the settings of their commands
+        if (signatureSampling && workerCommands.empty()) {
+            std::cout << signatureSampling->summary() << std::endl;
+        }
+        if (workerSignaturesSkipped > 0) {
+            std::cout << "Sampled result: workers verified " << workerSignaturesVerified << " of "
+                      << (workerSignaturesVerified + workerSignaturesSkipped) << " transaction signatures." << std::endl;
+            std::cout << "Block signatures and second signatures were all verified." << std::endl;
+        }
+
+        // A sampled run does not establish trust
+        if (!finalCheckpointPath.empty() && !signatureSampling && workerSignaturesSkipped == 0) {
+            const auto trustedPath = Checkpoints::trustedFilePath(options.checkpointDir, network);
+            if (std::rename(finalCheckpointPath.c_str(), trustedPath.c_str()) != 0) {
+                throw std::runtime_error("Could not move checkpoint to " + trustedPath);
+            }
+            std::cout << "Trusted checkpoint: " << trustedPath << std::endl;
+        }
+
+        metricsFile = options.metricsFile;
+        finish("valid");
+
+        if (options.follow) {
+            Follow::run(dbConnection, settings, replay, options.followInterval, failures.get(), options.failureReport);
+        }
     }
     catch (const std::exception &e)
     {
         std::cerr << e.what() << std::endl;
+        finish("failed");
+
+        // Verifications done before the failure are still valid
+        if (signatureCache) {
+            try {
+                saveSignatureCache(*signatureCache);
+            } catch (const std::exception &saveError) {
+                std::cerr << saveError.what() << std::endl;
+            }
+        }
+
+        if (failures && !failures->empty()) {
+            try {
+                failures->writeReport(options.failureReport);
+            } catch (const std::exception &reportError) {
+                std::cerr << reportError.what() << std::endl;
+            }
+        }
         return 1;
     }
 
@@ -453,6 +677,23 @@ int run(std::vector<std::string> args)
 }
 
 int main(int argc, char* argv[]) {
+    AsyncConsole console; static_cast<void>(console);
     std::vector<std::string> args(argv, argv + argc);
-    return run(args);
+    const auto start = std::chrono::steady_clock::now();
+    RunMetrics metrics;
+    std::string metricsFile;
+    auto result = run(args, metrics, metricsFile);
+    Profiler::finishTrace();
+    // Written here so that the stages include the overall runtime
+    if (result == 0 && !metricsFile.empty()) {
+        metrics.totalTime = std::chrono::steady_clock::now() - start;
+        try {
+            metrics.write(metricsFile);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            result = 1;
+        }
+    }
+    Profiler::print(std::cout);
+    return result;
 }
@@ -0,0 +1,154 @@
+#include "options.h"
+
+#include <stdexcept>
+
+namespace {
+
+std::string takeValue(const std::vector<std::string> &args, std::size_t &index)
+{
+    if (index + 1 >= args.size()) {
+        throw std::runtime_error("Missing value for option " + args[index]);
+    }
+    return args[++index];
+}
+
+int takeInt(const std::vector<std::string> &args, std::size_t &index)
+{
+    const auto &option = args[index];
+    const auto value = takeValue(args, index);
+    std::size_t parsed = 0;
+    int out;
+    try {
+        out = std::stoi(value, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (parsed != value.size() || out <= 0) {
+        throw std::runtime_error("Expected a positive number for option " + option + ", got '" + value + "'");
+    }
+    return out;
+}
+
+double takeFraction(const std::vector<std::string> &args, std::size_t &index)
+{
+    const auto &option = args[index];
+    const auto value = takeValue(args, index);
+    std::size_t parsed = 0;
+    double out;
+    try {
+        out = std::stod(value, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (parsed != value.size() || !(out > 0 && out <= 1)) {
+        throw std::runtime_error("Expected a number in (0, 1] for option " + option + ", got '" + value + "'");
+    }
+    return out;
+}
+
+std::uint64_t takeUnsigned(const std::vector<std::string> &args, std::size_t &index)
+{
+    const auto &option = args[index];
+    const auto value = takeValue(args, index);
+    std::size_t parsed = 0;
+    std::uint64_t out;
+    try {
+        out = std::stoull(value, &parsed);
+    } catch (const std::exception &) {
+        parsed = 0;
+    }
+    if (parsed != value.size() || value.empty() || value[0] == '-') {
+        throw std::runtime_error("Expected an unsigned number for option " + option + ", got '" + value + "'");
+    }
+    return out;
+}
+
+}
+
+Options parseOptions(const std::vector<std::string> &args)
+{
+    Options out;
+    std::vector<std::string> positional;
+
+    for (std::size_t index = 1; index < args.size(); ++index)
+    {
+        const auto &arg = args[index];
+        if (arg == "--cache-dir") {
+            out.cacheDir = takeValue(args, index);
+        } else if (arg == "--checkpoint-dir") {
+            out.checkpointDir = takeValue(args, index);
+        } else if (arg == "--checkpoint-interval") {
+            out.checkpointInterval = takeInt(args, index);
+        } else if (arg == "--resume-from") {
+            out.resumeFrom = takeValue(args, index);
+        } else if (arg == "--signature-cache") {
+            out.signatureCache = takeValue(args, index);
+        } else if (arg == "--state-fingerprints") {
+            out.stateFingerprints = takeValue(args, index);
+        } else if (arg == "--follow") {
+            out.follow = true;
+        } else if (arg == "--follow-interval") {
+            out.followInterval = takeInt(args, index);
+        } else if (arg == "--sql-integrity-checks") {
+            out.sqlIntegrityChecks = true;
+        } else if (arg == "--check-invariants-per-round") {
+            out.invariantChecksPerRound = true;
+        } else if (arg == "--max-failures") {
+            out.maxFailures = takeInt(args, index);
+        } else if (arg == "--failure-report") {
+            out.failureReport = takeValue(args, index);
+        } else if (arg == "--sample-signatures") {
+            out.sampleSignatures = takeFraction(args, index);
+        } else if (arg == "--sample-seed") {
+            out.sampleSeed = takeUnsigned(args, index);
+        } else if (arg == "--headers-only") {
+            out.headersOnly = true;
+        } else if (arg == "--trace-address") {
+            out.traceAddress = takeValue(args, index);
+        } else if (arg == "--trace-file") {
+            out.traceFile = takeValue(args, index);
+        } else if (arg == "--progress-socket") {
+            out.progressSocket = takeValue(args, index);
+        } else if (arg == "--progress-fd") {
+            out.progressFd = takeInt(args, index);
+        } else if (arg == "--perf-counters") {
+            out.perfCounters = true;
+        } else if (arg == "--metrics-file") {
+            out.metricsFile = takeValue(args, index);
+        } else if (arg == "--worker") {
+            out.worker = true;
+        } else if (arg == "--worker-command") {
+            out.workerCommands.push_back(takeValue(args, index));
+        } else if (arg == "--local-workers") {
+            out.localWorkers = takeInt(args, index);
+        } else if (arg == "--worker-range") {
+            out.workerRange = takeInt(args, index);
+        } else if (arg == "--threads") {
+            out.threads = takeInt(args, index);
+        } else if (arg == "--pin-threads") {
+            out.pinThreads = true;
+        } else if (arg == "--incremental-from") {
+            out.resumeFrom = takeValue(args, index);
+            out.verifyPrefix = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            throw std::runtime_error("Unknown option: " + arg);
+        } else {
+            positional.push_back(arg);
+        }
+    }
+
+    if (positional.size() != 2) {
+        throw std::runtime_error("Expected network and database name");
+    }
+
+    if (out.worker && (!out.workerCommands.empty() || out.localWorkers > 0)) {
+        throw std::runtime_error("A worker cannot start workers itself");
+    }
+    if (out.worker && (out.follow || out.headersOnly || !out.traceAddress.empty() || !out.resumeFrom.empty())) {
+        throw std::runtime_error("--worker only takes options for reading and checking blocks");
+    }
+
+    out.network = networkFromName(positional[0]);
+    out.databaseName = positional[1];
+    return out;
+}
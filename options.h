@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "settings.h"
+
+struct Options {
+    Network network;
+    std::string databaseName;
+    std::string cacheDir; // empty: read chain data from database
+    std::string checkpointDir; // empty: no checkpoints
+    int checkpointInterval = 1000; // in rounds
+    std::string resumeFrom; // checkpoint file
+    std::string signatureCache; // empty: verify all signatures
+    std::string stateFingerprints; // empty: no state fingerprints
+    bool verifyPrefix = false; // compare all block IDs up to the checkpoint height when resuming
+    bool follow = false;
+    int followInterval = 10; // in seconds
+    bool sqlIntegrityChecks = false;
+    bool invariantChecksPerRound = false;
+    int maxFailures = 0; // 0: stop at the first failure
+    std::string failureReport = "failures.json";
+    double sampleSignatures = 1; // fraction of transaction signatures to verify
+    std::uint64_t sampleSeed = 0;
+    bool headersOnly = false;
+    std::string traceAddress; // empty: validate the whole chain
+    std::string traceFile; // empty: no timeline
+    std::string progressSocket; // empty: no progress feed on a socket
+    int progressFd = -1; // -1: no progress feed on a file descriptor
+    bool perfCounters = false;
+    std::string metricsFile; // empty: no run metrics
+    bool worker = false; // serve stateless checks of height ranges on stdin/stdout
+    std::vector<std::string> workerCommands; // shell commands starting a worker each
+    int localWorkers = 0; // additional workers running this binary on the same database
+    int workerRange = 10000; // blocks per request to a worker
+    int threads = 0; // 0: one per hardware thread
+    bool pinThreads = false; // bind every thread of the pool to a CPU of its own
+};
+
+// Throws std::runtime_error for invalid command lines
+Options parseOptions(const std::vector<std::string> &args);
@@ -0,0 +1,80 @@
+#include "parallel_checks.h"
+
+#include <atomic>
+#include <utility>
+
+#include "profiler.h"
+#include "stateless_checks.h"
+
+const std::size_t ParallelChecks::LOOKAHEAD_BLOCKS;
+
+namespace {
+
+std::atomic<std::size_t> queued{0};
+
+}
+
+ParallelChecks::Entry::Entry(ThreadPool &pool, const BlockRow &block, std::vector<TransactionRow> transactions)
+    : block(block)
+    , transactions(std::move(transactions))
+    , checks(pool)
+{
+}
+
+ParallelChecks::ParallelChecks(ThreadPool &pool, Replay &replay, const Settings &settings,
+                               SignatureCache *signatureCache, SignatureSampling *sampling)
+    : pool_(pool)
+    , replay_(replay)
+    , settings_(settings)
+    , signatureCache_(signatureCache)
+    , sampling_(sampling)
+{
+    // The replay asks for the failures of the block replayOldest() passes to it
+    replay_.setDelegatedChecks([this](const BlockRow &, const std::vector<TransactionRow> &) {
+        return std::move(entries_.front()->failures);
+    });
+}
+
+ParallelChecks::~ParallelChecks()
+{
+    replay_.setDelegatedChecks(nullptr);
+    queued -= entries_.size();
+}
+
+void ParallelChecks::add(const BlockRow &block, std::vector<TransactionRow> transactions)
+{
+    entries_.emplace_back(new Entry(pool_, block, std::move(transactions)));
+    ++queued;
+    auto &entry = *entries_.back();
+    entry.checks.run([this, &entry]() {
+        StatelessChecks::run(entry.block, entry.transactions, settings_, signatureCache_, sampling_, entry.failures);
+    });
+
+    if (entries_.size() > LOOKAHEAD_BLOCKS) {
+        replayOldest();
+    }
+}
+
+void ParallelChecks::flush()
+{
+    while (!entries_.empty()) {
+        replayOldest();
+    }
+}
+
+void ParallelChecks::replayOldest()
+{
+    auto &entry = *entries_.front();
+    {
+        Profiler::Scope scope("waiting for checks", Profiler::Traced); static_cast<void>(scope);
+        entry.checks.wait();
+    }
+    replay_.processBlock(entry.block, entry.transactions);
+    entries_.pop_front();
+    --queued;
+}
+
+std::size_t ParallelChecks::queuedBlocks()
+{
+    return queued;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "block.h"
+#include "failure_collector.h"
+#include "replay.h"
+#include "settings.h"
+#include "signature_cache.h"
+#include "signature_sampling.h"
+#include "thread_pool.h"
+#include "transaction.h"
+
+// Runs the stateless checks (see StatelessChecks) of the next blocks on a thread pool while the
+// replay applies the blocks before them. Blocks are replayed in the order they are added, with
+// the same failures as a sequential replay.
+class ParallelChecks {
+public:
+    // Takes over the delegated checks of replay until destruction
+    ParallelChecks(ThreadPool &pool, Replay &replay, const Settings &settings,
+                   SignatureCache *signatureCache, SignatureSampling *sampling);
+    // Drops blocks not replayed yet, e.g. after a failure
+    ~ParallelChecks();
+
+    ParallelChecks(const ParallelChecks &) = delete;
+    ParallelChecks &operator=(const ParallelChecks &) = delete;
+
+    // Starts checking block and replays the oldest block once enough blocks are ahead
+    void add(const BlockRow &block, std::vector<TransactionRow> transactions);
+    // Replays all added blocks
+    void flush();
+
+    // Blocks added but not replayed yet, over all instances. Can be called from any thread.
+    static std::size_t queuedBlocks();
+
+private:
+    struct Entry {
+        Entry(ThreadPool &pool, const BlockRow &block, std::vector<TransactionRow> transactions);
+
+        BlockRow block;
+        std::vector<TransactionRow> transactions;
+        std::vector<FailureRecord> failures;
+        // Last, so that the checks are waited for before the data they use is destroyed
+        ThreadPool::Group checks;
+    };
+
+    void replayOldest();
+
+    // Blocks checked ahead of the replay. Enough to keep all workers busy, few enough not to
+    // hold much memory.
+    static const std::size_t LOOKAHEAD_BLOCKS = 512;
+
+    ThreadPool &pool_;
+    Replay &replay_;
+    const Settings &settings_;
+    SignatureCache *signatureCache_;
+    SignatureSampling *sampling_;
+    std::deque<std::unique_ptr<Entry>> entries_;
+};
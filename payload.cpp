@@ -1,5 +1,7 @@
 #include "payload.h"
 
+#include <algorithm>
+
 #include "sodium.h"
 
 Payload::Payload(std::vector<TransactionRow> transactions)
@@ -26,20 +28,37 @@ std::vector<Transaction> Payload::transactions() const
 
 std::vector<unsigned char> Payload::serialize() const
 {
-    std::vector<unsigned char> out;
+    std::size_t size = 0;
+    for (const auto &tws : transactions_) {
+        size += tws.transaction.serializedSize() + tws.signature.size() + tws.secondSignature.size();
+    }
+
+    std::vector<unsigned char> out(size);
+    auto *position = out.data();
     for (const auto &tws : transactions_) {
-        auto serializedTransaction = tws.transaction.serialize();
-        out.insert(out.end(), serializedTransaction.begin(), serializedTransaction.end());
-        out.insert(out.end(), tws.signature.begin(), tws.signature.end());
-        out.insert(out.end(), tws.secondSignature.begin(), tws.secondSignature.end());
+        tws.transaction.serialize(position);
+        position += tws.transaction.serializedSize();
+        position = std::copy(tws.signature.begin(), tws.signature.end(), position);
+        position = std::copy(tws.secondSignature.begin(), tws.secondSignature.end(), position);
     }
     return out;
 }
 
 std::vector<unsigned char> Payload::hash() const
 {
+    crypto_hash_sha256_state state;
+    crypto_hash_sha256_init(&state);
+    for (const auto &tws : transactions_) {
+        unsigned char prefix[Transaction::PrefixLayout::size];
+        tws.transaction.serializePrefix(prefix);
+        crypto_hash_sha256_update(&state, prefix, sizeof(prefix));
+        const auto &assetData = tws.transaction.assetData;
+        crypto_hash_sha256_update(&state, assetData.data(), assetData.size());
+        crypto_hash_sha256_update(&state, tws.signature.data(), tws.signature.size());
+        crypto_hash_sha256_update(&state, tws.secondSignature.data(), tws.secondSignature.size());
+    }
+
     auto out = std::vector<unsigned char>(crypto_hash_sha256_BYTES);
-    auto message = serialize();
-    crypto_hash_sha256(out.data(), message.data(), message.size());
+    crypto_hash_sha256_final(&state, out.data());
     return out;
 }
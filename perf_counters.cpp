@@ -0,0 +1,208 @@
+#include "perf_counters.h"
+
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+enum Event { Cycles, Instructions, L1dMisses, LlcMisses, BranchMisses, EVENT_COUNT };
+
+const char *const EVENT_NAMES[EVENT_COUNT] = {
+    "cycles", "instructions", "L1d misses", "LLC misses", "branch misses",
+};
+
+using values_t = std::array<double, EVENT_COUNT>;
+
+struct Reading {
+    std::uint64_t enabled = 0; // time the group was enabled, in ns
+    std::uint64_t running = 0; // time it was on the PMU; less when multiplexed
+    std::array<std::uint64_t, EVENT_COUNT> values {};
+};
+
+struct StageTotals {
+    explicit StageTotals(const char *name) : name(name) {}
+
+    const char *name;
+    values_t values {};
+    Reading start; // of the currently running pass
+    int depth = 0; // passes running; only the outermost is counted
+};
+
+bool available = false;
+// Whether threads started after enable() are counted too; not supported by older kernels
+bool inherited = false;
+// Set on the thread that opened the counters; stages and their totals belong to it alone
+thread_local bool countingThread = false;
+int leaderFd = -1;
+// Position of each event in the group read, -1 if the event could not be opened
+std::array<int, EVENT_COUNT> position;
+int openedCount = 0;
+std::vector<StageTotals> stages;
+
+int openEvent(std::uint32_t type, std::uint64_t config, int groupFd, bool inherit)
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = inherit ? 1 : 0;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+
+std::uint64_t cacheMissConfig(std::uint64_t cache)
+{
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+bool read(Reading &reading)
+{
+    // nr, time enabled, time running, then one value per opened event
+    std::array<std::uint64_t, 3 + EVENT_COUNT> buffer;
+    const auto size = static_cast<ssize_t>((3 + openedCount) * sizeof(std::uint64_t));
+    if (::read(leaderFd, buffer.data(), size) != size) return false;
+    reading.enabled = buffer[1];
+    reading.running = buffer[2];
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+        reading.values[event] = position[event] >= 0 ? buffer[3 + position[event]] : 0;
+    }
+    return true;
+}
+
+}
+
+void PerfCounters::enable()
+{
+    if (available) return;
+
+    position.fill(-1);
+    // Counting the threads started later, e.g. the thread pool, needs group reads of inherited
+    // events, which older kernels reject; without them only the calling thread is counted
+    inherited = true;
+    leaderFd = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, true);
+    if (leaderFd == -1 && errno == EINVAL) {
+        inherited = false;
+        leaderFd = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, false);
+    }
+    if (leaderFd == -1) {
+        std::cout << "Performance counters not available (" << std::strerror(errno) << ")" << std::endl;
+        return;
+    }
+    position[Cycles] = openedCount++;
+
+    const std::pair<Event, std::pair<std::uint32_t, std::uint64_t>> members[] = {
+        {Instructions, {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}},
+        {L1dMisses, {PERF_TYPE_HW_CACHE, cacheMissConfig(PERF_COUNT_HW_CACHE_L1D)}},
+        {LlcMisses, {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES}},
+        {BranchMisses, {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES}},
+    };
+    for (const auto &member : members) {
+        // Events missing on this CPU are left out of the group and reported as unavailable
+        if (openEvent(member.second.first, member.second.second, leaderFd, inherited) != -1) {
+            position[member.first] = openedCount++;
+        }
+    }
+
+    ioctl(leaderFd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    if (ioctl(leaderFd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) == -1) {
+        std::cout << "Performance counters not available (" << std::strerror(errno) << ")" << std::endl;
+        return;
+    }
+    available = true;
+    countingThread = true;
+}
+
+bool PerfCounters::enabled()
+{
+    return available;
+}
+
+PerfCounters::Stage::Stage(const char *name)
+{
+    if (!countingThread) return;
+
+    std::size_t index = 0;
+    while (index < stages.size() && stages[index].name != name) ++index;
+    if (index == stages.size()) {
+        stages.emplace_back(name);
+    }
+
+    index_ = static_cast<int>(index);
+    auto &stage = stages[index];
+    counting_ = stage.depth++ == 0 && read(stage.start);
+}
+
+PerfCounters::Stage::~Stage()
+{
+    if (index_ < 0) return;
+
+    auto &stage = stages[static_cast<std::size_t>(index_)];
+    stage.depth--;
+    if (!counting_) return;
+
+    Reading end;
+    if (!read(end)) return;
+
+    // Scale to the whole interval if the group was multiplexed with other users of the PMU
+    const auto running = end.running - stage.start.running;
+    const auto scale = running > 0 ? static_cast<double>(end.enabled - stage.start.enabled) / running : 1.0;
+    for (int event = 0; event < EVENT_COUNT; ++event) {
+        stage.values[event] += scale * (end.values[event] - stage.start.values[event]);
+    }
+}
+
+void PerfCounters::print(std::ostream &out, std::uint64_t blocks, std::uint64_t transactions)
+{
+    if (!available || stages.empty()) return;
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    if (inherited) {
+        out << "Performance counters (user space, all threads started since the counters were opened):" << std::endl;
+    } else {
+        out << "Performance counters (user space, main thread only, without the work of the thread pool;"
+            << " use --threads 1 to include it):" << std::endl;
+    }
+    for (const auto &stage : stages) {
+        const auto &values = stage.values;
+        out << "  " << stage.name << ": " << std::fixed << std::setprecision(0) << values[Cycles] << " cycles";
+        if (position[Instructions] >= 0 && values[Cycles] > 0) {
+            out << ", IPC " << std::fixed << std::setprecision(2) << values[Instructions] / values[Cycles];
+        }
+        out << std::endl;
+
+        const std::pair<const char *, std::uint64_t> units[] = {{"block", blocks}, {"transaction", transactions}};
+        for (const auto &unit : units) {
+            if (unit.second == 0) continue;
+            out << "    per " << unit.first << ":";
+            for (int event = 0; event < EVENT_COUNT; ++event) {
+                out << (event ? ", " : " ");
+                if (position[event] < 0) {
+                    out << "n/a ";
+                } else {
+                    out << std::fixed << std::setprecision(values[event] / unit.second < 100 ? 2 : 0)
+                        << values[event] / unit.second << " ";
+                }
+                out << EVENT_NAMES[event];
+            }
+            out << std::endl;
+        }
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+
+// Hardware performance counters, accumulated per stage: cycles, instructions, L1 data cache
+// read misses, last level cache misses and branch misses, counted in user space only. Without
+// enable() or without kernel support, stages do nothing. Stages on other threads do nothing either.
+// Threads started after enable(), e.g. the thread pool, are counted during the stages of the
+// enabling thread, so work a stage hands to the pool is part of its counts. Kernels that cannot
+// read inherited groups count the enabling thread alone, which print() says.
+//
+//     PerfCounters::Stage perfStage("state application"); static_cast<void>(perfStage);
+//
+// Reading the counters costs two system calls per stage, so stages should not be finer than a block.
+class PerfCounters {
+public:
+    // Opens the counters for the calling thread and the threads it starts later, so call it
+    // before creating the thread pool. Prints a note and stays disabled if they
+    // are not available, e.g. in a container or with a restrictive perf_event_paranoid.
+    static void enable();
+    static bool enabled();
+
+    class Stage {
+    public:
+        // name must stay valid, e.g. a string literal. Counts only on the thread that called enable().
+        explicit Stage(const char *name);
+        ~Stage();
+
+        Stage(const Stage &) = delete;
+        Stage &operator=(const Stage &) = delete;
+
+    private:
+        int index_ = -1; // -1: counters not available
+        bool counting_ = false; // false for a nested pass of a running stage
+    };
+
+    // Totals per stage with IPC, and costs per block and per transaction
+    static void print(std::ostream &out, std::uint64_t blocks, std::uint64_t transactions);
+};
@@ -0,0 +1,305 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdexcept>
+
+#include "utils.h"
+
+namespace {
+
+struct TraceEvent {
+    const Profiler::Node *node;
+    std::chrono::steady_clock::time_point start;
+    std::chrono::steady_clock::duration duration;
+};
+
+struct ThreadData {
+    explicit ThreadData(unsigned index)
+        : root(new Profiler::Node("", nullptr, nullptr))
+        , index(index)
+    {}
+
+    std::unique_ptr<Profiler::Node> root;
+    unsigned index; // in order of the first stage entered
+    std::vector<TraceEvent> events; // not yet written to the trace file
+};
+
+std::mutex threadsMutex;
+// Owned here so that the trees of finished threads can still be printed
+std::vector<std::unique_ptr<ThreadData>> threads;
+
+std::mutex latenciesMutex;
+std::vector<float> blockLatencies; // in microseconds
+
+thread_local ThreadData *currentThread = nullptr;
+thread_local Profiler::Node *current = nullptr;
+
+Profiler::Node *threadRoot()
+{
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    threads.emplace_back(new ThreadData(static_cast<unsigned>(threads.size())));
+    currentThread = threads.back().get();
+    return currentThread->root.get();
+}
+
+#ifdef SNAPSHOT_VALIDATOR_TRACING
+// Spans are buffered per thread and written in chunks, so that long runs need little memory
+const std::size_t TRACE_CHUNK = 4096;
+
+std::atomic<bool> tracing(false);
+std::mutex traceMutex;
+std::ofstream traceFile;
+std::chrono::steady_clock::time_point traceStart;
+
+double toTraceUs(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// Caller holds traceMutex
+void writeTraceEvents(ThreadData &thread)
+{
+    for (const auto &event : thread.events) {
+        traceFile << ",\n{\"name\":";
+        traceFile << jsonString(event.node->name);
+        traceFile << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread.index
+                  << ",\"ts\":" << toTraceUs(event.start - traceStart)
+                  << ",\"dur\":" << toTraceUs(event.duration) << "}";
+    }
+    thread.events.clear();
+}
+
+void recordTraceEvent(const Profiler::Node *node, std::chrono::steady_clock::time_point start,
+                      std::chrono::steady_clock::duration duration)
+{
+    auto &thread = *currentThread;
+    thread.events.push_back(TraceEvent{node, start, duration});
+    if (thread.events.size() >= TRACE_CHUNK) {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        if (traceFile.is_open()) writeTraceEvents(thread);
+    }
+}
+#endif
+
+struct MergedNode {
+    std::string name;
+    std::uint64_t calls = 0;
+    std::chrono::steady_clock::duration total {};
+    std::vector<std::unique_ptr<MergedNode>> children; // in order of first appearance
+};
+
+void merge(MergedNode &into, const Profiler::Node &node)
+{
+    for (const auto &child : node.children) {
+        auto merged = std::find_if(into.children.begin(), into.children.end(), [&](const std::unique_ptr<MergedNode> &candidate) {
+            return candidate->name == child->name;
+        });
+        if (merged == into.children.end()) {
+            into.children.emplace_back(new MergedNode());
+            into.children.back()->name = child->name;
+            merged = into.children.end() - 1;
+        }
+        (*merged)->calls += child->calls;
+        (*merged)->total += child->total;
+        merge(**merged, *child);
+    }
+}
+
+void flatten(std::vector<Profiler::StageTotal> &out, const MergedNode &node, const std::string &prefix)
+{
+    for (const auto &child : node.children) {
+        const auto path = prefix + child->name;
+        out.push_back(Profiler::StageTotal{path, child->calls, child->total});
+        flatten(out, *child, path + "/");
+    }
+}
+
+MergedNode mergeThreads()
+{
+    MergedNode merged;
+    std::lock_guard<std::mutex> lock(threadsMutex);
+    for (const auto &thread : threads) {
+        merge(merged, *thread->root);
+    }
+    return merged;
+}
+
+double toMs(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void printNode(std::ostream &out, const MergedNode &node, int depth)
+{
+    for (const auto &pointer : node.children) {
+        const auto &child = *pointer;
+        out << std::string(2 * depth, ' ') << std::left << std::setw(std::max(1, 40 - 2 * depth)) << child.name
+            << std::right << std::setw(12) << std::fixed << std::setprecision(0) << toMs(child.total) << " ms";
+        if (node.total.count() > 0) {
+            out << std::setw(7) << std::setprecision(1) << 100.0 * child.total.count() / node.total.count() << "%";
+        } else {
+            out << "        ";
+        }
+        out << std::setw(12) << child.calls << " calls" << std::endl;
+        printNode(out, child, depth + 1);
+    }
+}
+
+}
+
+Profiler::Node::Node(const std::string &name, const char *key, Node *parent)
+    : key(key)
+    , name(name)
+    , parent(parent)
+{
+}
+
+Profiler::Node *Profiler::Node::child(const char *name)
+{
+    for (const auto &child : children) {
+        if (child->key == name) return child.get();
+    }
+    for (const auto &child : children) {
+        if (child->name == name) {
+            child->key = name;
+            return child.get();
+        }
+    }
+    children.emplace_back(new Node(name, name, this));
+    return children.back().get();
+}
+
+Profiler::Node *Profiler::Node::child(const std::string &name)
+{
+    for (const auto &child : children) {
+        if (child->name == name) return child.get();
+    }
+    children.emplace_back(new Node(name, nullptr, this));
+    return children.back().get();
+}
+
+Profiler::Scope::Scope(const char *name, TraceMode mode)
+{
+    if (!current) current = threadRoot();
+    start(current->child(name), mode);
+}
+
+Profiler::Scope::Scope(const std::string &name, TraceMode mode)
+{
+    if (!current) current = threadRoot();
+    start(current->child(name), mode);
+}
+
+void Profiler::Scope::start(Node *node, TraceMode mode)
+{
+    node_ = node;
+    traced_ = mode == Traced;
+    current = node_;
+    start_ = std::chrono::steady_clock::now();
+}
+
+Profiler::Scope::~Scope()
+{
+    const auto duration = std::chrono::steady_clock::now() - start_;
+    node_->total += duration;
+    node_->calls += 1;
+    current = node_->parent;
+#ifdef SNAPSHOT_VALIDATOR_TRACING
+    if (traced_ && tracing.load(std::memory_order_relaxed)) {
+        recordTraceEvent(node_, start_, duration);
+    }
+#endif
+}
+
+void Profiler::recordBlockLatency(std::chrono::steady_clock::duration latency)
+{
+    std::lock_guard<std::mutex> lock(latenciesMutex);
+    blockLatencies.push_back(std::chrono::duration<float, std::micro>(latency).count());
+}
+
+void Profiler::print(std::ostream &out)
+{
+    auto merged = mergeThreads();
+    if (merged.children.empty()) return;
+    for (const auto &child : merged.children) {
+        merged.total += child->total;
+    }
+
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    out << "Profile (wall time summed over threads, share of parent stage):" << std::endl;
+    printNode(out, merged, 1);
+
+    std::lock_guard<std::mutex> lock(latenciesMutex);
+    if (!blockLatencies.empty()) {
+        auto latencies = blockLatencies;
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&](double p) {
+            return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(p * latencies.size()))];
+        };
+        out << "Block latency (" << latencies.size() << " blocks): " << std::fixed << std::setprecision(1)
+            << "p50 " << percentile(0.5) << " us, "
+            << "p90 " << percentile(0.9) << " us, "
+            << "p99 " << percentile(0.99) << " us, "
+            << "p99.9 " << percentile(0.999) << " us, "
+            << "max " << latencies.back() << " us" << std::endl;
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+std::vector<Profiler::StageTotal> Profiler::stageTotals()
+{
+    std::vector<StageTotal> out;
+    flatten(out, mergeThreads(), "");
+    return out;
+}
+
+void Profiler::startTrace(const std::string &path)
+{
+#ifdef SNAPSHOT_VALIDATOR_TRACING
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceFile.open(path, std::ios::out | std::ios::trunc);
+    if (!traceFile) {
+        throw std::runtime_error("Could not open trace file " + path);
+    }
+    traceFile << std::fixed << std::setprecision(3);
+    traceFile << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+              << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"snapshot-validator\"}}";
+    traceStart = std::chrono::steady_clock::now();
+    tracing = true;
+#else
+    static_cast<void>(path);
+    throw std::runtime_error("Tracing is not supported by this build (SNAPSHOT_VALIDATOR_TRACING is off)");
+#endif
+}
+
+void Profiler::finishTrace()
+{
+#ifdef SNAPSHOT_VALIDATOR_TRACING
+    tracing = false;
+    std::lock_guard<std::mutex> threadsLock(threadsMutex);
+    std::lock_guard<std::mutex> lock(traceMutex);
+    if (!traceFile.is_open()) return;
+
+    for (const auto &thread : threads) {
+        writeTraceEvents(*thread);
+        traceFile << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->index
+                  << ",\"args\":{\"name\":\""
+                  << (thread->index == 0 ? "main" : "worker " + std::to_string(thread->index)) << "\"}}";
+    }
+    traceFile << "\n]}\n";
+    traceFile.close();
+    if (!traceFile) {
+        std::cerr << "Could not write trace file" << std::endl;
+    }
+#endif
+}
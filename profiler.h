@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Hierarchical wall time profile of nested stages. Every thread accumulates into its own tree
+// without locking; print() merges the trees of all threads by stage path.
+//
+//     Profiler::Scope scope("state application"); static_cast<void>(scope);
+//
+// Stage names are compared by pointer first, so string literals are cheapest.
+//
+// Coarse stages can additionally be traced: with a trace started, every pass through such a
+// stage becomes a span in a Chrome trace event file, which chrome://tracing and Perfetto show
+// as a timeline per thread. Building without SNAPSHOT_VALIDATOR_TRACING removes the recording.
+class Profiler {
+public:
+    enum TraceMode { NotTraced, Traced };
+
+    struct Node {
+        Node(const std::string &name, const char *key, Node *parent);
+
+        // Finds or creates the child stage. A name given as pointer must stay valid.
+        Node *child(const char *name);
+        Node *child(const std::string &name);
+
+        const char *key; // pointer to the name used for this stage, if it stays valid
+        std::string name;
+        Node *parent;
+        std::uint64_t calls = 0;
+        std::chrono::steady_clock::duration total {};
+        std::vector<std::unique_ptr<Node>> children;
+    };
+
+    class Scope {
+    public:
+        // name must stay valid, e.g. a string literal
+        explicit Scope(const char *name, TraceMode mode = NotTraced);
+        // slower, for names built at runtime
+        explicit Scope(const std::string &name, TraceMode mode = NotTraced);
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        void start(Node *node, TraceMode mode);
+
+        Node *node_;
+        std::chrono::steady_clock::time_point start_;
+        bool traced_;
+    };
+
+    // Total of one stage over all threads; path joins the names of the enclosing stages with '/'
+    struct StageTotal {
+        std::string path;
+        std::uint64_t calls;
+        std::chrono::steady_clock::duration total;
+    };
+
+    // Processing time of one block, for the latency percentiles in print()
+    static void recordBlockLatency(std::chrono::steady_clock::duration latency);
+
+    // Tree of all stages with total time, share of the parent stage and number of calls,
+    // followed by block latency percentiles. Threads must have finished their scopes.
+    static void print(std::ostream &out);
+    // The stages of print() in the same order. Threads must have finished their scopes.
+    static std::vector<StageTotal> stageTotals();
+
+    // Starts recording the traced stages of all threads into a trace event file at path.
+    // Throws std::runtime_error if the file cannot be opened or tracing is not compiled in.
+    static void startTrace(const std::string &path);
+    // Writes the remaining spans and closes the file. Threads must have finished their scopes.
+    static void finishTrace();
+};
@@ -0,0 +1,214 @@
+#include "progress_feed.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "log.h"
+#include "parallel_checks.h"
+#include "scopedbenchmark.h"
+#include "utils.h"
+
+namespace {
+
+const double WINDOW_SHORT = 10; // in seconds
+const double WINDOW_LONG = 60;
+
+std::uint64_t residentBytes()
+{
+    std::ifstream statm("/proc/self/statm");
+    std::uint64_t size = 0;
+    std::uint64_t resident = 0;
+    if (!(statm >> size >> resident)) return 0;
+    return resident * static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+}
+
+std::string systemError(const std::string &message)
+{
+    return message + ": " + std::strerror(errno);
+}
+
+}
+
+std::unique_ptr<ProgressFeed> ProgressFeed::toFileDescriptor(int fd)
+{
+    if (fcntl(fd, F_GETFD) == -1) {
+        throw std::runtime_error(systemError("Progress file descriptor " + std::to_string(fd) + " is not open"));
+    }
+    return std::unique_ptr<ProgressFeed>(new ProgressFeed(fd, -1, ""));
+}
+
+std::unique_ptr<ProgressFeed> ProgressFeed::onSocket(const std::string &path)
+{
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Progress socket path is too long: " + path);
+    }
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+    const int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd == -1) {
+        throw std::runtime_error(systemError("Could not create progress socket"));
+    }
+    unlink(path.c_str());
+    if (bind(listenFd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) == -1
+            || listen(listenFd, 8) == -1
+            || fcntl(listenFd, F_SETFL, fcntl(listenFd, F_GETFL) | O_NONBLOCK) == -1) {
+        const auto error = systemError("Could not listen on progress socket " + path);
+        close(listenFd);
+        throw std::runtime_error(error);
+    }
+    return std::unique_ptr<ProgressFeed>(new ProgressFeed(-1, listenFd, path));
+}
+
+ProgressFeed::ProgressFeed(int fd, int listenFd, const std::string &socketPath)
+    : listenFd_(listenFd)
+    , socketPath_(socketPath)
+    , start_(std::chrono::steady_clock::now())
+{
+    if (fd != -1) clients_.push_back(fd);
+    writer_ = std::thread([this]() { writeLoop(); });
+}
+
+ProgressFeed::~ProgressFeed()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    stop_.notify_all();
+    writer_.join();
+
+    // A file descriptor passed in belongs to the caller
+    if (listenFd_ != -1) {
+        for (int client : clients_) close(client);
+        close(listenFd_);
+        unlink(socketPath_.c_str());
+    }
+}
+
+void ProgressFeed::setTargetHeight(height_t height)
+{
+    targetHeight_.store(height, std::memory_order_relaxed);
+}
+
+void ProgressFeed::finish(const std::string &status)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = status;
+}
+
+void ProgressFeed::writeLoop()
+{
+    // Writing to a client that went away must fail with EPIPE instead of ending the process
+    sigset_t pipeSignal;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, nullptr);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_.wait_for(lock, std::chrono::seconds(1), [this]() { return stopping_; })) {
+        lock.unlock();
+        send(report(""));
+        lock.lock();
+    }
+    const auto finished = finished_;
+    lock.unlock();
+    send(report(finished));
+}
+
+double ProgressFeed::rate(double seconds, bool transactions) const
+{
+    const auto &latest = samples_.back();
+    for (const auto &sample : samples_) {
+        if (sample.time >= latest.time - seconds - 0.5 && sample.time < latest.time) {
+            const auto count = transactions ? latest.transactions - sample.transactions
+                                            : latest.height - sample.height;
+            return count / (latest.time - sample.time);
+        }
+    }
+    return 0;
+}
+
+std::string ProgressFeed::report(const std::string &finished)
+{
+    const auto now = std::chrono::steady_clock::now();
+    samples_.push_back(Sample{
+        std::chrono::duration<double>(now - start_).count(),
+        height_.load(std::memory_order_relaxed),
+        transactions_.load(std::memory_order_relaxed),
+    });
+    while (samples_.front().time < samples_.back().time - WINDOW_LONG - 1) {
+        samples_.pop_front();
+    }
+
+    const auto &latest = samples_.back();
+    const auto target = targetHeight_.load(std::memory_order_relaxed);
+    const auto blocksPerSecond = rate(WINDOW_LONG, false);
+
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(1);
+    json << "{\"time\":" << std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count()
+         << ",\"elapsedSeconds\":" << latest.time
+         << ",\"stage\":" << jsonString(ScopedBenchmark::currentStage())
+         << ",\"height\":" << latest.height
+         << ",\"targetHeight\":" << target
+         << ",\"transactions\":" << latest.transactions
+         << ",\"blocksPerSecond\":{\"10s\":" << rate(WINDOW_SHORT, false) << ",\"60s\":" << blocksPerSecond << "}"
+         << ",\"transactionsPerSecond\":{\"10s\":" << rate(WINDOW_SHORT, true) << ",\"60s\":" << rate(WINDOW_LONG, true) << "}"
+         << ",\"etaSeconds\":";
+    if (target > latest.height && blocksPerSecond > 0) {
+        json << std::setprecision(0) << (target - latest.height) / blocksPerSecond;
+    } else {
+        json << "null";
+    }
+    json << ",\"consoleQueueBytes\":" << AsyncConsole::queuedBytes()
+         << ",\"checksQueueBlocks\":" << ParallelChecks::queuedBlocks()
+         << ",\"residentBytes\":" << residentBytes();
+    if (!finished.empty()) {
+        json << ",\"finished\":" << jsonString(finished);
+    }
+    json << "}\n";
+    return json.str();
+}
+
+void ProgressFeed::send(const std::string &line)
+{
+    if (listenFd_ != -1) {
+        int client;
+        // Clients are written without blocking, so one that stops reading cannot stall the feed
+        while ((client = accept4(listenFd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+            clients_.push_back(client);
+        }
+    }
+
+    for (auto client = clients_.begin(); client != clients_.end();) {
+        std::size_t written = 0;
+        while (written < line.size()) {
+            const auto result = write(*client, line.data() + written, line.size() - written);
+            if (result == -1 && errno == EINTR) continue;
+            if (result <= 0) break;
+            written += static_cast<std::size_t>(result);
+        }
+        if (written < line.size()) {
+            // Disconnected or not reading (EAGAIN): socket clients are dropped, a broken file
+            // descriptor is no longer used
+            if (listenFd_ != -1) close(*client);
+            client = clients_.erase(client);
+        } else {
+            ++client;
+        }
+    }
+}
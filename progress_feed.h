@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "types.h"
+
+// Machine readable progress: once per second a background thread writes one JSON object per line
+// with the height, blocks/s and transactions/s over the last 10 and 60 seconds, the ETA towards
+// the target height, queued console output, blocks waiting in the read-ahead of ParallelChecks,
+// resident memory and the current stage:
+//
+//     {"stage":"Reading blocks","height":2000,"targetHeight":6000000,"blocksPerSecond":{"10s":...},...}
+//
+// The replay only stores two counters per block, so the feed costs nothing measurable.
+class ProgressFeed {
+public:
+    // Writes to an already open file descriptor, e.g. a pipe of the orchestrating process
+    static std::unique_ptr<ProgressFeed> toFileDescriptor(int fd);
+    // Listens on a Unix domain socket at path; every client receives the lines written after it
+    // connected. Clients whose socket buffer is full are disconnected. An existing socket file at
+    // path is replaced.
+    static std::unique_ptr<ProgressFeed> onSocket(const std::string &path);
+
+    // Writes a last line with "finished" set to the status given by finish(), or "aborted"
+    ~ProgressFeed();
+
+    ProgressFeed(const ProgressFeed &) = delete;
+    ProgressFeed &operator=(const ProgressFeed &) = delete;
+
+    // Height the run is expected to reach, for the ETA. 0: unknown.
+    void setTargetHeight(height_t height);
+
+    void blockProcessed(height_t height, std::size_t transactionCount)
+    {
+        height_.store(height, std::memory_order_relaxed);
+        transactions_.store(transactions_.load(std::memory_order_relaxed) + transactionCount,
+                            std::memory_order_relaxed);
+    }
+
+    // e.g. "valid" or "invalid"
+    void finish(const std::string &status);
+
+private:
+    struct Sample {
+        double time; // seconds since start
+        height_t height;
+        std::uint64_t transactions;
+    };
+
+    ProgressFeed(int fd, int listenFd, const std::string &socketPath);
+
+    void writeLoop();
+    std::string report(const std::string &finished);
+    void send(const std::string &line);
+    // per second over the samples of the last `seconds`
+    double rate(double seconds, bool transactions) const;
+
+    std::atomic<height_t> height_ {0};
+    std::atomic<std::uint64_t> transactions_ {0}; // only written by the replaying thread
+    std::atomic<height_t> targetHeight_ {0};
+
+    int listenFd_; // -1: no socket
+    std::string socketPath_;
+    std::vector<int> clients_; // only used by the writer thread
+    std::deque<Sample> samples_; // only used by the writer thread
+    const std::chrono::steady_clock::time_point start_;
+
+    std::mutex mutex_;
+    std::condition_variable stop_;
+    bool stopping_ = false;
+    std::string finished_ = "aborted";
+
+    std::thread writer_; // last, so that it starts after the members it uses
+};
@@ -0,0 +1,381 @@
+#include "replay.h"
+
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+#include "blockchain_state_validator.h"
+#include "block_validator.h"
+#include "lisk.h"
+#include "log.h"
+#include "payload.h"
+#include "perf_counters.h"
+#include "profiler.h"
+#include "transaction_validator.h"
+#include "utils.h"
+#include "validation_error.h"
+
+Replay::Replay(const Settings &settings)
+    : settings_(settings)
+{
+}
+
+BlockchainState &Replay::blockchainState()
+{
+    return blockchainState_;
+}
+
+const BlockchainState &Replay::blockchainState() const
+{
+    return blockchainState_;
+}
+
+const ReplayPosition &Replay::position() const
+{
+    return position_;
+}
+
+void Replay::restore(const ReplayPosition &position)
+{
+    position_ = position;
+}
+
+void Replay::addRoundClosedCallback(std::function<void(const BlockRow &)> callback)
+{
+    roundClosedCallbacks_.push_back(callback);
+}
+
+void Replay::addRoundRolledBackCallback(std::function<void(height_t)> callback)
+{
+    roundRolledBackCallbacks_.push_back(callback);
+}
+
+void Replay::setSignatureCache(SignatureCache *signatureCache)
+{
+    signatureCache_ = signatureCache;
+}
+
+void Replay::setSignatureSampling(SignatureSampling *sampling)
+{
+    signatureSampling_ = sampling;
+}
+
+void Replay::setStateFingerprint(StateFingerprint *stateFingerprint)
+{
+    stateFingerprint_ = stateFingerprint;
+}
+
+void Replay::setInvariantChecksPerRound(bool enabled)
+{
+    invariantChecksPerRound_ = enabled;
+}
+
+void Replay::setFailureCollector(FailureCollector *failures)
+{
+    failures_ = failures;
+}
+
+std::uint64_t Replay::processedTransactions() const
+{
+    return processedTransactions_;
+}
+
+void Replay::setProgressFeed(ProgressFeed *progress)
+{
+    progress_ = progress;
+}
+
+void Replay::setDelegatedChecks(DelegatedChecks checks)
+{
+    delegatedChecks_ = checks;
+}
+
+template<typename Validation>
+void Replay::check(Validation validation, std::uint64_t transactionId)
+{
+    if (!failures_) {
+        validation();
+        return;
+    }
+
+    try {
+        validation();
+    } catch (const ValidationError &error) {
+        failures_->record(error, transactionId);
+    }
+}
+
+void Replay::reportDelegated(const FailureRecord &failure)
+{
+    check([&]() {
+        throw ValidationError(failure.check, failure.message, failure.expected, failure.actual);
+    }, failure.transactionId);
+}
+
+void Replay::enableJournal(std::size_t depth, height_t fromHeight)
+{
+    journalDepth_ = depth;
+    journalFromHeight_ = fromHeight;
+}
+
+bool Replay::canRollback() const
+{
+    return !journalPositions_.empty();
+}
+
+void Replay::rollbackBlock()
+{
+    const auto height = position_.height;
+
+    blockchainState_.rollbackJournalFrame();
+    position_ = journalPositions_.back();
+    journalPositions_.pop_back();
+    // The state before the block passed its checks
+    blockchainState_.negativeBalanceCandidates.clear();
+
+    // Accounts created by the block were removed without being marked dirty
+    if (stateFingerprint_) {
+        stateFingerprint_->reset(blockchainState_);
+    }
+
+    if (height%101 == 0) {
+        for (const auto &callback : roundRolledBackCallbacks_) {
+            callback(height);
+        }
+    }
+}
+
+void Replay::processBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions)
+{
+    Profiler::Scope scope("block", Profiler::Traced); static_cast<void>(scope);
+    const auto start = std::chrono::steady_clock::now();
+
+    const auto &bh = block.header;
+    const auto dbId = block.id;
+    const auto dbHeight = block.height;
+
+    if (journalDepth_ > 0 && dbHeight >= journalFromHeight_) {
+        blockchainState_.beginJournalFrame();
+        journalPositions_.push_back(position_);
+        if (journalPositions_.size() > journalDepth_) {
+            blockchainState_.dropOldestJournalFrame();
+            journalPositions_.pop_front();
+        }
+    }
+
+    if (dbHeight != position_.height + 1) {
+        throw std::runtime_error("Height mismatch");
+    }
+    position_.height = dbHeight;
+    if (failures_) {
+        failures_->setBlock(dbHeight, dbId);
+    }
+
+    const auto previousBlockId = position_.blockId;
+    check([&]() {
+        if (dbHeight != 1) {
+            if (bh.previousBlock != previousBlockId) {
+                throw ValidationError("block.previousBlock", "previous block mismatch",
+                                      std::to_string(previousBlockId), std::to_string(bh.previousBlock));
+            }
+        }
+    });
+    position_.blockId = dbId;
+    extendChainFingerprint(position_.chainFingerprint, dbId);
+
+    std::multimap<std::uint64_t, FailureRecord> transactionsFailedElsewhere;
+    if (delegatedChecks_) {
+        // The block checks come before all transaction checks
+        for (auto &failure : delegatedChecks_(block, transactions)) {
+            if (failure.transactionId == 0) {
+                reportDelegated(failure);
+            } else {
+                transactionsFailedElsewhere.emplace(failure.transactionId, std::move(failure));
+            }
+        }
+    } else {
+        check([&]() { BlockValidator::validate(block, settings_); });
+
+        Payload payload(transactions);
+        check([&]() { BlockValidator::validateTransactionCount(block, payload); });
+        check([&]() { BlockValidator::validatePayloadHash(block, payload, transactions, settings_); });
+    }
+
+    validateTransactions(block, transactions, transactionsFailedElsewhere);
+
+    // Update state from block transactions
+    // This is done outside of the first transactions loop because second signatures are
+    // only required for later blocks (see e.g. https://explorer.lisk.io/block/3087130330171409946)
+    {
+        Profiler::Scope stateScope("state application", Profiler::Traced); static_cast<void>(stateScope);
+        PerfCounters::Stage perfStage("state application"); static_cast<void>(perfStage);
+        for (auto &transactionRow : transactions) {
+            if (settings_.exceptions.inertTransactions.count(transactionRow.id) == 0) {
+                blockchainState_.applyTransaction(transactionRow);
+            }
+
+            if (settings_.exceptions.balanceAdjustments.count(transactionRow.id)) {
+                blockchainState_.adjustBalance(transactionRow.transaction.senderAddress, settings_.exceptions.balanceAdjustments.at(transactionRow.id));
+            }
+        }
+    }
+
+    {
+        Profiler::Scope invariantScope("invariant checks"); static_cast<void>(invariantScope);
+        if (invariantChecksPerRound_) {
+            // All accounts changed in the round are checked and fingerprinted in closeRound()
+            BlockchainStateValidator::validateNegativeBalanceCandidates(blockchainState_, settings_, failures_);
+        } else {
+            // Dirty keys also contain the accounts changed by the previous block after its validation
+            if (stateFingerprint_) {
+                stateFingerprint_->update(blockchainState_, blockchainState_.addressSummaries.dirtyKeys());
+            }
+            BlockchainStateValidator::validate(blockchainState_, settings_, failures_);
+        }
+    }
+
+    blockchainState_.applyBlock(bh, dbId);
+
+    position_.roundFees += bh.totalFee;
+    position_.roundDelegates[(dbHeight-1)%101] = addressFromPubkey(bh.generatorPublicKey);
+    position_.roundRewards[(dbHeight-1)%101] = bh.reward;
+
+    bool isLast = (dbHeight%101 == 0);
+    //std::cout << "Block: " << id << " in round " << roundFromHeight(dbHeight) << " last: " << isLast << " reward: " << bh.reward << std::endl;
+
+    if (isLast) {
+        closeRound(block);
+    }
+
+    processedTransactions_ += transactions.size();
+    if (progress_) {
+        progress_->blockProcessed(dbHeight, transactions.size());
+    }
+    if (dbHeight%1000 == 0) {
+        logProgress(dbHeight);
+    }
+
+    Profiler::recordBlockLatency(std::chrono::steady_clock::now() - start);
+}
+
+void Replay::validateTransactions(const BlockRow &block, const std::vector<TransactionRow> &transactions,
+                                  std::multimap<std::uint64_t, FailureRecord> &failedElsewhere)
+{
+    Profiler::Scope scope("transactions", Profiler::Traced); static_cast<void>(scope);
+
+    for (auto &transactionRow : transactions) {
+        auto &t = transactionRow.transaction;
+
+        if (TransactionValidator::isExempt(transactionRow, block.height, settings_.exceptions)) {
+            if (block.height == 1 && t.type != 0) {
+                std::cout << "Transaction not verified: " << t << std::endl;
+            }
+        } else {
+            std::vector<unsigned char> secondSignatureRequiredBy;
+            try {
+                secondSignatureRequiredBy = blockchainState_.addressSummaries.at(t.senderAddress).secondPubkey;
+            } catch (std::out_of_range) {
+            }
+            if (delegatedChecks_) {
+                // Like validate(), which checks the second signature after the ID and the first
+                // signature but before amount and fee, and stops at the first failed check
+                const auto failure = failedElsewhere.find(transactionRow.id);
+                const bool failedBefore = failure != failedElsewhere.end() &&
+                        (failure->second.check == "transaction.id" || failure->second.check == "transaction.signature");
+                bool secondSignatureFailed = false;
+                if (!failedBefore) {
+                    check([&]() {
+                        try {
+                            TransactionValidator::validateSecondSignature(transactionRow, secondSignatureRequiredBy, settings_.exceptions);
+                        } catch (const ValidationError &) {
+                            secondSignatureFailed = true;
+                            throw;
+                        }
+                    }, transactionRow.id);
+                }
+                if (failure != failedElsewhere.end()) {
+                    if (!secondSignatureFailed) reportDelegated(failure->second);
+                    failedElsewhere.erase(failure);
+                }
+            } else {
+                check([&]() {
+                    TransactionValidator::validate(transactionRow, secondSignatureRequiredBy, settings_.exceptions, signatureCache_, signatureSampling_);
+                }, transactionRow.id);
+            }
+        }
+    }
+}
+
+std::vector<std::int64_t> roundPayouts(const Settings &settings, height_t roundHeight, std::uint64_t roundFees,
+                                       const std::vector<std::uint64_t> &roundRewards)
+{
+    auto roundNumber = roundFromHeight(roundHeight);
+    std::uint64_t rewardsFactor = 1;
+    if (settings.exceptions.rewardsFactor.count(roundNumber)) {
+        rewardsFactor = settings.exceptions.rewardsFactor.at(roundNumber);
+    }
+    if (settings.exceptions.feesFactor.count(roundNumber)) {
+        roundFees *= settings.exceptions.feesFactor.at(roundNumber);
+    }
+    if (settings.exceptions.feesBonus.count(roundNumber)) {
+        roundFees += settings.exceptions.feesBonus.at(roundNumber);
+    }
+
+    auto feePerDelegate = roundFees/101;
+    auto feeRemaining = roundFees - (101*feePerDelegate);
+
+    std::vector<std::int64_t> payouts(101);
+    for (int i = 0; i < 101; ++i)
+    {
+        payouts[i] = roundRewards[i] * rewardsFactor + feePerDelegate;
+    }
+
+    // rest goes to the last delegate
+    payouts[100] += feeRemaining;
+
+    return payouts;
+}
+
+void Replay::closeRound(const BlockRow &block)
+{
+    Profiler::Scope scope("round close", Profiler::Traced); static_cast<void>(scope);
+
+    const auto payouts = roundPayouts(settings_, block.height, position_.roundFees, position_.roundRewards);
+    for (int i = 0; i < 101; ++i)
+    {
+        blockchainState_.addressSummaries[position_.roundDelegates[i]].balance += payouts[i];
+    }
+
+    for (int i = 0; i < 101; ++i) {
+        blockchainState_.addressSummaries[position_.roundDelegates[i]].lastBlockId = block.id;
+    }
+
+    position_.roundFees = 0;
+
+    if (stateFingerprint_) {
+        stateFingerprint_->update(blockchainState_, blockchainState_.addressSummaries.dirtyKeys());
+    }
+    if (invariantChecksPerRound_) {
+        BlockchainStateValidator::validate(blockchainState_, settings_, failures_);
+    }
+
+    for (const auto &callback : roundClosedCallbacks_) {
+        callback(block);
+    }
+}
+
+void Replay::logProgress(height_t height)
+{
+    auto now = std::chrono::steady_clock::now();
+    times_[height] = now;
+    NumberLog().out() << "Done processing block at height " << height;
+    const int benchmarkSpan = 10000;
+    if (times_.count(height-benchmarkSpan)) {
+        auto diff = std::chrono::duration<float>(now - times_[height-benchmarkSpan]).count();
+        auto bps = benchmarkSpan / diff;
+        std::cout << " (current speed " << std::fixed << std::setprecision(1) << bps  << " blocks/s)";
+    }
+    std::cout << std::endl;
+}
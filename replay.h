@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "block.h"
+#include "blockchain_state.h"
+#include "failure_collector.h"
+#include "lisk.h"
+#include "progress_feed.h"
+#include "settings.h"
+#include "signature_cache.h"
+#include "signature_sampling.h"
+#include "state_fingerprint.h"
+#include "transaction.h"
+
+// Everything besides the blockchain state that is needed to continue a replay
+struct ReplayPosition {
+    height_t height = 0;
+    std::uint64_t blockId = 0;
+    bytes_t chainFingerprint = initialChainFingerprint();
+    std::uint64_t roundFees = 0;
+    std::vector<std::uint64_t> roundDelegates = std::vector<std::uint64_t>(101);
+    std::vector<std::uint64_t> roundRewards = std::vector<std::uint64_t>(101);
+};
+
+// Balance credited to each of the 101 delegate slots of the round ending at roundHeight: the block
+// reward plus an equal share of the round fees, the remainder going to the last slot
+std::vector<std::int64_t> roundPayouts(const Settings &settings, height_t roundHeight, std::uint64_t roundFees,
+                                       const std::vector<std::uint64_t> &roundRewards);
+
+// Applies blocks in height order to the blockchain state and validates
+// everything that can be checked along the way
+class Replay {
+public:
+    Replay(const Settings &settings);
+
+    void processBlock(const BlockRow &block, const std::vector<TransactionRow> &transactions);
+
+    BlockchainState &blockchainState();
+    const BlockchainState &blockchainState() const;
+
+    const ReplayPosition &position() const;
+    // Transactions in the blocks processed since construction, including blocks rolled back
+    std::uint64_t processedTransactions() const;
+    // Continue after the block at position.height. The blockchain state must be restored separately.
+    void restore(const ReplayPosition &position);
+
+    // Called with the last block of every round, after the round rewards have been applied
+    void addRoundClosedCallback(std::function<void(const BlockRow &)> callback);
+    // Called with the height of the last block of a round when rollbackBlock() undoes it, so that
+    // whatever the round closed callbacks wrote for it can be withdrawn
+    void addRoundRolledBackCallback(std::function<void(height_t)> callback);
+
+    void setSignatureCache(SignatureCache *signatureCache);
+    // Verify only the first transaction signatures selected by sampling
+    void setSignatureSampling(SignatureSampling *sampling);
+
+    // Keeps stateFingerprint up to date after every block. It must match the state when set.
+    void setStateFingerprint(StateFingerprint *stateFingerprint);
+
+    // Check all changed accounts once per round instead of after every block. Accounts whose
+    // balance became negative are still checked after every block, so failures are reported
+    // for the same block with the same message.
+    void setInvariantChecksPerRound(bool enabled);
+
+    // Record failed checks in failures and continue. Blocks and transactions failing a check are
+    // applied as they are, so the following blocks are validated against the state the chain has.
+    void setFailureCollector(FailureCollector *failures);
+
+    // Reports every processed block to progress
+    void setProgressFeed(ProgressFeed *progress);
+
+    // Results of the checks not depending on the blockchain state, run elsewhere
+    using DelegatedChecks = std::function<std::vector<FailureRecord>(const BlockRow &, const std::vector<TransactionRow> &)>;
+    // Replaces the block ID, signature, reward and payload checks and all transaction checks except
+    // second signatures by the failures checks returns for the block, in the same order as they
+    // would have failed. An empty function restores them.
+    void setDelegatedChecks(DelegatedChecks checks);
+
+    // Keep the changes of the last `depth` blocks with height >= fromHeight for rollbackBlock()
+    void enableJournal(std::size_t depth, height_t fromHeight);
+    bool canRollback() const;
+    // Undoes the last processed block
+    void rollbackBlock();
+
+private:
+    // failedElsewhere holds the failed delegated checks by transaction ID. They are reported in the
+    // place of the sequential checks, so failures come in the same order with or without delegation.
+    void validateTransactions(const BlockRow &block, const std::vector<TransactionRow> &transactions,
+                              std::multimap<std::uint64_t, FailureRecord> &failedElsewhere);
+    void closeRound(const BlockRow &block);
+    void logProgress(height_t height);
+    // Runs validation, recording a ValidationError instead of throwing it if failures are collected
+    template<typename Validation>
+    void check(Validation validation, std::uint64_t transactionId = 0);
+    // Reports a failure of the delegated checks like check() does
+    void reportDelegated(const FailureRecord &failure);
+
+    const Settings &settings_;
+    BlockchainState blockchainState_;
+
+    ReplayPosition position_;
+    std::vector<std::function<void(const BlockRow &)>> roundClosedCallbacks_;
+    std::vector<std::function<void(height_t)>> roundRolledBackCallbacks_;
+    SignatureCache *signatureCache_ = nullptr;
+    SignatureSampling *signatureSampling_ = nullptr;
+    StateFingerprint *stateFingerprint_ = nullptr;
+    bool invariantChecksPerRound_ = false;
+    FailureCollector *failures_ = nullptr;
+    ProgressFeed *progress_ = nullptr;
+    DelegatedChecks delegatedChecks_;
+    std::uint64_t processedTransactions_ = 0;
+
+    std::size_t journalDepth_ = 0;
+    height_t journalFromHeight_ = 0;
+    std::deque<ReplayPosition> journalPositions_; // position before each journaled block
+
+    std::unordered_map<std::uint64_t, std::chrono::steady_clock::time_point> times_;
+};
@@ -0,0 +1,68 @@
+#include "run_metrics.h"
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <sys/resource.h>
+
+#include "binary_file.h"
+#include "profiler.h"
+#include "utils.h"
+
+namespace {
+
+double toSeconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+double perSecond(std::uint64_t count, std::chrono::steady_clock::duration duration)
+{
+    return duration.count() > 0 ? count / toSeconds(duration) : 0;
+}
+
+std::uint64_t peakResidentBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024; // kilobytes on Linux
+}
+
+}
+
+void RunMetrics::write(const std::string &path) const
+{
+    std::ostringstream json;
+    json << std::fixed << std::setprecision(3);
+    json << "{\n"
+         << "  \"network\": " << jsonString(network) << ",\n"
+         << "  \"blocks\": " << blocks << ",\n"
+         << "  \"transactions\": " << transactions << ",\n"
+         << "  \"replaySeconds\": " << toSeconds(replayTime) << ",\n"
+         << "  \"totalSeconds\": " << toSeconds(totalTime) << ",\n"
+         << "  \"blocksPerSecond\": " << perSecond(blocks, replayTime) << ",\n"
+         << "  \"transactionsPerSecond\": " << perSecond(transactions, replayTime) << ",\n"
+         << "  \"peakResidentBytes\": " << peakResidentBytes() << ",\n"
+         << "  \"threadPool\": [";
+    for (std::size_t i = 0; i < threadPool.size(); ++i) {
+        json << (i ? ",\n" : "\n")
+             << "    {\"busySeconds\": " << toSeconds(threadPool[i].busy) << ", \"tasks\": " << threadPool[i].tasks
+             << ", \"steals\": " << threadPool[i].steals << "}";
+    }
+    json << "\n  ],\n"
+         << "  \"stages\": {";
+    const auto stages = Profiler::stageTotals();
+    for (std::size_t i = 0; i < stages.size(); ++i) {
+        json << (i ? ",\n" : "\n")
+             << "    " << jsonString(stages[i].path) << ": {\"seconds\": " << toSeconds(stages[i].total)
+             << ", \"calls\": " << stages[i].calls << "}";
+    }
+    json << "\n  }\n}\n";
+
+    const auto content = json.str();
+    AtomicFileWriter writer(path);
+    writer.write(content.data(), content.size());
+    writer.commit();
+    std::cout << "Wrote run metrics to " << path << std::endl;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+#include "types.h"
+
+// Throughput summary of a validation run for comparisons between builds
+struct RunMetrics {
+    std::string network;
+    height_t blocks = 0; // replayed in this run
+    std::uint64_t transactions = 0;
+    std::chrono::steady_clock::duration replayTime {}; // reading and replaying the blocks
+    std::chrono::steady_clock::duration totalTime {};
+    std::vector<ThreadPool::WorkerStatistics> threadPool; // see ThreadPool::statistics()
+
+    // Writes the metrics, the peak resident set size and the times of all profiler stages to path
+    // as JSON. Threads must have finished their profiler scopes.
+    void write(const std::string &path) const;
+};
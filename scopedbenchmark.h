@@ -2,25 +2,55 @@
 
 #include <chrono>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "log.h"
+#include "profiler.h"
 
+// Traced profiler stage that also prints its wall time when finished
 class ScopedBenchmark {
 public:
     ScopedBenchmark(std::string title)
         : start_(std::chrono::steady_clock::now())
         , title_(title)
-    {}
+        , scope_(title_, Profiler::Traced)
+    {
+        std::lock_guard<std::mutex> lock(stages().mutex);
+        stages().titles.push_back(title_);
+    }
 
     ~ScopedBenchmark() {
+        {
+            std::lock_guard<std::mutex> lock(stages().mutex);
+            stages().titles.pop_back();
+        }
         auto diffMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_);
         NumberLog().out() << title_ << " finished in "
                           << diffMs.count() << " ms"
                           << std::endl;
     }
 
+    // Title of the innermost running benchmark, as the stage the run is in.
+    // Benchmarks are only created by the main thread, but this may be called from any thread.
+    static std::string currentStage() {
+        std::lock_guard<std::mutex> lock(stages().mutex);
+        return stages().titles.empty() ? std::string() : stages().titles.back();
+    }
+
 private:
+    struct Stages {
+        std::mutex mutex;
+        std::vector<std::string> titles;
+    };
+
+    static Stages &stages() {
+        static Stages instance;
+        return instance;
+    }
+
     std::chrono::steady_clock::time_point start_;
     std::string title_;
+    Profiler::Scope scope_;
 };
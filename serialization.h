@@ -0,0 +1,178 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size binary formats described as a list of fields. The layout knows its size at compile
+// time and writes to / reads from caller-provided buffers, so the same description serves the
+// Lisk wire format and our file formats:
+//
+//     using PointLayout = Serialization::Layout<Serialization::Little<std::uint32_t>, Serialization::Bytes<32>>;
+//     unsigned char buffer[PointLayout::size];
+//     PointLayout::write(buffer, height, hash);
+//     PointLayout::read(buffer, height, hash);
+namespace Serialization {
+
+namespace detail {
+
+inline std::uint8_t byteSwap(std::uint8_t value) { return value; }
+inline std::uint16_t byteSwap(std::uint16_t value) { return __builtin_bswap16(value); }
+inline std::uint32_t byteSwap(std::uint32_t value) { return __builtin_bswap32(value); }
+inline std::uint64_t byteSwap(std::uint64_t value) { return __builtin_bswap64(value); }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+const bool HOST_IS_LITTLE_ENDIAN = false;
+#else
+const bool HOST_IS_LITTLE_ENDIAN = true;
+#endif
+
+template<typename type_of_value, bool little_endian>
+struct Integer {
+    static_assert(std::is_integral<type_of_value>::value, "Integer fields need an integral type");
+    using bits_t = typename std::make_unsigned<type_of_value>::type;
+
+    static constexpr std::size_t size = sizeof(type_of_value);
+
+    static void store(unsigned char *out, type_of_value value)
+    {
+        auto bits = static_cast<bits_t>(value);
+        if (little_endian != HOST_IS_LITTLE_ENDIAN) bits = byteSwap(bits);
+        std::memcpy(out, &bits, size);
+    }
+
+    template<typename type_of_target>
+    static void load(const unsigned char *in, type_of_target &value)
+    {
+        bits_t bits;
+        std::memcpy(&bits, in, size);
+        if (little_endian != HOST_IS_LITTLE_ENDIAN) bits = byteSwap(bits);
+        value = static_cast<type_of_target>(static_cast<type_of_value>(bits));
+    }
+};
+
+template<typename type_of_value, bool little_endian>
+constexpr std::size_t Integer<type_of_value, little_endian>::size;
+
+}
+
+template<typename type_of_value>
+using Little = detail::Integer<type_of_value, true>;
+
+template<typename type_of_value>
+using Big = detail::Integer<type_of_value, false>;
+
+// Exactly length bytes from a std::vector, std::array or std::string
+template<std::size_t length>
+struct Bytes {
+    static constexpr std::size_t size = length;
+
+    template<typename type_of_value>
+    static void store(unsigned char *out, const type_of_value &value)
+    {
+        if (value.size() != length) {
+            throw std::runtime_error("Expected " + std::to_string(length) + " bytes, got " + std::to_string(value.size()));
+        }
+        std::memcpy(out, value.data(), length);
+    }
+
+    static void load(const unsigned char *in, std::vector<unsigned char> &value)
+    {
+        value.assign(in, in + length);
+    }
+
+    static void load(const unsigned char *in, std::array<unsigned char, length> &value)
+    {
+        std::memcpy(value.data(), in, length);
+    }
+};
+
+template<std::size_t length>
+constexpr std::size_t Bytes<length>::size;
+
+// Up to length bytes, padded with zeros. The format must store the used length elsewhere.
+template<std::size_t length>
+struct PaddedBytes : Bytes<length> {
+    template<typename type_of_value>
+    static void store(unsigned char *out, const type_of_value &value)
+    {
+        if (value.size() > length) {
+            throw std::runtime_error("Expected at most " + std::to_string(length) + " bytes, got " + std::to_string(value.size()));
+        }
+        if (!value.empty()) std::memcpy(out, value.data(), value.size());
+        std::memset(out + value.size(), 0, length - value.size());
+    }
+};
+
+// count consecutive fields, stored from and loaded into a std::vector of exactly count values
+template<typename type_of_field, std::size_t count>
+struct Array {
+    static constexpr std::size_t size = type_of_field::size * count;
+
+    template<typename type_of_value>
+    static void store(unsigned char *out, const std::vector<type_of_value> &values)
+    {
+        if (values.size() != count) {
+            throw std::runtime_error("Expected " + std::to_string(count) + " values, got " + std::to_string(values.size()));
+        }
+        for (std::size_t i = 0; i < count; ++i) {
+            type_of_field::store(out + i * type_of_field::size, values[i]);
+        }
+    }
+
+    template<typename type_of_value>
+    static void load(const unsigned char *in, std::vector<type_of_value> &values)
+    {
+        values.resize(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            type_of_field::load(in + i * type_of_field::size, values[i]);
+        }
+    }
+};
+
+template<typename type_of_field, std::size_t count>
+constexpr std::size_t Array<type_of_field, count>::size;
+
+// Fields stored back to back without padding, in the order given
+template<typename... fields>
+struct Layout;
+
+template<>
+struct Layout<> {
+    static constexpr std::size_t size = 0;
+
+    static void write(unsigned char *) {}
+    static void read(const unsigned char *) {}
+};
+
+template<typename first, typename... rest>
+struct Layout<first, rest...> {
+    static constexpr std::size_t size = first::size + Layout<rest...>::size;
+
+    // One value per field
+    template<typename type_of_value, typename... types_of_values>
+    static void write(unsigned char *out, const type_of_value &value, const types_of_values &... values)
+    {
+        static_assert(sizeof...(types_of_values) == sizeof...(rest), "Layout::write needs one value per field");
+        first::store(out, value);
+        Layout<rest...>::write(out + first::size, values...);
+    }
+
+    template<typename type_of_value, typename... types_of_values>
+    static void read(const unsigned char *in, type_of_value &value, types_of_values &... values)
+    {
+        static_assert(sizeof...(types_of_values) == sizeof...(rest), "Layout::read needs one value per field");
+        first::load(in, value);
+        Layout<rest...>::read(in + first::size, values...);
+    }
+};
+
+template<typename first, typename... rest>
+constexpr std::size_t Layout<first, rest...>::size;
+
+}
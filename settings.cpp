@@ -281,5 +281,15 @@ Settings::Settings(Network network)
         exceptions.transactionFee[12218027223346052530ul] = 0.2 * BPL; // 316636
         exceptions.transactionFee[15330085901178121679ul] = 0.2 * BPL; // 440756
         break;
+    case Network::Synthetic:
+        // The genesis block depends on the generator parameters. Its transactions pay regular fees.
+        genesisBlock = 0;
+        // Genesis account, passphrase "snapshot-validator synthetic genesis"
+        negativeBalanceAddress = 5911377105561906617ul;
+        rewardOffset = 2;
+        rewardDistance = 3000000;
+        v100Compatible = false;
+        exceptions.freeTransactionsBlockId = 0;
+        break;
     }
 }
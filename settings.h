@@ -2,37 +2,50 @@
 
 #include <cstdint>
 #include <set>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
 
+#include "id_index.h"
 #include "types.h"
 
 enum class Network {
     Mainnet,
     Testnet,
     Betanet,
+    Synthetic, // chains made by snapshot-validator-generator
 };
 
 inline Network networkFromName(std::string name) {
     if (name == "mainnet") return Network::Mainnet;
     if (name == "testnet") return Network::Testnet;
     if (name == "betanet") return Network::Betanet;
+    if (name == "synthetic") return Network::Synthetic;
     throw std::runtime_error("Unknown network name: '" + name + "'");
 }
 
+inline std::string networkName(Network network) {
+    switch (network) {
+    case Network::Mainnet: return "mainnet";
+    case Network::Testnet: return "testnet";
+    case Network::Betanet: return "betanet";
+    case Network::Synthetic: return "synthetic";
+    }
+    throw std::runtime_error("Unknown network");
+}
+
 struct Exceptions {
     std::uint64_t freeTransactionsBlockId; // i.e. genesis block
-    std::set<std::uint64_t> invalidTransactionSignature;
-    std::set<std::uint64_t> inertTransactions;
-    std::set<std::uint64_t> transactionsContainingInvalidRecipientAddress;
-    std::set<std::string> invalidAddresses;
-    std::set<std::uint64_t> payloadHashMismatch;
-    std::unordered_map<std::uint64_t, std::int64_t> balanceAdjustments;
-    std::unordered_map<height_t, std::uint64_t> blockRewards;
-    std::unordered_map<std::uint64_t, int> rewardsFactor;
-    std::unordered_map<std::uint64_t, int> feesFactor;
-    std::unordered_map<std::uint64_t, int> feesBonus;
-    std::unordered_map<std::uint64_t, std::uint64_t> transactionFee;
+    IdSet invalidTransactionSignature;
+    IdSet inertTransactions;
+    IdSet transactionsContainingInvalidRecipientAddress;
+    std::set<std::string> invalidAddresses; // only used once, after the replay
+    IdSet payloadHashMismatch;
+    IdMap<std::int64_t> balanceAdjustments;
+    IdMap<std::uint64_t> blockRewards; // by height
+    IdMap<int> rewardsFactor; // by round
+    IdMap<int> feesFactor; // by round
+    IdMap<int> feesBonus; // by round
+    IdMap<std::uint64_t> transactionFee;
 };
 
 struct Settings {
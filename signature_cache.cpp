@@ -0,0 +1,201 @@
+#include "signature_cache.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include <sodium.h>
+
+namespace {
+
+const char MAGIC[8] = {'L', 'S', 'K', 'S', 'I', 'G', 'C', 'A'};
+const std::uint32_t FORMAT_VERSION = 1;
+
+struct Header {
+    char magic[8];
+    std::uint32_t formatVersion;
+    std::uint32_t keySize;
+    std::uint64_t keyCount;
+};
+
+void hashBytes(crypto_hash_sha256_state &state, const bytes_t &data)
+{
+    // Length prefix keeps the concatenation unambiguous
+    const unsigned char length = static_cast<unsigned char>(data.size());
+    crypto_hash_sha256_update(&state, &length, 1);
+    crypto_hash_sha256_update(&state, data.data(), data.size());
+}
+
+// Holds an exclusive lock on path + ".lock" while alive
+class FileLock {
+public:
+    explicit FileLock(const std::string &path)
+        : fd_(open((path + ".lock").c_str(), O_CREAT | O_RDWR, 0644))
+    {
+        if (fd_ < 0 || flock(fd_, LOCK_EX) != 0) {
+            if (fd_ >= 0) close(fd_);
+            throw std::runtime_error("Could not lock " + path + ".lock: " + std::strerror(errno));
+        }
+    }
+
+    ~FileLock()
+    {
+        flock(fd_, LOCK_UN);
+        close(fd_);
+    }
+
+private:
+    int fd_;
+};
+
+}
+
+SignatureCache::SignatureCache(const std::string &path)
+    : path_(path)
+{
+    load();
+}
+
+SignatureCache::key_t SignatureCache::key(const TransactionRow &row, const bytes_t &secondPublicKey)
+{
+    crypto_hash_sha256_state state;
+    crypto_hash_sha256_init(&state);
+    unsigned char prefix[Transaction::PrefixLayout::size];
+    row.transaction.serializePrefix(prefix);
+    crypto_hash_sha256_update(&state, prefix, sizeof(prefix));
+    crypto_hash_sha256_update(&state, row.transaction.assetData.data(), row.transaction.assetData.size());
+    hashBytes(state, row.signature);
+    hashBytes(state, row.secondSignature);
+    hashBytes(state, row.transaction.senderPublicKey);
+    hashBytes(state, secondPublicKey);
+
+    unsigned char hash[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256_final(&state, hash);
+
+    key_t out;
+    std::copy(hash, hash + out.size(), out.begin());
+    return out;
+}
+
+bool SignatureCache::contains(const key_t &key)
+{
+    if (containsInFile(key)) {
+        ++hits_;
+        return true;
+    }
+    return false;
+}
+
+void SignatureCache::insert(const key_t &key)
+{
+    std::lock_guard<std::mutex> lock(pendingMutex_);
+    pending_.push_back(key);
+    ++inserted_;
+}
+
+void SignatureCache::save()
+{
+    FileLock lock(path_);
+
+    // Another run may have replaced the file since it was loaded
+    load();
+
+    std::sort(pending_.begin(), pending_.end());
+
+    const auto *fileKeys = file_ ? file_->data() + sizeof(Header) : nullptr;
+    std::vector<key_t> merged;
+    merged.reserve(fileKeyCount_ + pending_.size());
+    std::uint64_t i = 0;
+    auto next = pending_.cbegin();
+    while (i < fileKeyCount_ || next != pending_.cend()) {
+        key_t fileKey;
+        if (i < fileKeyCount_) {
+            std::memcpy(fileKey.data(), fileKeys + i * fileKey.size(), fileKey.size());
+        }
+
+        if (next == pending_.cend() || (i < fileKeyCount_ && fileKey < *next)) {
+            merged.push_back(fileKey);
+            ++i;
+        } else {
+            if (merged.empty() || merged.back() != *next) {
+                merged.push_back(*next);
+            }
+            if (i < fileKeyCount_ && fileKey == *next) ++i;
+            ++next;
+        }
+    }
+
+    Header header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.formatVersion = FORMAT_VERSION;
+    header.keySize = sizeof(key_t);
+    header.keyCount = merged.size();
+
+    AtomicFileWriter out(path_);
+    out.write(header);
+    out.write(merged.data(), merged.size() * sizeof(key_t));
+    out.commit();
+
+    pending_.clear();
+    load();
+}
+
+std::uint64_t SignatureCache::hits() const
+{
+    return hits_;
+}
+
+std::uint64_t SignatureCache::inserted() const
+{
+    return inserted_;
+}
+
+void SignatureCache::load()
+{
+    file_.reset();
+    fileKeyCount_ = 0;
+
+    if (access(path_.c_str(), F_OK) != 0) return;
+
+    std::unique_ptr<MappedFile> file(new MappedFile(path_));
+    if (file->size() < sizeof(Header)) {
+        throw std::runtime_error("Signature cache " + path_ + " is truncated");
+    }
+    const auto header = file->read<Header>(0);
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.formatVersion != FORMAT_VERSION
+            || header.keySize != sizeof(key_t)) {
+        throw std::runtime_error(path_ + " is not a signature cache of a supported format");
+    }
+    if (sizeof(Header) + header.keyCount * sizeof(key_t) != file->size()) {
+        throw std::runtime_error("Signature cache " + path_ + " is truncated");
+    }
+
+    fileKeyCount_ = header.keyCount;
+    file_ = std::move(file);
+}
+
+bool SignatureCache::containsInFile(const key_t &key) const
+{
+    if (!file_) return false;
+
+    const auto *keys = file_->data() + sizeof(Header);
+    std::uint64_t low = 0;
+    std::uint64_t high = fileKeyCount_;
+    while (low < high) {
+        const auto middle = low + (high - low) / 2;
+        const int comparison = std::memcmp(keys + middle * key.size(), key.data(), key.size());
+        if (comparison == 0) return true;
+        if (comparison < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "binary_file.h"
+#include "transaction.h"
+#include "types.h"
+
+// Persistent set of transactions whose signatures were verified successfully.
+//
+// A key covers everything a successful verification depends on: the serialized transaction,
+// both signatures, the sender public key and the second public key required by the state.
+// The file is a sorted array of 16 byte keys, mapped for lookups. Runs sharing a file merge
+// their new keys under an exclusive lock and replace the file atomically, so concurrent
+// readers keep a consistent mapping.
+//
+// contains() and insert() may be called from several threads, the other members may not.
+class SignatureCache {
+public:
+    using key_t = std::array<unsigned char, 16>;
+
+    explicit SignatureCache(const std::string &path);
+
+    static key_t key(const TransactionRow &row, const bytes_t &secondPublicKey);
+
+    bool contains(const key_t &key);
+    // Keys inserted during a run become visible to contains() after save()
+    void insert(const key_t &key);
+
+    void save();
+
+    std::uint64_t hits() const;
+    std::uint64_t inserted() const;
+
+private:
+    void load();
+    bool containsInFile(const key_t &key) const;
+
+    std::string path_;
+    std::unique_ptr<MappedFile> file_;
+    std::uint64_t fileKeyCount_ = 0;
+    std::mutex pendingMutex_;
+    std::vector<key_t> pending_;
+    std::atomic<std::uint64_t> hits_{0};
+    std::atomic<std::uint64_t> inserted_{0};
+};
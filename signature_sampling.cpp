@@ -0,0 +1,73 @@
+#include "signature_sampling.h"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// splitmix64 finalizer
+std::uint64_t mix(std::uint64_t value)
+{
+    value += 0x9E3779B97F4A7C15ull;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+}
+
+SignatureSampling::SignatureSampling(double fraction, std::uint64_t seed)
+    : fraction_(fraction)
+    , seed_(seed)
+{
+    if (!(fraction > 0 && fraction <= 1)) {
+        throw std::runtime_error("Sampling fraction must be in (0, 1]");
+    }
+    threshold_ = (fraction == 1)
+            ? std::numeric_limits<std::uint64_t>::max()
+            : static_cast<std::uint64_t>(std::ldexp(fraction, 64));
+}
+
+bool SignatureSampling::select(std::uint64_t transactionId)
+{
+    const bool selected = (mix(seed_ ^ mix(transactionId)) <= threshold_);
+    if (selected) {
+        ++verified_;
+    } else {
+        ++skipped_;
+    }
+    return selected;
+}
+
+std::uint64_t SignatureSampling::verified() const
+{
+    return verified_;
+}
+
+std::uint64_t SignatureSampling::skipped() const
+{
+    return skipped_;
+}
+
+std::string SignatureSampling::summary() const
+{
+    std::ostringstream out;
+    out << "Sampled result: verified " << verified_ << " of " << (verified_ + skipped_)
+        << " transaction signatures (fraction " << fraction_ << ", seed " << seed_ << ")." << std::endl;
+    out << "Block signatures and second signatures were all verified." << std::endl;
+
+    if (skipped_ == 0) {
+        out << "No transaction signature was skipped.";
+    } else {
+        // Each invalid signature is found independently with probability fraction_. Finding none
+        // has a probability below 5% once there are at least this many.
+        const auto undetectable = std::ceil(std::log(0.05) / std::log1p(-fraction_));
+        out << "Confidence: if " << std::fixed << std::setprecision(0) << undetectable
+            << " or more transaction signatures were invalid, at least one would have been found"
+            << " with 95% probability.";
+    }
+    return out.str();
+}
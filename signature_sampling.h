@@ -0,0 +1,30 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Deterministic selection of the transaction signatures to verify in sampling mode.
+// Whether a transaction is selected only depends on seed and transaction ID, so a run can be
+// reproduced with the same seed regardless of reading order, caches or resuming.
+class SignatureSampling {
+public:
+    // fraction in (0, 1]
+    SignatureSampling(double fraction, std::uint64_t seed);
+
+    // Counts the decision for summary(). Can be called from several threads.
+    bool select(std::uint64_t transactionId);
+
+    std::uint64_t verified() const;
+    std::uint64_t skipped() const;
+
+    // What the sampled result means, e.g. for printing after a successful run
+    std::string summary() const;
+
+private:
+    double fraction_;
+    std::uint64_t seed_;
+    std::uint64_t threshold_;
+    std::atomic<std::uint64_t> verified_{0};
+    std::atomic<std::uint64_t> skipped_{0};
+};
@@ -0,0 +1,102 @@
+#include "state_fingerprint.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include <sodium.h>
+
+#include "profiler.h"
+#include "serialization.h"
+
+void StateFingerprint::reset(const BlockchainState &state)
+{
+    sum_ = {};
+    accountHashes_.clear();
+    accountHashes_.reserve(state.addressSummaries.size());
+    for (const auto &entry : state.addressSummaries) {
+        const auto hash = accountHash(entry.first, entry.second);
+        accountHashes_[entry.first] = hash;
+        add(hash);
+    }
+}
+
+void StateFingerprint::update(const BlockchainState &state, const std::set<address_t> &addresses)
+{
+    Profiler::Scope scope("state fingerprint"); static_cast<void>(scope);
+    for (auto address : addresses) {
+        auto previous = accountHashes_.find(address);
+        if (previous != accountHashes_.end()) {
+            subtract(previous->second);
+        }
+
+        auto summary = state.addressSummaries.find(address);
+        if (summary == state.addressSummaries.end()) {
+            if (previous != accountHashes_.end()) accountHashes_.erase(previous);
+            continue;
+        }
+
+        const auto hash = accountHash(address, summary->second);
+        add(hash);
+        accountHashes_[address] = hash;
+    }
+}
+
+std::string StateFingerprint::hex() const
+{
+    std::stringstream out;
+    out << std::setfill('0') << std::hex;
+    for (auto lane : sum_) {
+        out << std::setw(16) << lane;
+    }
+    return out.str();
+}
+
+StateFingerprint::hash_t StateFingerprint::accountHash(address_t address, const AddressSummary &summary)
+{
+    crypto_hash_sha256_state state;
+    crypto_hash_sha256_init(&state);
+
+    // Lengths keep second pubkey and delegate name apart. Little endian, so that fingerprints
+    // are the same on every architecture.
+    using NumbersLayout = Serialization::Layout<
+        Serialization::Little<std::uint64_t>, // address
+        Serialization::Little<std::int64_t>, // balance
+        Serialization::Little<std::uint64_t>, // last block ID
+        Serialization::Little<std::uint64_t>, // second pubkey length
+        Serialization::Little<std::uint64_t> // delegate name length
+    >;
+    unsigned char numbers[NumbersLayout::size];
+    NumbersLayout::write(numbers, address, summary.balance, summary.lastBlockId,
+                         static_cast<std::uint64_t>(summary.secondPubkey.size()),
+                         static_cast<std::uint64_t>(summary.delegateName.size()));
+    crypto_hash_sha256_update(&state, numbers, sizeof(numbers));
+    crypto_hash_sha256_update(&state, summary.secondPubkey.data(), summary.secondPubkey.size());
+    crypto_hash_sha256_update(&state, reinterpret_cast<const unsigned char *>(summary.delegateName.data()),
+                              summary.delegateName.size());
+
+    unsigned char digest[crypto_hash_sha256_BYTES];
+    crypto_hash_sha256_final(&state, digest);
+
+    using LanesLayout = Serialization::Layout<
+        Serialization::Little<std::uint64_t>, Serialization::Little<std::uint64_t>,
+        Serialization::Little<std::uint64_t>, Serialization::Little<std::uint64_t>
+    >;
+    static_assert(LanesLayout::size == sizeof(digest), "A digest fills all lanes");
+    hash_t out;
+    LanesLayout::read(digest, out[0], out[1], out[2], out[3]);
+    return out;
+}
+
+void StateFingerprint::add(const hash_t &hash)
+{
+    for (std::size_t i = 0; i < sum_.size(); ++i) {
+        sum_[i] += hash[i];
+    }
+}
+
+void StateFingerprint::subtract(const hash_t &hash)
+{
+    for (std::size_t i = 0; i < sum_.size(); ++i) {
+        sum_[i] -= hash[i];
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "blockchain_state.h"
+#include "types.h"
+
+// Order-independent hash of all accounts in a blockchain state.
+//
+// Every account is hashed on its own (address, balance, second pubkey, delegate name
+// and last block ID); the fingerprint is the lane-wise sum of these hashes. Changing an
+// account subtracts its old hash and adds the new one, so updates cost O(changed accounts)
+// and two replays reaching the same state get the same fingerprint.
+class StateFingerprint {
+public:
+    // Recomputes the fingerprint from all accounts
+    void reset(const BlockchainState &state);
+    // Updates the hashes of the given accounts, which may have been removed from the state
+    void update(const BlockchainState &state, const std::set<address_t> &addresses);
+
+    std::string hex() const;
+
+private:
+    using hash_t = std::array<std::uint64_t, 4>;
+
+    static hash_t accountHash(address_t address, const AddressSummary &summary);
+    void add(const hash_t &hash);
+    void subtract(const hash_t &hash);
+
+    hash_t sum_ = {};
+    std::unordered_map<address_t, hash_t> accountHashes_;
+};
@@ -0,0 +1,42 @@
+#include "stateless_checks.h"
+
+#include <functional>
+
+#include "block_validator.h"
+#include "payload.h"
+#include "profiler.h"
+#include "transaction_validator.h"
+#include "validation_error.h"
+
+namespace StatelessChecks {
+
+void run(const BlockRow &block, const std::vector<TransactionRow> &transactions, const Settings &settings,
+         SignatureCache *signatureCache, SignatureSampling *sampling, std::vector<FailureRecord> &failures)
+{
+    Profiler::Scope scope("stateless checks", Profiler::Traced); static_cast<void>(scope);
+    auto check = [&](const std::function<void()> &validation, std::uint64_t transactionId) {
+        try {
+            validation();
+        } catch (const ValidationError &error) {
+            failures.push_back({block.height, block.id, transactionId, error.check(), error.what(),
+                                error.expected(), error.actual()});
+        }
+    };
+
+    check([&]() { BlockValidator::validate(block, settings); }, 0);
+
+    Payload payload(transactions);
+    check([&]() { BlockValidator::validateTransactionCount(block, payload); }, 0);
+    check([&]() { BlockValidator::validatePayloadHash(block, payload, transactions, settings); }, 0);
+
+    // Second signatures need the keys registered in the state
+    const std::vector<unsigned char> noSecondSignature;
+    for (const auto &transactionRow : transactions) {
+        if (TransactionValidator::isExempt(transactionRow, block.height, settings.exceptions)) continue;
+        check([&]() {
+            TransactionValidator::validate(transactionRow, noSecondSignature, settings.exceptions, signatureCache, sampling);
+        }, transactionRow.id);
+    }
+}
+
+}
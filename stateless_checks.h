@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "block.h"
+#include "failure_collector.h"
+#include "settings.h"
+#include "signature_cache.h"
+#include "signature_sampling.h"
+#include "transaction.h"
+
+namespace StatelessChecks {
+
+// The checks of Replay::processBlock not depending on the blockchain state, in the same order:
+// block ID, signature and reward, transaction count and payload hash, and everything but the
+// second signature of every transaction. Failures are appended to failures instead of thrown.
+// Replay::processBlock reports them where its own checks would have failed, also placing the
+// second signature checks, so delegating them changes neither the failures nor their order.
+// Can run on any thread if signatureCache and sampling are shared only with other checks.
+void run(const BlockRow &block, const std::vector<TransactionRow> &transactions, const Settings &settings,
+         SignatureCache *signatureCache, SignatureSampling *sampling, std::vector<FailureRecord> &failures);
+
+}
@@ -1,45 +1,115 @@
 #include "summaries.h"
 
+#include <algorithm>
 #include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "perf_counters.h"
+#include "profiler.h"
 #include "scopedbenchmark.h"
 #include "utils.h"
+#include "validation_error.h"
 
 namespace {
 
-struct MemAccountsData {
-    std::unordered_map<address_t, std::int64_t> balances;
-    std::unordered_map<address_t, std::vector<unsigned char>> secondPubkeys;
-    std::unordered_map<address_t, std::string> delegateNames;
-    std::unordered_map<address_t, std::uint64_t> lastBlockId;
+struct Mismatches {
+    bool balances = false;
+    bool secondPubkeys = false;
+    bool lastBlockIds = false;
+    bool delegateNames = false;
 };
 
+template<typename T>
+const T &printable(const T &value)
+{
+    return value;
+}
+
+std::string printable(const bytes_t &value)
+{
+    return bytes2Hex(value);
+}
+
+template<typename T>
+void compareValue(std::ostream &out, address_t address, const T &memAccountsValue, const T &blockchainValue,
+                  const std::string &memAccountsName, const std::string &blockchainName, bool &mismatch)
+{
+    if (memAccountsValue != blockchainValue) {
+        out << memAccountsName << "[" << address << "] = " << printable(memAccountsValue) << "; "
+            << blockchainName << "[" << address << "] = " << printable(blockchainValue) << std::endl;
+        mismatch = true;
+    }
+}
+
+using Accounts = std::vector<std::pair<address_t, const AddressSummary *>>;
+
+// Compares the rows of batch with the accounts from next on, in address order like the rows
+void compareBatch(const pqxx::result &batch, Accounts::const_iterator next, Accounts::const_iterator end,
+                  const Settings &settings, Mismatches &mismatches, std::ostream &out)
+{
+    Profiler::Scope scope("mem_accounts batch", Profiler::Traced); static_cast<void>(scope);
+    for (auto row : batch) {
+        int index = 0;
+        const auto dbAddress = row[index++].as<std::uint64_t>();
+        const auto dbBalance = row[index++].as<std::int64_t>();
+        const auto dbBlockId = !settings.v100Compatible ? row[index++].as<std::uint64_t>() : 0;
+        const auto dbSecondPublicKey = asVector(pqxx::binarystring(row[index++]));
+        const auto dbUsername = row[index++].as<std::string>();
+
+        while (next != end && next->first < dbAddress) {
+            out << "key " << next->first << " not in map mem_accounts" << std::endl;
+            mismatches.balances = true;
+            ++next;
+        }
+
+        if (next == end || next->first != dbAddress) {
+            out << "key " << dbAddress << " not in map blockchainState" << std::endl;
+            mismatches.balances = true;
+            continue;
+        }
+
+        const auto &summary = *next->second;
+        compareValue(out, dbAddress, dbBalance, summary.balance,
+                     "mem_accounts.balance", "blockchainBalance", mismatches.balances);
+        compareValue(out, dbAddress, dbSecondPublicKey, summary.secondPubkey,
+                     "mem_accounts.secondPublicKey", "blockchainSecondPubkeys", mismatches.secondPubkeys);
+        if (!settings.v100Compatible) {
+            compareValue(out, dbAddress, dbBlockId, summary.lastBlockId,
+                         "mem_accounts.blockId", "blockchainLastBlockIds", mismatches.lastBlockIds);
+        }
+        compareValue(out, dbAddress, dbUsername, summary.delegateName,
+                     "mem_accounts.username", "blockchainDelegateNames", mismatches.delegateNames);
+        ++next;
+    }
+}
+
 }
 
 namespace Summaries {
 
-void checkMemAccounts(pqxx::read_transaction &db, const BlockchainState &blockchainState, const Settings &settings)
+void checkMemAccounts(pqxx::read_transaction &db, const BlockchainState &blockchainState, const Settings &settings,
+                      ThreadPool &pool)
 {
     std::cout << "Checking mem_accounts ..." << std::endl;
     ScopedBenchmark benchmarkMemAccounts("Checking mem_accounts"); static_cast<void>(benchmarkMemAccounts);
+    PerfCounters::Stage perfStage("mem_accounts check"); static_cast<void>(perfStage);
 
-    std::unordered_map<address_t, std::int64_t> blockchainBalances;
-    std::unordered_map<address_t, std::uint64_t> blockchainLastBlockIds;
-    std::unordered_map<address_t, bytes_t> blockchainSecondPubkeys;
-    std::unordered_map<address_t, std::string> blockchainDelegateNames;
-    for (auto addressSummary : blockchainState.addressSummaries) {
-        auto address = addressSummary.first;
-        auto summary = addressSummary.second;
-        blockchainBalances[address] = summary.balance;
-        blockchainLastBlockIds[address] = summary.lastBlockId;
-        blockchainSecondPubkeys[address] = summary.secondPubkey;
-        blockchainDelegateNames[address] = summary.delegateName;
+    // Both sides are walked in address order, so a single pass finds all differences
+    Accounts accounts;
+    accounts.reserve(blockchainState.addressSummaries.size());
+    for (const auto &addressSummary : blockchainState.addressSummaries) {
+        accounts.emplace_back(addressSummary.first, &addressSummary.second);
     }
-
-    MemAccountsData memAccounts;
+    std::sort(accounts.begin(), accounts.end(), [](const std::pair<address_t, const AddressSummary *> &a,
+                                                   const std::pair<address_t, const AddressSummary *> &b) {
+        return a.first < b.first;
+    });
 
     std::string excludedAddressFilter;
     if (!settings.exceptions.invalidAddresses.empty())
@@ -54,7 +124,7 @@ void checkMemAccounts(pqxx::read_transaction &db, const BlockchainState &blockch
         excludedAddressFilter += ")";
     }
 
-    pqxx::result result = db.exec(R"SQL(
+    const std::string query = R"SQL(
       SELECT
           left(address, -1),
           balance,
@@ -63,44 +133,76 @@ void checkMemAccounts(pqxx::read_transaction &db, const BlockchainState &blockch
           coalesce(username, '')
       FROM mem_accounts
       )SQL"
-      + excludedAddressFilter);
-    for (auto row : result) {
-        int index = 0;
-        const auto dbAddress = row[index++].as<std::uint64_t>();
-        const auto dbBalance = row[index++].as<std::int64_t>();
-        const auto dbBlockId = !settings.v100Compatible ? row[index++].as<std::uint64_t>() : 0;
-        const auto dbSecondPublicKey = pqxx::binarystring(row[index++]);
-        const auto dbUsername = row[index++].as<std::string>();
+      + excludedAddressFilter + R"SQL(
+      ORDER BY left(address, -1)::numeric
+    )SQL";
+
+    // Batches are compared on the pool while the next ones are read. Their messages are printed
+    // in order, so the output is the same as of a single pass.
+    struct Comparison {
+        explicit Comparison(ThreadPool &pool) : group(pool) {}
+        Mismatches mismatches;
+        std::ostringstream out;
+        ThreadPool::Group group; // last, so that the task ends before the results are destroyed
+    };
+    std::deque<std::unique_ptr<Comparison>> comparisons;
+
+    Mismatches mismatches;
+    auto reportOldest = [&]() {
+        auto &comparison = *comparisons.front();
+        comparison.group.wait();
+        std::cout << comparison.out.str() << std::flush;
+        mismatches.balances |= comparison.mismatches.balances;
+        mismatches.secondPubkeys |= comparison.mismatches.secondPubkeys;
+        mismatches.lastBlockIds |= comparison.mismatches.lastBlockIds;
+        mismatches.delegateNames |= comparison.mismatches.delegateNames;
+        comparisons.pop_front();
+    };
+
+    auto next = accounts.cbegin();
+    pqxx::icursorstream cursor(db, query, "mem_accounts", 10000);
+    pqxx::result batch;
+    while (cursor >> batch) {
+        comparisons.emplace_back(new Comparison(pool));
+        auto &comparison = *comparisons.back();
+        comparison.group.run([batch, next, &accounts, &settings, &comparison]() {
+            compareBatch(batch, next, accounts.cend(), settings, comparison.mismatches, comparison.out);
+        });
+
+        // Where a single pass would be after the last row of the batch
+        const auto lastAddress = batch[batch.size() - 1][0].as<std::uint64_t>();
+        next = std::upper_bound(next, accounts.cend(), lastAddress,
+                                [](address_t address, const std::pair<address_t, const AddressSummary *> &account) {
+            return address < account.first;
+        });
+
+        if (comparisons.size() > 2 * (pool.workerCount() + 1)) {
+            reportOldest();
+        }
+    }
+    while (!comparisons.empty()) {
+        reportOldest();
+    }
 
-        memAccounts.balances[dbAddress] = dbBalance;
-        memAccounts.lastBlockId[dbAddress] = dbBlockId;
-        memAccounts.secondPubkeys[dbAddress] = asVector(dbSecondPublicKey);
-        memAccounts.delegateNames[dbAddress] = dbUsername;
+    for (; next != accounts.cend(); ++next) {
+        std::cout << "key " << next->first << " not in map mem_accounts" << std::endl;
+        mismatches.balances = true;
     }
 
-    if (memAccounts.balances != blockchainBalances) {
-        bool keysMatch = compareKeys(memAccounts.balances, blockchainBalances, true, "mem_accounts.balance", "blockchainBalance");
-        if (keysMatch) compareValues(memAccounts.balances, blockchainBalances, true, "mem_accounts.balance", "blockchainBalance");
-        throw std::runtime_error("Balances in mem_accounts do not match blockchain state");
+    if (mismatches.balances) {
+        throw ValidationError("state.memAccounts.balance", "Balances in mem_accounts do not match blockchain state");
     }
 
-    if (memAccounts.secondPubkeys != blockchainSecondPubkeys) {
-        compareKeys(memAccounts.secondPubkeys, blockchainSecondPubkeys, true);
-        throw std::runtime_error("second pubkeys in mem_accounts do not match blockchain state");
+    if (mismatches.secondPubkeys) {
+        throw ValidationError("state.memAccounts.secondPubkey", "second pubkeys in mem_accounts do not match blockchain state");
     }
 
-    if (!settings.v100Compatible) {
-        if (memAccounts.lastBlockId != blockchainLastBlockIds) {
-            bool keysMatch = compareKeys(memAccounts.lastBlockId, blockchainLastBlockIds, true, "mem_accounts.blockId", "blockchainLastBlockIds");
-            if (keysMatch) compareValues(memAccounts.lastBlockId, blockchainLastBlockIds, true, "mem_accounts.blockId", "blockchainLastBlockIds");
-            throw std::runtime_error("Block IDs in mem_accounts do not match blockchain state");
-        }
+    if (mismatches.lastBlockIds) {
+        throw ValidationError("state.memAccounts.lastBlockId", "Block IDs in mem_accounts do not match blockchain state");
     }
 
-    if (memAccounts.delegateNames != blockchainDelegateNames) {
-        bool keysMatch = compareKeys(memAccounts.delegateNames, blockchainDelegateNames, true);
-        if (keysMatch) compareValues(memAccounts.delegateNames, blockchainDelegateNames, true);
-        throw std::runtime_error("delegate names in mem_accounts do not match blockchain state");
+    if (mismatches.delegateNames) {
+        throw ValidationError("state.memAccounts.delegateName", "delegate names in mem_accounts do not match blockchain state");
     }
 }
 
@@ -4,9 +4,13 @@
 
 #include "blockchain_state.h"
 #include "settings.h"
+#include "thread_pool.h"
 
 namespace Summaries {
 
-void checkMemAccounts(pqxx::read_transaction &db, const BlockchainState &blockchainState, const Settings &settings);
+// Compares mem_accounts with the replayed state, printing every difference. Batches of accounts
+// are compared on pool while the next ones are read.
+void checkMemAccounts(pqxx::read_transaction &db, const BlockchainState &blockchainState, const Settings &settings,
+                      ThreadPool &pool);
 
 }
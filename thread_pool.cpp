@@ -0,0 +1,258 @@
+#include "thread_pool.h"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace {
+
+// CPUs this process may run on, in ascending order
+std::vector<int> allowedCpus()
+{
+    std::vector<int> out;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return out;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) out.push_back(cpu);
+    }
+    return out;
+}
+
+void pin(pthread_t thread, int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0) {
+        std::cout << "Could not pin thread to CPU " << cpu << std::endl;
+    }
+}
+
+}
+
+ThreadPool::ThreadPool(unsigned workers, bool pinThreads)
+    : start_(std::chrono::steady_clock::now())
+{
+    const auto cpus = pinThreads ? allowedCpus() : std::vector<int>();
+    if (!cpus.empty()) {
+        pin(pthread_self(), cpus[0]);
+    }
+
+    for (unsigned i = 0; i < workers; ++i) {
+        workers_.emplace_back(new Worker);
+    }
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        workers_[i]->thread = std::thread([this, i]() { workLoop(i); });
+        if (i + 1 < cpus.size()) {
+            pin(workers_[i]->thread.native_handle(), cpus[i + 1]);
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_) {
+        worker->thread.join();
+    }
+}
+
+unsigned ThreadPool::workerCount() const
+{
+    return static_cast<unsigned>(workers_.size());
+}
+
+std::vector<ThreadPool::WorkerStatistics> ThreadPool::statistics() const
+{
+    std::vector<WorkerStatistics> out;
+    for (const auto &worker : workers_) {
+        WorkerStatistics statistics;
+        statistics.tasks = worker->executed;
+        statistics.steals = worker->steals;
+        statistics.busy = std::chrono::nanoseconds(worker->busyNanoseconds);
+        out.push_back(statistics);
+    }
+    WorkerStatistics helpers;
+    helpers.tasks = helperExecuted_;
+    helpers.busy = std::chrono::nanoseconds(helperBusyNanoseconds_);
+    out.push_back(helpers);
+    return out;
+}
+
+void ThreadPool::printStatistics(std::ostream &out) const
+{
+    const std::chrono::duration<double> lifetime = std::chrono::steady_clock::now() - start_;
+    const auto all = statistics();
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+
+    out << "Thread pool of " << workers_.size() << " workers:" << std::endl;
+    for (std::size_t i = 0; i < all.size(); ++i) {
+        const std::chrono::duration<double> busy = all[i].busy;
+        out << "  " << std::left << std::setw(10)
+            << (i < workers_.size() ? "worker " + std::to_string(i) : std::string("waiting")) << std::right
+            << std::fixed << std::setprecision(1) << std::setw(6)
+            << (lifetime.count() > 0 ? 100 * busy.count() / lifetime.count() : 0) << "% busy"
+            << std::setw(12) << all[i].tasks << " tasks"
+            << std::setw(12) << all[i].steals << " steals" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void ThreadPool::submit(Task task)
+{
+    auto &worker = *workers_[nextWorker_++ % workers_.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        ++queued_;
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::take(std::size_t self, Task &task, bool &stolen)
+{
+    const auto count = workers_.size();
+    if (self < count) {
+        auto &own = *workers_[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            --queued_;
+            stolen = false;
+            return true;
+        }
+    }
+
+    for (std::size_t offset = 1; offset <= count; ++offset) {
+        const auto victim = (self + offset) % count;
+        if (victim == self) continue;
+        auto &other = *workers_[victim];
+        std::lock_guard<std::mutex> lock(other.mutex);
+        auto &tasks = other.tasks;
+        if (tasks.empty()) continue;
+        // Waiting threads help with the oldest tasks, which they most likely wait for
+        if (self < count) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        } else {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        --queued_;
+        stolen = (self < count);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(Task &task, std::atomic<std::int64_t> &busyNanoseconds)
+{
+    const auto begin = std::chrono::steady_clock::now();
+    std::exception_ptr failure;
+    try {
+        task.function();
+    } catch (...) {
+        failure = std::current_exception();
+    }
+    // Nothing of the task may outlive its group
+    task.function = nullptr;
+    busyNanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    task.group->finished(failure);
+}
+
+void ThreadPool::workLoop(std::size_t self)
+{
+    auto &worker = *workers_[self];
+    while (true) {
+        Task task;
+        bool stolen = false;
+        if (take(self, task, stolen)) {
+            if (stolen) ++worker.steals;
+            ++worker.executed;
+            execute(task, worker.busyNanoseconds);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this]() { return queued_ > 0 || stopping_; });
+        if (stopping_) return;
+    }
+}
+
+ThreadPool::Group::Group(ThreadPool &pool)
+    : pool_(pool)
+{
+}
+
+ThreadPool::Group::~Group()
+{
+    try {
+        wait();
+    } catch (...) {
+    }
+}
+
+void ThreadPool::Group::run(std::function<void()> task)
+{
+    ++pending_;
+    Task queued{std::move(task), this};
+    if (pool_.workers_.empty()) {
+        ++pool_.helperExecuted_;
+        pool_.execute(queued, pool_.helperBusyNanoseconds_);
+    } else {
+        pool_.submit(std::move(queued));
+    }
+}
+
+void ThreadPool::Group::wait()
+{
+    const auto helper = pool_.workers_.size();
+    while (pending_ > 0) {
+        Task task;
+        bool stolen = false;
+        if (pool_.take(helper, task, stolen)) {
+            ++pool_.helperExecuted_;
+            pool_.execute(task, pool_.helperBusyNanoseconds_);
+            continue;
+        }
+        // Everything left is running on workers
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]() { return pending_ == 0; });
+    }
+
+    std::exception_ptr failure;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        failure = failure_;
+        failure_ = nullptr;
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+void ThreadPool::Group::finished(std::exception_ptr failure)
+{
+    // The waiting thread may destroy the group right after the lock is released
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (failure && !failure_) {
+        failure_ = failure;
+    }
+    if (--pending_ == 0) {
+        done_.notify_all();
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool shared by all parallel stages of a run, so that they neither oversubscribe
+// nor idle the cores.
+//
+// Every worker has a deque of tasks. Submitted tasks are spread over the workers round-robin.
+// A worker takes the oldest task of its own deque; when it is empty, it steals the newest task
+// of another worker's deque.
+//
+// A thread waiting for a group runs queued tasks meanwhile, oldest first, as those are most likely
+// the ones it waits for. A pool without workers runs every task when it is submitted.
+class ThreadPool {
+public:
+    struct WorkerStatistics {
+        std::uint64_t tasks = 0;
+        std::uint64_t steals = 0; // tasks taken from other workers' deques
+        std::chrono::steady_clock::duration busy {};
+    };
+
+    class Group;
+
+    // workers threads in addition to the threads waiting for groups. With pinThreads, the calling
+    // thread and every worker are bound to a CPU of their own, as far as there are CPUs.
+    ThreadPool(unsigned workers, bool pinThreads = false);
+    // Tasks must have been waited for
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned workerCount() const;
+
+    // One entry per worker, followed by the threads that ran tasks while waiting
+    std::vector<WorkerStatistics> statistics() const;
+    // Utilization, tasks and steals per worker
+    void printStatistics(std::ostream &out) const;
+
+private:
+    struct Task {
+        std::function<void()> function;
+        Group *group;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+        // Written by the worker thread only
+        std::atomic<std::uint64_t> executed{0};
+        std::atomic<std::uint64_t> steals{0};
+        std::atomic<std::int64_t> busyNanoseconds{0};
+    };
+
+    void submit(Task task);
+    // Own deque first, then the other deques. self is the worker index, or workerCount() for
+    // a waiting thread.
+    bool take(std::size_t self, Task &task, bool &stolen);
+    void execute(Task &task, std::atomic<std::int64_t> &busyNanoseconds);
+    void workLoop(std::size_t self);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<std::size_t> nextWorker_{0};
+    const std::chrono::steady_clock::time_point start_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<std::size_t> queued_{0};
+    bool stopping_ = false;
+
+    // Tasks run by threads waiting for groups
+    std::atomic<std::uint64_t> helperExecuted_{0};
+    std::atomic<std::int64_t> helperBusyNanoseconds_{0};
+};
+
+// Tasks submitted together and waited for together
+class ThreadPool::Group {
+public:
+    explicit Group(ThreadPool &pool);
+    // Waits for the tasks still running, ignoring their failures
+    ~Group();
+
+    Group(const Group &) = delete;
+    Group &operator=(const Group &) = delete;
+
+    void run(std::function<void()> task);
+
+    // Runs queued tasks until all tasks of the group are done, then rethrows the exception
+    // of the first failed task
+    void wait();
+
+private:
+    friend class ThreadPool;
+    void finished(std::exception_ptr failure);
+
+    ThreadPool &pool_;
+    std::atomic<std::size_t> pending_{0};
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::exception_ptr failure_;
+};
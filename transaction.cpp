@@ -1,10 +1,46 @@
 #include "transaction.h"
 
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
 #include <sodium.h>
 
 #include "lisk.h"
+#include "profiler.h"
 #include "utils.h"
 
+namespace {
+
+const std::size_t PUBKEY_HEX_LENGTH = 64;
+
+// Calls visit(prefix, hex) for every entry "+<64 hex digits>" or "-<64 hex digits>" of a votes or
+// keysgroup asset, starting at offset. A comma between entries is skipped.
+template<typename Visit>
+void forEachKeyEntry(const bytes_t &asset, std::size_t offset, Visit visit)
+{
+    auto position = offset;
+    while (position < asset.size()) {
+        if (asset[position] == ',') ++position;
+        if (asset.size() - position < 1 + PUBKEY_HEX_LENGTH) {
+            throw std::runtime_error("Truncated public key in asset data");
+        }
+        visit(asset[position], &asset[position + 1]);
+        position += 1 + PUBKEY_HEX_LENGTH;
+    }
+}
+
+void decodePubkey(const unsigned char *hex, unsigned char *out)
+{
+    if (!decodeHex(hex, PUBKEY_HEX_LENGTH / 2, out)) {
+        throw std::runtime_error("Invalid public key in asset data: " + std::string(hex, hex + PUBKEY_HEX_LENGTH));
+    }
+}
+
+const std::size_t TYPE4_KEYS_OFFSET = 2; // after min, lifetime
+
+}
+
 Transaction::Transaction(
         std::uint8_t _type,
         std::int32_t _timestamp,
@@ -17,115 +53,99 @@ Transaction::Transaction(
         )
     : type(_type)
     , timestamp(_timestamp)
-    , senderAddress(addressFromPubkey(_senderPublicKey))
-    , senderPublicKey(_senderPublicKey)
+    , senderPublicKey(std::move(_senderPublicKey))
+    , senderAddress(addressFromPubkey(senderPublicKey))
     , recipientAddress(_recipientId)
     , amount(_amount)
     , fee(_fee)
-    , assetData(_assetData)
+    , assetData(std::move(_assetData))
     , dappId(_dappId)
-    , type3Votes(_type == 3
-                 ? Transaction::parseType3Votes(std::string(_assetData.begin(), _assetData.end()))
-                 : VotesUpdate())
-    , type4Pubkeys(_type == 4
-                   ? Transaction::parseType4Pubkeys(std::string(_assetData.begin(), _assetData.end()))
-                   : std::vector<std::vector<unsigned char>>())
 {
+    // The keys are decoded into a stack buffer only to reject malformed assets while reading,
+    // type4Addresses() decodes them again when needed
+    unsigned char pubkey[PUBKEY_HEX_LENGTH / 2];
+    if (type == 3) {
+        forEachKeyEntry(assetData, 0, [&](unsigned char prefix, const unsigned char *hex) {
+            if (prefix != '+' && prefix != '-') {
+                throw std::runtime_error("Invalid prefix found in votes attset data: " + std::string(1, prefix));
+            }
+            decodePubkey(hex, pubkey);
+        });
+    } else if (type == 4) {
+        if (assetData.size() < TYPE4_KEYS_OFFSET) {
+            throw std::runtime_error("Multisignature asset data without min and lifetime");
+        }
+        forEachKeyEntry(assetData, TYPE4_KEYS_OFFSET, [&](unsigned char, const unsigned char *hex) {
+            decodePubkey(hex, pubkey);
+        });
+    }
 }
 
-std::vector<unsigned char> Transaction::serialize() const
+void Transaction::serializePrefix(unsigned char *out) const
 {
-    std::size_t size = 1 // type
-            + 4 // timestamp
-            + 32 // sender pubkey
-            + 8 // recipient
-            + 8 // amount
-            + assetData.size()
-            ;
-    auto out = std::vector<unsigned char>(size);
-    out[0] = type;
-    out[1] = (timestamp >> 0) & 0xFF;
-    out[2] = (timestamp >> 8) & 0xFF;
-    out[3] = (timestamp >> 16) & 0xFF;
-    out[4] = (timestamp >> 24) & 0xFF;
-    for (int i = 0; i < senderPublicKey.size(); ++i) {
-        out[5+i] = senderPublicKey[i];
-    }
-
-    for (int i = 0; i < 8; ++i) {
-        out[37+i] = (recipientAddress >> (7-i)*8) & 0xFF;
-    }
+    PrefixLayout::write(out, type, timestamp, senderPublicKey, recipientAddress, amount);
+}
 
-    for (int i = 0; i < 8; ++i) {
-        out[45+i] = (amount >> i*8) & 0xFF;
-    }
+std::size_t Transaction::serializedSize() const
+{
+    return PrefixLayout::size + assetData.size();
+}
 
-    for (int i = 0; i < assetData.size(); ++i) {
-        out[53+i] = assetData[i];
-    }
+void Transaction::serialize(unsigned char *out) const
+{
+    serializePrefix(out);
+    if (!assetData.empty()) std::memcpy(out + PrefixLayout::size, assetData.data(), assetData.size());
+}
 
+std::vector<unsigned char> Transaction::serialize() const
+{
+    auto out = std::vector<unsigned char>(serializedSize());
+    serialize(out.data());
     return out;
 }
 
-std::vector<unsigned char> Transaction::hash(std::vector<unsigned char> signature, std::vector<unsigned char> secondSignature) const
+std::vector<unsigned char> Transaction::hash(const std::vector<unsigned char> &signature, const std::vector<unsigned char> &secondSignature) const
 {
-    auto out = std::vector<unsigned char>(crypto_hash_sha256_BYTES);
+    Profiler::Scope scope("hashing"); static_cast<void>(scope);
+    unsigned char prefix[PrefixLayout::size];
+    serializePrefix(prefix);
 
+    auto out = std::vector<unsigned char>(crypto_hash_sha256_BYTES);
     crypto_hash_sha256_state state;
     crypto_hash_sha256_init(&state);
-
-    auto message = serialize();
-    crypto_hash_sha256_update(&state, message.data(), message.size());
+    crypto_hash_sha256_update(&state, prefix, sizeof(prefix));
+    crypto_hash_sha256_update(&state, assetData.data(), assetData.size());
     crypto_hash_sha256_update(&state, signature.data(), signature.size());
     crypto_hash_sha256_update(&state, secondSignature.data(), secondSignature.size());
-
     crypto_hash_sha256_final(&state, out.data());
 
     return out;
 }
 
-std::uint64_t Transaction::id(std::vector<unsigned char> signature, std::vector<unsigned char> secondSignature) const
+std::uint64_t Transaction::id(const std::vector<unsigned char> &signature, const std::vector<unsigned char> &secondSignature) const
 {
     return idFromEightBytes(firstEightBytesReversed(hash(signature, secondSignature)));
 }
 
-VotesUpdate Transaction::parseType3Votes(const std::string transactionAsset)
+std::size_t Transaction::type4KeyCount() const
 {
-    VotesUpdate out;
-
-    auto iterator = transactionAsset.cbegin();
-    while (iterator != transactionAsset.cend()) {
-        if (*iterator == ',') ++iterator;
-        auto prefix = *iterator;
-        ++iterator;
-        auto pubkey = hex2Bytes(std::string(iterator, iterator+64));
-        iterator += 64;
-        if (prefix == '+') {
-            out.added.push_back(pubkey);
-        } else if (prefix == '-') {
-            out.removed.push_back(pubkey);
-        } else {
-            throw std::runtime_error("Invalid prefix found in votes attset data: " + std::string(1, prefix));
-        }
-    }
+    std::size_t out = 0;
+    if (type != 4) return out;
 
+    forEachKeyEntry(assetData, TYPE4_KEYS_OFFSET, [&](unsigned char, const unsigned char *) { ++out; });
     return out;
 }
 
-std::vector<std::vector<unsigned char>> Transaction::parseType4Pubkeys(const std::string transactionAsset)
+std::vector<address_t> Transaction::type4Addresses() const
 {
-    std::vector<std::vector<unsigned char>> out;
-
-    auto iterator = transactionAsset.cbegin();
-    iterator += 2; // skip min, lifetime
-    while (iterator != transactionAsset.cend()) {
-        if (*iterator == ',') ++iterator;
-        ++iterator; // skip "+"
-        auto pubkeyHex = std::string(iterator, iterator+64);
-        out.push_back(hex2Bytes(pubkeyHex));
-        iterator += 64;
-    }
-
+    std::vector<address_t> out;
+    if (type != 4) return out;
+
+    forEachKeyEntry(assetData, TYPE4_KEYS_OFFSET, [&](unsigned char, const unsigned char *hex) {
+        unsigned char pubkey[PUBKEY_HEX_LENGTH / 2];
+        decodePubkey(hex, pubkey);
+        out.push_back(addressFromPubkey(pubkey, sizeof(pubkey)));
+    });
     return out;
 }
 
@@ -3,8 +3,10 @@
 #include <cstdint>
 #include <string>
 #include <ostream>
+#include <utility>
 #include <vector>
 
+#include "serialization.h"
 #include "types.h"
 
 struct Transaction {
@@ -29,18 +31,30 @@ struct Transaction {
     const std::vector<unsigned char> assetData;
     const std::uint64_t dappId; // not signed
 
-    // derived data
-    const VotesUpdate type3Votes;
-    const std::vector<std::vector<unsigned char>> type4Pubkeys;
+    // Derived from assetData on every call; the constructor checks the prefixes and hex digits of the
+    // keys of type 3 and 4 assets, but does not store them
+    std::size_t type4KeyCount() const;
+    std::vector<address_t> type4Addresses() const; // of the multisignature keys
 
+    // Wire format: these fields followed by assetData
+    using PrefixLayout = Serialization::Layout<
+        Serialization::Little<std::uint8_t>, // type
+        Serialization::Little<std::int32_t>, // timestamp
+        Serialization::Bytes<32>, // sender public key
+        Serialization::Big<std::uint64_t>, // recipient
+        Serialization::Little<std::uint64_t> // amount
+    >;
+
+    // Writes PrefixLayout::size bytes
+    void serializePrefix(unsigned char *out) const;
+    std::size_t serializedSize() const;
+    // Writes serializedSize() bytes
+    void serialize(unsigned char *out) const;
     std::vector<unsigned char> serialize() const;
-    std::vector<unsigned char> hash(std::vector<unsigned char> signature = {}, std::vector<unsigned char> secondSignature = {}) const;
-    std::uint64_t id(std::vector<unsigned char> signature, std::vector<unsigned char> secondSignature) const;
+    std::vector<unsigned char> hash(const std::vector<unsigned char> &signature = {}, const std::vector<unsigned char> &secondSignature = {}) const;
+    std::uint64_t id(const std::vector<unsigned char> &signature, const std::vector<unsigned char> &secondSignature) const;
 
 private:
-    static VotesUpdate parseType3Votes(const std::string transactionAsset);
-    static std::vector<std::vector<unsigned char>> parseType4Pubkeys(const std::string transactionAsset);
-
     friend std::ostream& operator<<(std::ostream& os, const Transaction& transaction);
 };
 
@@ -52,8 +66,8 @@ struct TransactionRow {
             std::uint64_t _id,
             std::uint64_t _blockId)
         : transaction(_transaction)
-        , signature(_signature)
-        , secondSignature(_secondSignature)
+        , signature(std::move(_signature))
+        , secondSignature(std::move(_secondSignature))
         , id(_id)
         , blockId(_blockId)
     {
@@ -3,15 +3,19 @@
 #include <iostream>
 #include <sodium.h>
 
+#include "lisk.h"
+#include "profiler.h"
 #include "utils.h"
+#include "validation_error.h"
 
 namespace {
 
 void validate_id(const TransactionRow &row)
 {
+    Profiler::Scope scope("transaction id"); static_cast<void>(scope);
     auto calculatedId = row.transaction.id(row.signature, row.secondSignature);
     if (row.id != calculatedId) {
-        throw std::runtime_error("Transaction ID mismatch");
+        throw ValidationError("transaction.id", "Transaction ID mismatch", std::to_string(calculatedId), std::to_string(row.id));
     }
 }
 
@@ -31,14 +35,16 @@ void validate_amount(const TransactionRow &row, const Exceptions &exceptions)
     case 4:
     case 5: {
         if (row.transaction.amount != 0) {
-               throw std::runtime_error(
+               throw ValidationError(
+                           "transaction.amount",
                            "Amount not 0 for type " + std::to_string(row.transaction.type) +
-                           " transaction " + std::to_string(row.id) + ": " + std::to_string(row.transaction.amount));
+                           " transaction " + std::to_string(row.id) + ": " + std::to_string(row.transaction.amount),
+                           "0", std::to_string(row.transaction.amount));
         }
         break;
     }
     default:
-        throw std::runtime_error("Unknown transaction type");
+        throw ValidationError("transaction.type", "Unknown transaction type", "", std::to_string(row.transaction.type));
         break;
     }
 }
@@ -69,7 +75,7 @@ void validate_fee(const TransactionRow &row, const Exceptions &exceptions)
             expected = 100000000;
             break;
         case 4:
-            expected = 500000000 * (row.transaction.type4Pubkeys.size() + 1);
+            expected = 500000000 * (row.transaction.type4KeyCount() + 1);
             break;
         case 5:
             expected = 2500000000;
@@ -81,65 +87,106 @@ void validate_fee(const TransactionRow &row, const Exceptions &exceptions)
             expected = 10000000;
             break;
         default:
-            throw std::runtime_error("Unknown transaction type");
+            throw ValidationError("transaction.type", "Unknown transaction type", "", std::to_string(row.transaction.type));
             break;
         }
     }
 
     if (t.fee != expected) {
-        throw std::runtime_error("Transaction " + std::to_string(row.id) + " type " + std::to_string(t.type) +
-                                 " has invalid fee: " + std::to_string(t.fee) +
-                                 " expected: "  + std::to_string(expected));
+        throw ValidationError("transaction.fee",
+                              "Transaction " + std::to_string(row.id) + " type " + std::to_string(t.type) +
+                              " has invalid fee: " + std::to_string(t.fee) +
+                              " expected: "  + std::to_string(expected),
+                              std::to_string(expected), std::to_string(t.fee));
     }
 }
 
-void validate_signature(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy)
+void validate_second_signature(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy)
 {
-    auto hash = row.transaction.hash();
-    if (row.signature.size() != crypto_sign_BYTES)
+    //std::cout << "Transaction: " << row.id << " requires second signature" << std::endl;
+    auto hash2 = row.transaction.hash(row.signature);
+    if (row.secondSignature.size() != crypto_sign_BYTES)
     {
-        throw std::runtime_error("Signature has unexpected length: " + std::to_string(row.signature.size()));
+        throw ValidationError("transaction.secondSignature",
+                              "Second signature required but signature has unexpected length: " +
+                              std::to_string(row.secondSignature.size()),
+                              std::to_string(crypto_sign_BYTES), std::to_string(row.secondSignature.size()));
     }
-    if (crypto_sign_verify_detached(row.signature.data(), hash.data(), hash.size(), row.transaction.senderPublicKey.data()) != 0) {
+    if (!verifySignature(row.secondSignature, hash2, secondSignatureRequiredBy)) {
         std::cout << "ID: " << row.id << std::endl;
         std::cout << "Transaction: " << row.transaction << std::endl;
         std::cout << "Sender: " << bytes2Hex(row.transaction.senderPublicKey) << std::endl;
         std::cout << "Signature: " << bytes2Hex(row.signature) << std::endl;
-        throw std::runtime_error("Invalid transaction signature");
+        throw ValidationError("transaction.secondSignature", "Invalid transaction second signature");
     }
+}
 
-    if (!secondSignatureRequiredBy.empty()) {
-        //std::cout << "Transaction: " << row.id << " requires second signature" << std::endl;
-        auto hash2 = row.transaction.hash(row.signature);
-        if (row.secondSignature.size() != crypto_sign_BYTES)
-        {
-            throw std::runtime_error("Second signature required but signature has unexpected length: " +
-                                     std::to_string(row.secondSignature.size()));
-        }
-        if (crypto_sign_verify_detached(row.secondSignature.data(), hash2.data(), hash2.size(), secondSignatureRequiredBy.data()) != 0) {
+// Only the length of the first signature is checked when verifyFirstSignature is false
+void validate_signature(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy,
+                        bool verifyFirstSignature = true)
+{
+    Profiler::Scope scope("transaction signatures"); static_cast<void>(scope);
+    if (row.signature.size() != crypto_sign_BYTES)
+    {
+        throw ValidationError("transaction.signature", "Signature has unexpected length: " + std::to_string(row.signature.size()),
+                              std::to_string(crypto_sign_BYTES), std::to_string(row.signature.size()));
+    }
+    if (verifyFirstSignature) {
+        auto hash = row.transaction.hash();
+        if (!verifySignature(row.signature, hash, row.transaction.senderPublicKey)) {
             std::cout << "ID: " << row.id << std::endl;
             std::cout << "Transaction: " << row.transaction << std::endl;
             std::cout << "Sender: " << bytes2Hex(row.transaction.senderPublicKey) << std::endl;
             std::cout << "Signature: " << bytes2Hex(row.signature) << std::endl;
-            throw std::runtime_error("Invalid transaction second signature");
+            throw ValidationError("transaction.signature", "Invalid transaction signature");
         }
     }
+
+    if (!secondSignatureRequiredBy.empty()) {
+        validate_second_signature(row, secondSignatureRequiredBy);
+    }
 }
 
 }
 
 namespace TransactionValidator {
 
-void validate(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy, const Exceptions &exceptions)
+bool isExempt(const TransactionRow &row, height_t height, const Exceptions &exceptions)
+{
+    return (height == 1 && row.transaction.type != 0) || exceptions.invalidTransactionSignature.count(row.id);
+}
+
+void validate(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy, const Exceptions &exceptions,
+              SignatureCache *signatureCache, SignatureSampling *sampling)
 {
     bool canBeSerialized = (exceptions.transactionsContainingInvalidRecipientAddress.count(row.id) == 0);
     if (canBeSerialized) {
         validate_id(row);
-        validate_signature(row, secondSignatureRequiredBy);
+        if (signatureCache) {
+            const auto key = SignatureCache::key(row, secondSignatureRequiredBy);
+            if (!signatureCache->contains(key)) {
+                const bool verifyFirstSignature = !sampling || sampling->select(row.id);
+                validate_signature(row, secondSignatureRequiredBy, verifyFirstSignature);
+                // Only completely verified signatures are cached
+                if (verifyFirstSignature) signatureCache->insert(key);
+            }
+        } else {
+            validate_signature(row, secondSignatureRequiredBy, !sampling || sampling->select(row.id));
+        }
     }
 
     validate_amount(row, exceptions);
     validate_fee(row, exceptions);
 }
 
+void validateSecondSignature(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy,
+                             const Exceptions &exceptions)
+{
+    if (secondSignatureRequiredBy.empty()) return;
+    if (exceptions.transactionsContainingInvalidRecipientAddress.count(row.id)) return;
+
+    Profiler::Scope scope("transaction signatures"); static_cast<void>(scope);
+    validate_second_signature(row, secondSignatureRequiredBy);
+}
+
 }
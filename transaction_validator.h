@@ -1,10 +1,24 @@
 #pragma once
 
 #include "settings.h"
+#include "signature_cache.h"
+#include "signature_sampling.h"
 #include "transaction.h"
+#include "types.h"
 
 namespace TransactionValidator {
 
-void validate(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy, const Exceptions &exceptions);
+// Transactions of the genesis block other than transfers and those with known invalid signatures
+// are applied without validation
+bool isExempt(const TransactionRow &row, height_t height, const Exceptions &exceptions);
+
+// Signatures found in signatureCache are not verified again, new successful verifications are added to it.
+// With sampling, first signatures not selected by it are only checked for their length.
+void validate(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy, const Exceptions &exceptions,
+              SignatureCache *signatureCache = nullptr, SignatureSampling *sampling = nullptr);
+
+// Only the second signature, the part of validate() depending on the blockchain state
+void validateSecondSignature(const TransactionRow &row, const std::vector<unsigned char> &secondSignatureRequiredBy,
+                             const Exceptions &exceptions);
 
 }
@@ -1,37 +1,39 @@
 #pragma once
 
 #include <cstdint>
+#include <deque>
 #include <vector>
 #include <set>
 #include <unordered_map>
+#include <utility>
 
 using bytes_t = std::vector<unsigned char>;
 using address_t = std::uint64_t;
 using height_t = std::uint64_t;
 
-struct VotesUpdate {
-    // lists of pubkeys
-    std::vector<bytes_t> added;
-    std::vector<bytes_t> removed;
-};
-
+// Tracks written keys for later validation. Optionally keeps a journal of the values
+// before each write, grouped in frames, so that the latest frame can be rolled back.
 template<typename type_of_key, typename type_of_value>
 class tracking_unordered_map : public std::unordered_map<type_of_key, type_of_value>
 {
+    using base = std::unordered_map<type_of_key, type_of_value>;
+
 public:
     type_of_value& operator[](const type_of_key& key)
     {
         dirtyKeys_.insert(key);
-        return std::unordered_map<type_of_key, type_of_value>::operator[](key);
+        journal(key);
+        return base::operator[](key);
     }
 
     size_t erase(const type_of_key& key)
     {
         dirtyKeys_.erase(key);
-        return std::unordered_map<type_of_key, type_of_value>::erase(key);
+        journal(key);
+        return base::erase(key);
     }
 
-    std::set<type_of_key> dirtyKeys() const
+    const std::set<type_of_key> &dirtyKeys() const
     {
         return dirtyKeys_;
     }
@@ -41,6 +43,54 @@ public:
         dirtyKeys_.clear();
     }
 
+    void beginJournalFrame()
+    {
+        journal_.emplace_back();
+    }
+
+    // Restores all values written since the latest beginJournalFrame()
+    void rollbackJournalFrame()
+    {
+        for (auto &entry : journal_.back()) {
+            if (entry.second.first) {
+                dirtyKeys_.insert(entry.first);
+                base::operator[](entry.first) = std::move(entry.second.second);
+            } else {
+                dirtyKeys_.erase(entry.first);
+                base::erase(entry.first);
+            }
+        }
+        journal_.pop_back();
+    }
+
+    // Makes the changes of the oldest frame permanent
+    void dropOldestJournalFrame()
+    {
+        journal_.pop_front();
+    }
+
+    size_t journalFrameCount() const
+    {
+        return journal_.size();
+    }
+
 private:
+    void journal(const type_of_key& key)
+    {
+        if (journal_.empty()) return;
+
+        auto &frame = journal_.back();
+        if (frame.count(key)) return;
+
+        auto existing = base::find(key);
+        if (existing == base::end()) {
+            frame.emplace(key, std::make_pair(false, type_of_value()));
+        } else {
+            frame.emplace(key, std::make_pair(true, existing->second));
+        }
+    }
+
     std::set<type_of_key> dirtyKeys_;
+    // per frame: key -> (existed, value before the first write in this frame)
+    std::deque<std::unordered_map<type_of_key, std::pair<bool, type_of_value>>> journal_;
 };
@@ -1,32 +1,98 @@
 #pragma once
 
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <stdexcept>
 #include <string>
 #include <vector>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
-#include <unordered_map>
 #include <pqxx/pqxx>
 
-inline std::vector<unsigned char> hex2Bytes(const std::string hex) {
+// Values of hex digits by character, -1 for all other characters
+struct HexDigits {
+    signed char values[256];
+};
+
+constexpr HexDigits makeHexDigits()
+{
+    HexDigits out {};
+    for (int c = 0; c < 256; ++c) {
+        out.values[c] = c >= '0' && c <= '9' ? c - '0'
+                      : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                      : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                      : -1;
+    }
+    return out;
+}
+
+constexpr HexDigits HEX_DIGITS = makeHexDigits();
+
+// Decodes 2 * size hex digits into size bytes at out. Returns false if a character is no hex digit.
+inline bool decodeHex(const unsigned char *hex, std::size_t size, unsigned char *out)
+{
+    int invalid = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        const int high = HEX_DIGITS.values[hex[2*i]];
+        const int low = HEX_DIGITS.values[hex[2*i + 1]];
+        invalid |= high | low;
+        // Shifted unsigned, as high is -1 for invalid digits; out is unspecified then
+        out[i] = static_cast<unsigned char>((static_cast<unsigned>(high) << 4) | static_cast<unsigned>(low));
+    }
+    return invalid >= 0;
+}
+
+inline std::vector<unsigned char> hex2Bytes(const std::string &hex) {
     std::vector<unsigned char> out(hex.size() / 2);
-    for (int i = 0; i < hex.size(); i += 2)
-    {
-        std::istringstream iss(hex.substr(i, 2));
-        int temp;
-        iss >> std::hex >> temp;
-        out[i/2] = static_cast<unsigned char>(temp);
+    if (!decodeHex(reinterpret_cast<const unsigned char *>(hex.data()), out.size(), out.data())) {
+        throw std::runtime_error("Invalid hex string: " + hex);
     }
     return out;
 }
 
-inline std::string bytes2Hex(const std::vector<unsigned char> data) {
-    std::stringstream out;
-    out << std::setfill('0') << std::hex;
-    for(size_t i = 0; i < data.size(); ++i) {
-        out << std::setw(2) << static_cast<int>(data[i]);
+inline std::string bytes2Hex(const std::vector<unsigned char> &data) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(2 * data.size(), '0');
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        out[2*i] = digits[data[i] >> 4];
+        out[2*i + 1] = digits[data[i] & 0xf];
     }
-    return out.str();
+    return out;
+}
+
+// value as a quoted JSON string, escaping quotes, backslashes and control characters
+inline std::string jsonString(const std::string &value) {
+    std::string out = "\"";
+    for (char c : value) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+    }
+    return out + "\"";
+}
+
+// Appends the decimal digits of value, like std::to_string without the temporary string
+inline void appendDecimal(std::vector<unsigned char> &out, std::uint64_t value) {
+    unsigned char digits[20];
+    auto begin = std::end(digits);
+    do {
+        *--begin = static_cast<unsigned char>('0' + value % 10);
+        value /= 10;
+    } while (value);
+    out.insert(out.end(), begin, std::end(digits));
 }
 
 inline std::vector<unsigned char> asVector(const pqxx::binarystring &binstr) {
@@ -42,57 +108,3 @@ inline std::vector<unsigned char> asVector(const std::string &str) {
                 reinterpret_cast<const unsigned char*>(str.data() + str.size())
     );
 }
-
-template<typename T>
-bool compareKeys(
-        const std::unordered_map<std::uint64_t, T> a,
-        const std::unordered_map<std::uint64_t, T> b,
-        const bool logging = false,
-        const std::string aName = "a",
-        const std::string bName = "b")
-{
-    bool ok = true;
-    for (auto iter = a.begin(); iter != a.end(); ++iter) {
-        auto key = iter->first;
-        if (b.count(key) != 1) {
-            if (logging) std::cout << "key " << key << " not in map " << bName << std::endl;
-            ok = false;
-        }
-    }
-
-    for (auto iter = b.begin(); iter != b.end(); ++iter) {
-        auto key = iter->first;
-        if (a.count(key) != 1) {
-            if (logging) std::cout << "key " << key << " not in map " << aName << std::endl;
-            ok = false;
-        }
-    }
-
-    return ok;
-}
-
-template<typename T>
-bool compareValues(
-        const std::unordered_map<std::uint64_t, T> a,
-        const std::unordered_map<std::uint64_t, T> b,
-        const bool logging = false,
-        const std::string aName = "a",
-        const std::string bName = "b")
-{
-    bool ok = true;
-    for (auto iter = a.cbegin(); iter != a.cend(); ++iter) {
-        const auto key = iter->first;
-        const auto aValue = iter->second;
-        const auto bValue = b.at(key);
-
-        if (bValue != aValue) {
-            if (logging) {
-                std::cout << aName << "[" << key << "] = " << aValue << "; "
-                          << bName << "[" << key << "] = " << bValue << std::endl;
-            }
-            ok = false;
-        }
-    }
-
-    return ok;
-}
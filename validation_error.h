@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdexcept>
+#include <string>
+
+// A check of the chain data that failed, as opposed to errors reading the data.
+// what() is the message also shown without collecting failures.
+class ValidationError : public std::runtime_error {
+public:
+    ValidationError(const std::string &check, const std::string &message,
+                    const std::string &expected = "", const std::string &actual = "")
+        : std::runtime_error(message)
+        , check_(check)
+        , expected_(expected)
+        , actual_(actual)
+    {
+    }
+
+    // e.g. "block.reward" or "transaction.fee"
+    const std::string &check() const { return check_; }
+    const std::string &expected() const { return expected_; }
+    const std::string &actual() const { return actual_; }
+
+private:
+    std::string check_;
+    std::string expected_;
+    std::string actual_;
+};